@@ -0,0 +1,277 @@
+/**
+ * @file MidiDecodeBench.cpp
+ * @brief Measures how fast Standard MIDI File track data is decoded.
+ *
+ * A synthetic type-1 file is built in memory (note-ons and note-offs with running
+ * status, some controllers, and an occasional text meta message) and decoded with:
+ * - the stream reader, MidiFile::readSmf(std::istream&), which reads one byte at a time;
+ * - the in-memory reader, MidiFile::readSmf(std::span), which builds a MidiFile;
+ * - MidiTrackDecoder::next() alone, which shows the cost of decoding without
+ *   storing the events;
+ * - MidiFile::read(std::span) on the binasc (ASCII) form of the same file;
+ * - MidiFile::readBase64() on the base64 form of the file.
+ *
+ * After decoding, a note scan (total duration of all note-ons) is timed over the
+ * linked MidiFile and over a MidiEventTable built from it, and the ticks of all
+ * events are converted to seconds one call at a time and with one batch call.
+ * Finally all tracks are joined into one large track, which is put in reverse
+ * order and sorted again with MidiFile::sortTracks().
+ *
+ * Usage: midi_decode_bench [tracks] [events per track] [repetitions]
+ */
+
+#include "midiFile/Base64.h"
+#include "midiFile/MidiEventTable.h"
+#include "midiFile/MidiFile.h"
+#include "midiFile/MidiTrackDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace smf;
+
+/**
+ * @brief Appends a variable-length quantity to a byte buffer.
+ */
+static void appendVLV(std::vector<uchar>& out, unsigned long value) {
+    uchar buffer[5];
+    int count = 0;
+    do {
+        buffer[count++] = value & 0x7f;
+        value >>= 7;
+    } while (value > 0);
+    while (count > 1) {
+        out.push_back(buffer[--count] | 0x80);
+    }
+    out.push_back(buffer[0]);
+}
+
+/**
+ * @brief Builds the event data of one MTrk chunk.
+ *
+ * @param events Number of events to generate (approximately).
+ * @param seed Random seed, so that each track is different.
+ */
+static std::vector<uchar> makeTrack(int events, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uchar> out;
+    out.reserve(events * 4);
+    int channel = seed % 16;
+    uchar running = 0;
+    for (int i = 0; i < events; i += 2) {
+        int key = 40 + rng() % 40;
+        appendVLV(out, rng() % 8);
+        if (running != (0x90 | channel)) {
+            running = 0x90 | channel;
+            out.push_back(running);
+        }
+        out.push_back(key);
+        out.push_back(1 + rng() % 126);
+        appendVLV(out, 1 + rng() % 480);
+        out.push_back(key);
+        out.push_back(0);               // note-off as running-status note-on
+        if (i % 64 == 0) {
+            appendVLV(out, 0);
+            running = 0xb0 | channel;
+            out.push_back(running);
+            out.push_back(64);
+            out.push_back(rng() % 128);
+        }
+        if (i % 1000 == 0) {
+            appendVLV(out, 0);
+            running = 0;
+            std::string text = "marker " + std::to_string(i);
+            out.push_back(0xff);
+            out.push_back(0x06);
+            appendVLV(out, text.size());
+            out.insert(out.end(), text.begin(), text.end());
+        }
+    }
+    out.insert(out.end(), {0x00, 0xff, 0x2f, 0x00});
+    return out;
+}
+
+/**
+ * @brief Builds a complete type-1 Standard MIDI File.
+ */
+static std::vector<uchar> makeFile(int tracks, int events) {
+    std::vector<uchar> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1,
+        (uchar)(tracks >> 8), (uchar)tracks, 0x01, 0xe0};
+    for (int i = 0; i < tracks; i++) {
+        std::vector<uchar> track = makeTrack(events, i + 1);
+        size_t size = track.size();
+        file.insert(file.end(), {'M', 'T', 'r', 'k', (uchar)(size >> 24),
+            (uchar)(size >> 16), (uchar)(size >> 8), (uchar)size});
+        file.insert(file.end(), track.begin(), track.end());
+    }
+    return file;
+}
+
+/**
+ * @brief Runs a job several times and returns the fastest time in seconds.
+ */
+static double bestOf(int repetitions, const std::function<void()>& job) {
+    double best = 1.0e30;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::steady_clock::now();
+        job();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+/**
+ * @brief Prints one result line.
+ */
+static void report(const std::string& name, double seconds, size_t bytes, long events) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(10) << seconds * 1000.0 << " ms"
+              << std::setw(10) << bytes / seconds / 1.0e6 << " MB/s"
+              << std::setw(10) << events / seconds / 1.0e6 << " Mevents/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int tracks = argc > 1 ? std::atoi(argv[1]) : 16;
+    int events = argc > 2 ? std::atoi(argv[2]) : 100000;
+    int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    std::vector<uchar> file = makeFile(tracks, events);
+    std::string text(file.begin(), file.end());
+
+    MidiFile check;
+    if (!check.readSmf(std::span<const uchar>(file))) {
+        std::cerr << "Error: generated file cannot be read" << std::endl;
+        return 1;
+    }
+    long total = 0;
+    for (int i = 0; i < check.getTrackCount(); i++) {
+        total += check[i].size();
+    }
+    std::cout << tracks << " tracks, " << total << " events, " << file.size()
+              << " bytes" << std::endl;
+
+    double seconds = bestOf(repetitions, [&]() {
+        std::istringstream input(text);
+        MidiFile midifile;
+        midifile.readSmf(input);
+    });
+    report("readSmf(istream)", seconds, file.size(), total);
+
+    seconds = bestOf(repetitions, [&]() {
+        MidiFile midifile;
+        midifile.readSmf(std::span<const uchar>(file));
+    });
+    report("readSmf(span)", seconds, file.size(), total);
+
+    long decoded = 0;
+    seconds = bestOf(repetitions, [&]() {
+        decoded = 0;
+        size_t offset = 14;
+        MidiEvent event;
+        for (int i = 0; i < tracks; i++) {
+            MidiTrackDecoder decoder(std::span<const uchar>(file).subspan(offset + 8), i);
+            while (decoder.next(event)) {
+                decoded++;
+            }
+            offset += 8 + decoder.getOffset();
+        }
+    });
+    report("MidiTrackDecoder::next", seconds, file.size(), decoded);
+
+    std::stringstream binasc;
+    check.writeBinasc(binasc);
+    std::string ascii = binasc.str();
+    std::span<const uchar> asciiData((const uchar*)ascii.data(), ascii.size());
+    seconds = bestOf(repetitions, [&]() {
+        MidiFile midifile;
+        midifile.read(asciiData);
+    });
+    report("read(binasc span)", seconds, ascii.size(), total);
+
+    std::string base64 = check.getBase64(76);
+    seconds = bestOf(repetitions, [&]() {
+        MidiFile midifile;
+        midifile.readBase64(base64);
+    });
+    report(std::string("readBase64 (") + Base64::getInstructionSet() + ")", seconds,
+           base64.size(), total);
+
+    check.doTimeAnalysis();
+    check.linkNotePairs();
+    double noteTime = 0.0;
+    seconds = bestOf(repetitions, [&]() {
+        noteTime = 0.0;
+        for (int i = 0; i < check.getTrackCount(); i++) {
+            for (int j = 0; j < check[i].size(); j++) {
+                if (check[i][j].isNoteOn()) {
+                    noteTime += check[i][j].getDurationInSeconds();
+                }
+            }
+        }
+    });
+    report("note scan (MidiFile)", seconds, file.size(), total);
+
+    MidiEventTable table(check);
+    std::vector<int> noteOns;
+    std::vector<double> durations;
+    double tableTime = 0.0;
+    seconds = bestOf(repetitions, [&]() {
+        tableTime = 0.0;
+        table.getNoteOnIndexes(noteOns);
+        table.getDurationsInSeconds(durations);
+        for (int index : noteOns) {
+            tableTime += durations[index];
+        }
+    });
+    report("note scan (MidiEventTable)", seconds, file.size(), total);
+    if (noteTime != tableTime) {
+        std::cerr << "Error: note scans disagree" << std::endl;
+        return 1;
+    }
+
+    std::span<const int> ticks = table.getTicks();
+    std::vector<double> times(ticks.size());
+    seconds = bestOf(repetitions, [&]() {
+        for (size_t i = 0; i < ticks.size(); i++) {
+            times[i] = check.getTimeInSeconds(ticks[i]);
+        }
+    });
+    report("tick to seconds (per call)", seconds, file.size(), total);
+
+    std::vector<double> batch;
+    seconds = bestOf(repetitions, [&]() {
+        check.getTimesInSeconds(ticks, batch);
+    });
+    report("tick to seconds (batch)", seconds, file.size(), total);
+    if (batch != times) {
+        std::cerr << "Error: tick conversions disagree" << std::endl;
+        return 1;
+    }
+
+    MidiFile joined(check);
+    joined.joinTracks();
+    joined.clearSequence();
+    seconds = bestOf(repetitions, [&]() {
+        MidiEvent** events = joined[0].data();
+        std::reverse(events, events + joined[0].size());
+        joined.sortTracks();
+    });
+    report("sortTracks (joined, reversed)", seconds, file.size(), total);
+    for (int i = 1; i < joined[0].size(); i++) {
+        if (joined[0][i - 1].tick > joined[0][i].tick) {
+            std::cerr << "Error: joined track is not sorted" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
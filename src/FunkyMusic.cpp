@@ -58,7 +58,9 @@ int stepCheck(SerialCommunication& serialComm) {
  * 
  * The main function initializes the serial communication and handles the program logic. 
  * It checks for command-line arguments and either plays a MIDI file or performs calibration 
- * based on the presence of a file argument.
+ * based on the presence of a file argument.  With `--stream <file>`, notes are played while the 
+ * file is being decoded instead of after it has been fully loaded.  A leading `--rate <r>` sets the 
+ * playback rate (for example 0.8 to play 20% slower).
  * 
  * @param argc The number of command-line arguments passed.
  * @param argv An array of C-string arguments.
@@ -67,16 +69,34 @@ int stepCheck(SerialCommunication& serialComm) {
  */
 int main(int argc, char* argv[]) {
     try {
+        // Optional playback rate before the other arguments.
+        double rate = 1.0;
+        if (argc >= 3 && std::string(argv[1]) == "--rate") {
+            rate = std::stod(argv[2]);
+            argc -= 2;
+            argv += 2;
+        }
+
         // Initialize serial communication with the given port name.
         std::string port_name = "/dev/ttyACM0";
         SerialCommunication serialComm(port_name);
         HarmonicaMapping harmonica;
 
         // If a file argument is provided, play the MIDI file.
-        if (argc == 2) {
+        if (argc == 3 && std::string(argv[1]) == "--stream") {
+            MidiNoteStream notes(argv[2]);
+            if (!notes.status()) {
+                std::cerr << "Error: cannot read " << argv[2] << std::endl;
+                return 1;
+            }
+            HarmonicaPlayer player(serialComm, harmonica);
+            player.setPlaybackRate(rate);
+            player.play(notes); // Play the notes as they are decoded.
+        } else if (argc == 2) {
             MidiHandler midiHandler(argv[1]);
             midiHandler.display();
             HarmonicaPlayer player(serialComm, harmonica, midiHandler);
+            player.setPlaybackRate(rate);
             player.play(); // Play the MIDI file.
         } else {
             // Otherwise, perform a step check on the serial communication.
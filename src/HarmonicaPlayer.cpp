@@ -12,6 +12,9 @@
 
 #include "HarmonicaPlayer.h"
 
+#include <algorithm>
+#include <vector>
+
 /**
  * @brief Constructs a HarmonicaPlayer object with the given serial communication, harmonica mapping, 
  *        and MIDI handler.
@@ -24,52 +27,136 @@
  * @param midiHandler A reference to a MidiHandler object used to handle the MIDI file and its events.
  */
 HarmonicaPlayer::HarmonicaPlayer(SerialCommunication& serial, HarmonicaMapping& harmonica, MidiHandler& midiHandler)
-    : serialComm(serial), harmonica(harmonica), midiHandler(midiHandler) {}
+    : serialComm(serial), harmonica(harmonica), midiHandler(&midiHandler) {}
+
+/**
+ * @brief Constructs a HarmonicaPlayer object without a loaded MIDI file.
+ * 
+ * A player created this way can only play notes from a MidiNoteStream.
+ * 
+ * @param serial A reference to a SerialCommunication object used for sending control commands to the harmonica.
+ * @param harmonica A reference to a HarmonicaMapping object that maps MIDI notes to harmonica hole numbers and actions.
+ */
+HarmonicaPlayer::HarmonicaPlayer(SerialCommunication& serial, HarmonicaMapping& harmonica)
+    : serialComm(serial), harmonica(harmonica), midiHandler(nullptr) {}
 
 /**
  * @brief Plays the MIDI file on the harmonica using serial communication.
  * 
- * The `play` method iterates through all tracks and events in the provided MIDI file. For each "Note On" event, 
- * it retrieves the corresponding MIDI note, calculates the note duration, and sends the appropriate commands 
- * to the harmonica via serial communication. The commands include:
+ * The `play` method extracts the notes of the MIDI file in onset order with `MidiFile::getNoteSpans` 
+ * and, for each one, waits until its onset and sends the appropriate commands to the harmonica via 
+ * serial communication. The commands include:
  * - Hole number (using `HarmonicaMapping::getHoleNumber`)
  * - Action (Blow or Draw, using `HarmonicaMapping::getAction`)
- * The program then sleeps for the duration of the note before proceeding to the next event.
+ * After the last note, the program sleeps until the latest note-off of the song.
  * 
- * @note This method assumes that the MIDI file contains valid "Note On" events and the serial communication 
- *       works without errors. Works best on one track files.
+ * Onsets are taken in integer nanoseconds (`NoteSpan::nanoseconds`) and turned into absolute 
+ * deadlines on the steady clock, so rests are kept, notes of different tracks play at their 
+ * written times, and the time spent talking to the serial device does not accumulate. Deadlines 
+ * are scaled by the playback rate (see setPlaybackRate()).
+ * 
+ * @note This method assumes that the serial communication works without errors. The harmonica 
+ *       plays one note at a time, so notes that overlap are cut off by the next onset, and a 
+ *       note that is never turned off does not hold back the end of the song.
  */
 void HarmonicaPlayer::play() {
-    int tracks = midiHandler.getMidiFile().getTrackCount();
-    
-    // Iterate through all tracks
-    for (int track = 0; track < tracks; track++) {
-        // Iterate through all events in the current track
-        for (int event = 0; event < midiHandler.getMidiFile()[track].size(); event++) {
-            // Check if the current event is a "Note On" event
-            if (midiHandler.getMidiFile()[track][event].isNoteOn()) {
-                // Get the note duration and MIDI key number
-                double noteDuration = midiHandler.getMidiFile()[track][event].getDurationInSeconds();
-                int note = midiHandler.getMidiFile()[track][event].getKeyNumber();
+    if (midiHandler == nullptr) {
+        throw std::runtime_error("No MIDI file loaded");
+    }
+    MidiFile& midifile = midiHandler->getMidiFile();
+    std::vector<smf::NoteSpan> notes;
+    midifile.getNoteSpans(notes);
+    clock.start();
 
-                // std::cout << "Playing Note: " << std::dec << note << " for " << noteDuration << " seconds." << std::endl;
+    int64_t end = 0;
+    for (const smf::NoteSpan& note : notes) {
+        // std::cout << "Playing Note: " << std::dec << note.key << " at " << note.nanoseconds << " ns." << std::endl;
 
-                // Send the corresponding hole number to the harmonica via serial communication
-                serialComm.write(harmonica.getHoleNumber(note));
-                serialComm.read();
+        playNote(note);
+        if (note.terminated) {
+            end = std::max(end, note.nanoseconds + note.nanoDuration);
+        }
+    }
 
-                // Send the corresponding action (Blow or Draw) to the harmonica via serial communication
-                serialComm.write(harmonica.getAction(note));
-                if(harmonica.getAction(note) == 1000) {
-                    std::cout << "BLOW " << noteDuration << std::endl;
-                } else {
-                    std::cout << "DRAW " << noteDuration << std::endl;
-                }
-                serialComm.read();
+    // Sleep until the last note has ended
+    std::this_thread::sleep_until(clock.advanceTo(std::chrono::nanoseconds(end)));
+}
 
-                // Sleep for the duration of the note
-                std::this_thread::sleep_for(std::chrono::duration<double>(noteDuration));
-            }
+/**
+ * @brief Plays notes on the harmonica while they are being read from a MIDI file.
+ * 
+ * Notes are taken from the stream one at a time in onset order, so playback starts as soon as 
+ * the first note has been decoded instead of after the whole file has been loaded and analyzed. 
+ * Like `play()`, each note is sent at its exact integer nanosecond onset. A note returned before 
+ * its note-off (`NoteSpan::truncated`) does not delay the end of the song, since its real end is 
+ * not known yet.
+ * 
+ * @param notes An open MidiNoteStream to play.
+ * 
+ * @throws std::runtime_error If the MIDI file could not be decoded.
+ */
+void HarmonicaPlayer::play(smf::MidiNoteStream& notes) {
+    smf::NoteSpan note;
+    clock.start();
+    int64_t end = 0;
+    while (notes.next(note)) {
+        playNote(note);
+        if (note.terminated) {
+            end = std::max(end, note.nanoseconds + note.nanoDuration);
         }
     }
+    if (!notes.status()) {
+        throw std::runtime_error("Error reading MIDI file");
+    }
+    std::this_thread::sleep_until(clock.advanceTo(std::chrono::nanoseconds(end)));
+}
+
+/**
+ * @brief Sets the playback rate.
+ * 
+ * A rate of 1.0 plays at the tempo written in the file, 0.8 plays 20% slower. The rate can be 
+ * changed from another thread while a song is playing; it applies from the next note on, without 
+ * touching the MIDI file or its time analysis.
+ * 
+ * @param rate The playback rate, greater than zero.
+ * 
+ * @throws std::invalid_argument If the rate is not a positive finite number.
+ */
+void HarmonicaPlayer::setPlaybackRate(double rate) {
+    clock.setRate(rate);
+}
+
+/**
+ * @brief Gets the playback rate.
+ */
+double HarmonicaPlayer::getPlaybackRate() const {
+    return clock.getRate();
+}
+
+/**
+ * @brief Plays a single note on the harmonica.
+ * 
+ * Sleeps until the onset of the note, then sends the hole number (using 
+ * `HarmonicaMapping::getHoleNumber`) and the action (Blow or Draw, using 
+ * `HarmonicaMapping::getAction`) to the harmonica.
+ * 
+ * @param note The note to play, with its onset and duration at the tempo written in the file.
+ */
+void HarmonicaPlayer::playNote(const smf::NoteSpan& note) {
+    // Sleep until the onset of the note at the current playback rate
+    std::this_thread::sleep_until(clock.advanceTo(std::chrono::nanoseconds(note.nanoseconds)));
+
+    // Send the corresponding hole number to the harmonica via serial communication
+    serialComm.write(harmonica.getHoleNumber(note.key));
+    serialComm.read();
+
+    // Send the corresponding action (Blow or Draw) to the harmonica via serial communication
+    serialComm.write(harmonica.getAction(note.key));
+    double seconds = std::chrono::duration<double>(std::chrono::nanoseconds(note.nanoDuration)).count();
+    if(harmonica.getAction(note.key) == 1000) {
+        std::cout << "BLOW " << seconds << std::endl;
+    } else {
+        std::cout << "DRAW " << seconds << std::endl;
+    }
+    serialComm.read();
 }
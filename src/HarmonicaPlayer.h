@@ -2,22 +2,33 @@
 #define HARMONICA_PLAYER_H
 
 #include <chrono>
+#include <stdexcept>
 #include <thread>
 
 #include "MidiHandler.h"
 #include "SerialCommunication.h"
 #include "HarmonicaMapping.h"
+#include "PlaybackClock.h"
+#include "midiFile/MidiNoteStream.h"
 
 class HarmonicaPlayer {
 public:
     HarmonicaPlayer(SerialCommunication& serial, HarmonicaMapping& harmonica, MidiHandler& midiHandler);
+    HarmonicaPlayer(SerialCommunication& serial, HarmonicaMapping& harmonica);
 
     void play();
+    void play(smf::MidiNoteStream& notes);
+
+    void setPlaybackRate(double rate);
+    double getPlaybackRate() const;
 
 private:
+    void playNote(const smf::NoteSpan& note);
+
     SerialCommunication& serialComm;
     HarmonicaMapping& harmonica;
-    MidiHandler& midiHandler;
+    MidiHandler* midiHandler;
+    PlaybackClock clock;
 };
 
 #endif
\ No newline at end of file
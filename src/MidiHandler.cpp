@@ -17,13 +17,15 @@
  * 
  * This constructor reads the MIDI file from the specified file path, performs time analysis 
  * on the MIDI data, and links any note pairs (for example, paired note-on and note-off events).
+ * The tracks are read, timed and linked on one thread per hardware thread, and each track is 
+ * timed and linked in a single visit.
  * 
  * @param file_path The path to the MIDI file that will be loaded and processed.
  */
 MidiHandler::MidiHandler(const std::string& file_path) {
-    midifile.read(file_path);               /**< Read the MIDI file from the specified path. */
-    midifile.doTimeAnalysis();              /**< Perform time analysis on the MIDI file. */
-    midifile.linkNotePairs();               /**< Link note pairs (e.g., note-on and note-off events). */
+    midifile.setThreadCount(0);                     /**< Use all hardware threads for per-track work. */
+    midifile.read(file_path);                       /**< Read the MIDI file from the specified path. */
+    midifile.doTimeAnalysisAndLinkNotePairs();      /**< Time the events and link note pairs (e.g., note-on and note-off events). */
 }
 
 /**
@@ -0,0 +1,112 @@
+/**
+ * @file PlaybackClock.cpp
+ * @brief This file contains the implementation of the PlaybackClock class, which turns 
+ *        positions in a song into wall-clock deadlines at an adjustable playback rate.
+ * 
+ * The clock keeps an anchor: a song position and the wall-clock time at which it was reached. 
+ * Every deadline is computed from the anchor in one step, so rounding does not accumulate. 
+ * Changing the rate only moves the anchor to the current song position, which costs the same 
+ * no matter how far into the song playback is.
+ */
+
+#include "PlaybackClock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @brief Constructs a PlaybackClock with the given rate, started at the current time.
+ * 
+ * @param rate The playback rate (see setRate()).
+ */
+PlaybackClock::PlaybackClock(double rate) : requestedRate(1.0), rate(1.0) {
+    setRate(rate);
+    start();
+}
+
+/**
+ * @brief Restarts the song at position zero.
+ * 
+ * @param now The wall-clock time at which the song starts.
+ */
+void PlaybackClock::start(Clock::time_point now) {
+    rate = requestedRate.load();
+    anchorTime = now;
+    anchorSongTime = std::chrono::nanoseconds(0);
+    songTime = std::chrono::nanoseconds(0);
+}
+
+/**
+ * @brief Sets the playback rate.
+ * 
+ * A rate of 1.0 plays at the tempo written in the file, 0.8 plays 20% slower and 1.25 plays 
+ * 25% faster. The new rate applies from the song position of the next call to advance(), so 
+ * it can be changed from another thread while a song is playing.
+ * 
+ * @param rate The playback rate, greater than zero.
+ * 
+ * @throws std::invalid_argument If the rate is not a positive finite number.
+ */
+void PlaybackClock::setRate(double rate) {
+    if (!std::isfinite(rate) || rate <= 0.0) {
+        throw std::invalid_argument("Playback rate must be greater than zero");
+    }
+    requestedRate.store(rate);
+}
+
+/**
+ * @brief Gets the most recently requested playback rate.
+ */
+double PlaybackClock::getRate() const {
+    return requestedRate.load();
+}
+
+/**
+ * @brief Moves the song position forward and returns its wall-clock deadline.
+ * 
+ * @param songDuration How far to move in song time (at rate 1.0).
+ * 
+ * @return The wall-clock time at which the new song position is reached.
+ */
+PlaybackClock::Clock::time_point PlaybackClock::advance(std::chrono::nanoseconds songDuration) {
+    return advanceTo(songTime + songDuration);
+}
+
+/**
+ * @brief Moves the song position to a point in the song and returns its wall-clock deadline.
+ * 
+ * If the rate has changed since the last call, the clock is first re-anchored at the current 
+ * song position and its deadline, so time already played is not rescaled. The song position 
+ * never moves backward; an earlier position returns the deadline of the current one.
+ * 
+ * @param position The song time from the start of the song (at rate 1.0).
+ * 
+ * @return The wall-clock time at which the song position is reached.
+ */
+PlaybackClock::Clock::time_point PlaybackClock::advanceTo(std::chrono::nanoseconds position) {
+    double requested = requestedRate.load(std::memory_order_relaxed);
+    if (requested != rate) {
+        anchorTime = deadlineAt(songTime);
+        anchorSongTime = songTime;
+        rate = requested;
+    }
+    songTime = std::max(songTime, position);
+    return deadlineAt(songTime);
+}
+
+/**
+ * @brief Gets the current song position.
+ */
+std::chrono::nanoseconds PlaybackClock::getSongTime() const {
+    return songTime;
+}
+
+/**
+ * @brief Computes the wall-clock time of a song position from the anchor at the current rate.
+ */
+PlaybackClock::Clock::time_point PlaybackClock::deadlineAt(std::chrono::nanoseconds position) const {
+    double elapsed = (double)(position - anchorSongTime).count() / rate;
+    return anchorTime + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::nanoseconds(std::llround(elapsed)));
+}
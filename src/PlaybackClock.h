@@ -0,0 +1,47 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+
+// Maps song time to wall-clock deadlines at an adjustable playback rate
+class PlaybackClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Constructor; rate 1.0 plays at the written tempo, 0.8 at 80% speed
+    explicit PlaybackClock(double rate = 1.0);
+
+    // Start the song at the given wall-clock time
+    void start(Clock::time_point now = Clock::now());
+
+    // Request a new rate; safe to call from another thread during playback
+    void setRate(double rate);
+    double getRate() const;
+
+    // Move the song position forward and return the wall-clock deadline for it
+    Clock::time_point advance(std::chrono::nanoseconds songDuration);
+
+    // Move the song position to the given time and return the wall-clock deadline for it
+    Clock::time_point advanceTo(std::chrono::nanoseconds position);
+
+    // Current song position
+    std::chrono::nanoseconds getSongTime() const;
+
+private:
+    Clock::time_point deadlineAt(std::chrono::nanoseconds songTime) const;
+
+    // Rate set by setRate(), picked up by the next advance() or advanceTo()
+    std::atomic<double> requestedRate;
+
+    // Rate used for the deadlines since the anchor
+    double rate;
+
+    // Wall-clock time at which the song was at anchorSongTime
+    Clock::time_point anchorTime;
+    std::chrono::nanoseconds anchorSongTime{0};
+
+    std::chrono::nanoseconds songTime{0};
+};
+
+#endif // PLAYBACK_CLOCK_H
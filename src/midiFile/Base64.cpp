@@ -0,0 +1,281 @@
+//
+// Creation Date: Sun Oct 18 09:12:45 PDT 2026
+// Filename:      midifile/src/Base64.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Base64 encoding and decoding of byte buffers, used by
+//                MidiFile::readBase64() and MidiFile::getBase64().
+//
+
+#include "Base64.h"
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+	#include <tmmintrin.h>
+#endif
+
+
+namespace smf {
+
+static const char encodeTable[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const int8_t decodeTable[256] = {
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+
+#if defined(__SSE2__)
+
+//////////////////////////////
+//
+// encodeBlock -- Encode 12 bytes into 16 characters.  Each 32-bit lane
+//    holds one group of three bytes, which is split into four 6-bit
+//    indexes that are mapped to ASCII by adding a per-range offset.
+//
+
+static inline void encodeBlock(const uchar* in, char* out) {
+	auto group = [](const uchar* p) {
+		return (int)(((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]);
+	};
+	__m128i w = _mm_setr_epi32(group(in), group(in+3), group(in+6), group(in+9));
+	__m128i six = _mm_set1_epi32(0x3f);
+	__m128i index = _mm_and_si128(_mm_srli_epi32(w, 18), six);
+	index = _mm_or_si128(index,
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 12), six), 8));
+	index = _mm_or_si128(index,
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 6), six), 16));
+	index = _mm_or_si128(index, _mm_slli_epi32(_mm_and_si128(w, six), 24));
+
+	// 'A'-'Z' = 0-25, 'a'-'z' = 26-51, '0'-'9' = 52-61, '+' = 62, '/' = 63
+	__m128i shift = _mm_set1_epi8(65);
+	shift = _mm_add_epi8(shift, _mm_and_si128(
+			_mm_cmpgt_epi8(index, _mm_set1_epi8(25)), _mm_set1_epi8(6)));
+	shift = _mm_sub_epi8(shift, _mm_and_si128(
+			_mm_cmpgt_epi8(index, _mm_set1_epi8(51)), _mm_set1_epi8(75)));
+	shift = _mm_sub_epi8(shift, _mm_and_si128(
+			_mm_cmpgt_epi8(index, _mm_set1_epi8(61)), _mm_set1_epi8(15)));
+	shift = _mm_add_epi8(shift, _mm_and_si128(
+			_mm_cmpgt_epi8(index, _mm_set1_epi8(62)), _mm_set1_epi8(3)));
+	_mm_storeu_si128((__m128i*)out, _mm_add_epi8(index, shift));
+}
+
+
+
+//////////////////////////////
+//
+// decodeBlock -- Decode 16 base64 characters into 12 bytes.  Returns
+//    false without writing anything if any of the characters is not in
+//    the base64 alphabet (padding and whitespace included), so that the
+//    caller can handle the block with the scalar code.  Up to 16 bytes
+//    are written at out.
+//
+
+static inline bool decodeBlock(const uchar* in, uchar* out) {
+	auto inRange = [](__m128i v, char low, char high) {
+		return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(low - 1)),
+				_mm_cmplt_epi8(v, _mm_set1_epi8(high + 1)));
+	};
+	// Characters 0x80-0xff are negative as signed bytes, so they fall
+	// outside all of the ranges.
+	__m128i c     = _mm_loadu_si128((const __m128i*)in);
+	__m128i upper = inRange(c, 'A', 'Z');
+	__m128i lower = inRange(c, 'a', 'z');
+	__m128i digit = inRange(c, '0', '9');
+	__m128i plus  = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+	__m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+			_mm_or_si128(digit, _mm_or_si128(plus, slash)));
+	if (_mm_movemask_epi8(valid) != 0xffff) {
+		return false;
+	}
+
+	__m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-65));
+	shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(-71)));
+	shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(4)));
+	shift = _mm_or_si128(shift, _mm_and_si128(plus,  _mm_set1_epi8(19)));
+	shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(16)));
+	__m128i v = _mm_add_epi8(c, shift);
+
+	// Join pairs of 6-bit values into 12 bits, then pairs of those into
+	// 24 bits, leaving each group of three bytes in one 32-bit lane.
+	v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00ff)), 6),
+			_mm_srli_epi16(v, 8));
+	v = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xffff)), 12),
+			_mm_srli_epi32(v, 16));
+
+#if defined(__SSSE3__)
+	v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+			14, 13, 12, -1, -1, -1, -1));
+	_mm_storeu_si128((__m128i*)out, v);
+#else
+	alignas(16) uint32_t lanes[4];
+	_mm_store_si128((__m128i*)lanes, v);
+	for (int i=0; i<4; i++) {
+		out[3*i]   = (uchar)(lanes[i] >> 16);
+		out[3*i+1] = (uchar)(lanes[i] >> 8);
+		out[3*i+2] = (uchar)lanes[i];
+	}
+#endif
+	return true;
+}
+
+#endif
+
+
+
+//////////////////////////////
+//
+// Base64::encode -- Append the base64 encoding of the input bytes to
+//    output, padded with "=" to a multiple of four characters.
+//
+
+void Base64::encode(std::span<const uchar> input, std::string& output) {
+	size_t start = output.size();
+	size_t length = input.size();
+	output.resize(start + (length + 2) / 3 * 4);
+	char* out = output.data() + start;
+	const uchar* in = input.data();
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; length - i >= 12; i += 12, out += 16) {
+		encodeBlock(in + i, out);
+	}
+#endif
+
+	for (; length - i >= 3; i += 3, out += 4) {
+		uint32_t group = ((uint32_t)in[i] << 16) | ((uint32_t)in[i+1] << 8) | in[i+2];
+		out[0] = encodeTable[(group >> 18) & 0x3f];
+		out[1] = encodeTable[(group >> 12) & 0x3f];
+		out[2] = encodeTable[(group >> 6) & 0x3f];
+		out[3] = encodeTable[group & 0x3f];
+	}
+
+	if (length - i == 1) {
+		out[0] = encodeTable[in[i] >> 2];
+		out[1] = encodeTable[(in[i] & 0x03) << 4];
+		out[2] = '=';
+		out[3] = '=';
+	} else if (length - i == 2) {
+		out[0] = encodeTable[in[i] >> 2];
+		out[1] = encodeTable[((in[i] & 0x03) << 4) | (in[i+1] >> 4)];
+		out[2] = encodeTable[(in[i+1] & 0x0f) << 2];
+		out[3] = '=';
+	}
+}
+
+
+
+//////////////////////////////
+//
+// Base64::decode -- Append the bytes encoded by a base64 string to output.
+//    Characters outside of the base64 alphabet (such as line breaks) are
+//    ignored, and decoding stops at the first "=".  Bits left over after
+//    the last complete byte are dropped.
+//
+
+void Base64::decode(std::string_view input, std::vector<uchar>& output) {
+	size_t start = output.size();
+	size_t length = input.size();
+	// Room for the largest possible result plus the overrun of the last
+	// block write.
+	output.resize(start + length / 4 * 3 + 3 + 16);
+	uchar* out = output.data() + start;
+	const uchar* in = (const uchar*)input.data();
+	size_t i = 0;
+	uint32_t bits = 0;
+	int count = 0;           // number of 6-bit values in bits
+
+	while (i < length) {
+		if (count == 0) {
+#if defined(__SSE2__)
+			while ((length - i >= 16) && decodeBlock(in + i, out)) {
+				i += 16;
+				out += 12;
+			}
+#endif
+			while (length - i >= 4) {
+				int8_t a = decodeTable[in[i]];
+				int8_t b = decodeTable[in[i+1]];
+				int8_t c = decodeTable[in[i+2]];
+				int8_t d = decodeTable[in[i+3]];
+				if ((a | b | c | d) < 0) {
+					break;
+				}
+				uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | (c << 6) | d;
+				out[0] = (uchar)(group >> 16);
+				out[1] = (uchar)(group >> 8);
+				out[2] = (uchar)group;
+				out += 3;
+				i += 4;
+			}
+			if (i >= length) {
+				break;
+			}
+		}
+
+		uchar ch = in[i++];
+		if (ch == '=') {
+			break;
+		}
+		int8_t value = decodeTable[ch];
+		if (value < 0) {
+			// Ignore whitespace, for example.
+			continue;
+		}
+		bits = (bits << 6) | value;
+		if (++count == 4) {
+			out[0] = (uchar)(bits >> 16);
+			out[1] = (uchar)(bits >> 8);
+			out[2] = (uchar)bits;
+			out += 3;
+			bits = 0;
+			count = 0;
+		}
+	}
+
+	if (count == 2) {
+		*out++ = (uchar)(bits >> 4);
+	} else if (count == 3) {
+		*out++ = (uchar)(bits >> 10);
+		*out++ = (uchar)(bits >> 2);
+	}
+	output.resize(out - output.data());
+}
+
+
+
+//////////////////////////////
+//
+// Base64::getInstructionSet -- Name of the vector instructions used by
+//    encode() and decode(), or "scalar" if there are none.
+//
+
+const char* Base64::getInstructionSet(void) {
+#if defined(__SSSE3__)
+	return "SSSE3";
+#elif defined(__SSE2__)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+
+} // end namespace smf
+
+
+
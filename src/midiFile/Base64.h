@@ -0,0 +1,42 @@
+//
+// Creation Date: Sun Oct 18 09:12:45 PDT 2026
+// Filename:      midifile/include/Base64.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Base64 encoding and decoding of byte buffers, used by
+//                MidiFile::readBase64() and MidiFile::getBase64().  Blocks
+//                of 12 bytes (16 characters) are converted with SSE2
+//                instructions when the compiler targets them; other
+//                processors, and input that is not a clean run of base64
+//                characters, use the scalar code.
+//
+
+#ifndef _BASE64_H_INCLUDED
+#define _BASE64_H_INCLUDED
+
+#include "MidiMessage.h"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace smf {
+
+class Base64 {
+	public:
+		static void        encode              (std::span<const uchar> input,
+		                                        std::string& output);
+		static void        decode              (std::string_view input,
+		                                        std::vector<uchar>& output);
+		static const char* getInstructionSet   (void);
+};
+
+} // end of namespace smf
+
+#endif /* _BASE64_H_INCLUDED */
+
+
+
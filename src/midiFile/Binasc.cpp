@@ -12,6 +12,8 @@
 #include "Binasc.h"
 
 #include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <sstream>
 
 
@@ -287,18 +289,35 @@ int Binasc::writeToBinary(std::ostream& out, const std::string& infile) {
 
 
 int Binasc::writeToBinary(std::ostream& out, std::istream& input) {
-	std::string inputLine;
-	inputLine.reserve(8196);
-	int  lineNum = 0;              // current line number
-	getline(input, inputLine, '\n');
-	lineNum++;
-	while (!input.eof()) {
-		int status = processLine(out, inputLine, lineNum);
-		if (!status) {
-			return 0;
+	std::string text((std::istreambuf_iterator<char>(input)),
+			std::istreambuf_iterator<char>());
+	std::vector<uchar> bytes;
+	int status = writeToBinary(bytes, text);
+	out.write((const char*)bytes.data(), bytes.size());
+	return status;
+}
+
+//
+// Compile text that is already in memory, appending the bytes to the
+// given vector.  The input is read in place: lines and words are views
+// into it, so the cost is linear in the size of the text.  If there is
+// an error, the bytes before the offending word are left in the vector.
+//
+
+int Binasc::writeToBinary(std::vector<uchar>& out, std::string_view input) {
+	out.reserve(out.size() + input.size() / 3);
+	int lineNum = 0;
+	size_t start = 0;
+	while (start < input.size()) {
+		size_t end = input.find('\n', start);
+		if (end == std::string_view::npos) {
+			end = input.size();
 		}
-		getline(input, inputLine, '\n');
 		lineNum++;
+		if (!processLine(out, input.substr(start, end - start), lineNum)) {
+			return 0;
+		}
+		start = end + 1;
 	}
 	return 1;
 }
@@ -532,48 +551,52 @@ int Binasc::outputStyleBoth(std::ostream& out, std::istream& input) {
 ///////////////////////////////
 //
 // Binasc::processLine -- Read a line of input and output any specified bytes.
+//     The line does not include its newline; a trailing carriage return is
+//     treated as whitespace.
 //
 
-int Binasc::processLine(std::ostream& out, const std::string& input,
+int Binasc::processLine(std::vector<uchar>& out, std::string_view input,
 		int lineCount) {
 	int status = 1;
-	int i = 0;
-	int length = (int)input.size();
-	std::string word;
+	size_t i = 0;
+	size_t length = input.size();
 	while (i<length) {
-		if ((input[i] == ';') || (input[i] == '#') || (input[i] == '/')) {
+		char ch = input[i];
+		if ((ch == ';') || (ch == '#') || (ch == '/')) {
 			// comment to end of line, so ignore
 			return status;
-		} else if ((input[i] == ' ') || (input[i] == '\n')
-				|| (input[i] == '\t')) {
+		} else if ((ch == ' ') || (ch == '\t') || (ch == '\r')) {
 			// ignore whitespace
 			i++;
 			continue;
-		} else if (input[i] == '+') {
-			i = getWord(word, input, " \n\t", i);
+		} else if (ch == '"') {
+			i = processStringWord(out, input, i);
+			continue;
+		}
+
+		size_t end = i;
+		while ((end < length) && (input[end] != ' ') && (input[end] != '\t')
+				&& (input[end] != '\r')) {
+			end++;
+		}
+		std::string_view word = input.substr(i, end - i);
+		i = end;
+
+		if (ch == '+') {
 			status = processAsciiWord(out, word, lineCount);
-		} else if (input[i] == '"') {
-			i = getWord(word, input, "\"", i);
-			status = processStringWord(out, word, lineCount);
-		} else if (input[i] == 'v') {
-			i = getWord(word, input, " \n\t", i);
+		} else if (ch == 'v') {
 			status = processVlvWord(out, word, lineCount);
-		} else if (input[i] == 'p') {
-			i = getWord(word, input, " \n\t", i);
+		} else if (ch == 'p') {
 			status = processMidiPitchBendWord(out, word, lineCount);
-		} else if (input[i] == 't') {
-			i = getWord(word, input, " \n\t", i);
+		} else if (ch == 't') {
 			status = processMidiTempoWord(out, word, lineCount);
+		} else if (word.find('\'') != std::string_view::npos) {
+			status = processDecimalWord(out, word, lineCount);
+		} else if ((word.find(',') != std::string_view::npos)
+				|| (word.size() > 2)) {
+			status = processBinaryWord(out, word, lineCount);
 		} else {
-			i = getWord(word, input, " \n\t", i);
-			if (word.find('\'') != std::string::npos) {
-				status = processDecimalWord(out, word, lineCount);
-			} else if ((word.find(',') != std::string::npos)
-					|| (word.size() > 2)) {
-				status = processBinaryWord(out, word, lineCount);
-			} else {
-				status = processHexWord(out, word, lineCount);
-			}
+			status = processHexWord(out, word, lineCount);
 		}
 
 		if (status == 0) {
@@ -587,46 +610,6 @@ int Binasc::processLine(std::ostream& out, const std::string& input,
 
 
 
-//////////////////////////////
-//
-// Binasc::getWord -- extract a sub string, stopping at any of the given
-//   terminator characters.
-//
-
-int Binasc::getWord(std::string& word, const std::string& input,
-		const std::string& terminators, int index) {
-	word.resize(0);
-	int i = index;
-	int escape = 0;
-	int ecount = 0;
-	if (terminators.find('"') != std::string::npos) {
-		escape = 1;
-	}
-	while (i < (int)input.size()) {
-		if (escape && input[i] == '\"') {
-			ecount++;
-			i++;
-			if (ecount >= 2) {
-				break;
-			}
-		}
-		if (escape && (i<(int)input.size()-1) && (input[i] == '\\')
-				&& (input[i+1] == '"')) {
-			word.push_back(input[i+1]);
-			i += 2;
-		} else if (terminators.find(input[i]) == std::string::npos) {
-			word.push_back(input[i]);
-			i++;
-		} else {
-			i++;
-			return i;
-		}
-	}
-	return i;
-}
-
-
-
 ///////////////////////////////
 //
 // Binasc::getVLV -- read a Variable-Length Value from the file
@@ -1197,7 +1180,7 @@ int Binasc::outputStyleMidi(std::ostream& out, std::istream& input) {
 //     constituent bytes
 //
 
-int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
+int Binasc::processDecimalWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	int length = (int)word.size();        // length of ascii binary number
 	int byteCount = -1;              // number of bytes to output
@@ -1331,22 +1314,26 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 
 	// process any floating point numbers possibilities
 	if (periodIndex != -1) {
-		double doubleOutput = atof(&word[quoteIndex+1]);
+		double doubleOutput = parseDouble(word.substr(quoteIndex+1));
 		float  floatOutput  = (float)doubleOutput;
+		uint32_t floatBits;
+		uint64_t doubleBits;
+		memcpy(&floatBits, &floatOutput, sizeof(floatBits));
+		memcpy(&doubleBits, &doubleOutput, sizeof(doubleBits));
 		switch (byteCount) {
 			case 4:
 			  if (endianIndex == -1) {
-				  writeBigEndianFloat(out, floatOutput);
+				  appendBigEndian(out, floatBits, 4);
 			  } else {
-				  writeLittleEndianFloat(out, floatOutput);
+				  appendLittleEndian(out, floatBits, 4);
 			  }
 			  return 1;
 			  break;
 			case 8:
 			  if (endianIndex == -1) {
-				  writeBigEndianDouble(out, doubleOutput);
+				  appendBigEndian(out, doubleBits, 8);
 			  } else {
-				  writeLittleEndianDouble(out, doubleOutput);
+				  appendLittleEndian(out, doubleBits, 8);
 			  }
 			  return 1;
 			  break;
@@ -1365,7 +1352,7 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 	// the byte if the size of the decimal number is not specified
 	if (byteCount == -1) {
 		if (signIndex != -1) {
-			long tempLong = atoi(&word[quoteIndex + 1]);
+			long tempLong = parseInt(word.substr(quoteIndex + 1));
 			if (tempLong > 127 || tempLong < -128) {
 				std::cerr << "Error on line " << lineNum << " at token: " << word
 					  << std::endl;
@@ -1373,10 +1360,10 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 				return 0;
 			}
 			char charOutput = (char)tempLong;
-			out << charOutput;
+			out.push_back((uchar)charOutput);
 			return 1;
 		} else {
-			ulong tempLong = (ulong)atoi(&word[quoteIndex + 1]);
+			ulong tempLong = (ulong)parseInt(word.substr(quoteIndex + 1));
 			uchar ucharOutput = (uchar)tempLong;
 			if (tempLong > 255) { // || (tempLong < 0)) {
 				std::cerr << "Error on line " << lineNum << " at token: " << word
@@ -1384,7 +1371,7 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 				std::cerr << "Decimal number out of range from 0 to 255" << std::endl;
 				return 0;
 			}
-			out << ucharOutput;
+			out.push_back(ucharOutput);
 			return 1;
 		}
 	}
@@ -1393,34 +1380,34 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 	switch (byteCount) {
 		case 1:
 			if (signIndex != -1) {
-				long tempLong = atoi(&word[quoteIndex + 1]);
+				long tempLong = parseInt(word.substr(quoteIndex + 1));
 				char charOutput = (char)tempLong;
-				out << charOutput;
+				out.push_back((uchar)charOutput);
 				return 1;
 			} else {
-				ulong tempLong = (ulong)atoi(&word[quoteIndex + 1]);
+				ulong tempLong = (ulong)parseInt(word.substr(quoteIndex + 1));
 				uchar ucharOutput = (uchar)tempLong;
-				out << ucharOutput;
+				out.push_back(ucharOutput);
 				return 1;
 			}
 			break;
 		case 2:
 			if (signIndex != -1) {
-				long tempLong = atoi(&word[quoteIndex + 1]);
+				long tempLong = parseInt(word.substr(quoteIndex + 1));
 				short shortOutput = (short)tempLong;
 				if (endianIndex == -1) {
-					writeBigEndianShort(out, shortOutput);
+					appendBigEndian(out, shortOutput, 2);
 				} else {
-					writeLittleEndianShort(out, shortOutput);
+					appendLittleEndian(out, shortOutput, 2);
 				}
 				return 1;
 			} else {
-				ulong tempLong = (ulong)atoi(&word[quoteIndex + 1]);
+				ulong tempLong = (ulong)parseInt(word.substr(quoteIndex + 1));
 				ushort ushortOutput = (ushort)tempLong;
 				if (endianIndex == -1) {
-					writeBigEndianUShort(out, ushortOutput);
+					appendBigEndian(out, ushortOutput, 2);
 				} else {
-					writeLittleEndianUShort(out, ushortOutput);
+					appendLittleEndian(out, ushortOutput, 2);
 				}
 				return 1;
 			}
@@ -1434,37 +1421,30 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 					  << std::endl;
 				return 0;
 			}
-			ulong tempLong = (ulong)atoi(&word[quoteIndex + 1]);
-			uchar byte1 = (uchar)((tempLong & 0x00ff0000) >> 16);
-			uchar byte2 = (uchar)((tempLong & 0x0000ff00) >> 8);
-			uchar byte3 = (uchar)((tempLong & 0x000000ff));
+			ulong tempLong = (ulong)parseInt(word.substr(quoteIndex + 1));
 			if (endianIndex == -1) {
-				out << byte1;
-				out << byte2;
-				out << byte3;
+				appendBigEndian(out, tempLong, 3);
 			} else {
-				out << byte3;
-				out << byte2;
-				out << byte1;
+				appendLittleEndian(out, tempLong, 3);
 			}
 			return 1;
 			}
 			break;
 		case 4:
 			if (signIndex != -1) {
-				long tempLong = atoi(&word[quoteIndex + 1]);
+				long tempLong = parseInt(word.substr(quoteIndex + 1));
 				if (endianIndex == -1) {
-					writeBigEndianLong(out, tempLong);
+					appendBigEndian(out, tempLong, 4);
 				} else {
-					writeLittleEndianLong(out, tempLong);
+					appendLittleEndian(out, tempLong, 4);
 				}
 				return 1;
 			} else {
-				ulong tempuLong = (ulong)atoi(&word[quoteIndex + 1]);
+				ulong tempuLong = (ulong)parseInt(word.substr(quoteIndex + 1));
 				if (endianIndex == -1) {
-					writeBigEndianULong(out, tempuLong);
+					appendBigEndian(out, tempuLong, 4);
 				} else {
-					writeLittleEndianULong(out, tempuLong);
+					appendLittleEndian(out, tempuLong, 4);
 				}
 				return 1;
 			}
@@ -1485,7 +1465,7 @@ int Binasc::processDecimalWord(std::ostream& out, const std::string& word,
 //     its binary byte form.
 //
 
-int Binasc::processHexWord(std::ostream& out, const std::string& word,
+int Binasc::processHexWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	int length = (int)word.size();
 	uchar outputByte;
@@ -1502,8 +1482,13 @@ int Binasc::processHexWord(std::ostream& out, const std::string& word,
 		return 0;
 	}
 
-	outputByte = (uchar)strtol(word.c_str(), (char**)NULL, 16);
-	out << outputByte;
+	outputByte = 0;
+	for (int i=0; i<length; i++) {
+		char ch = word[i];
+		int digit = (ch <= '9') ? ch - '0' : (ch | 0x20) - 'a' + 10;
+		outputByte = (uchar)((outputByte << 4) | digit);
+	}
+	out.push_back(outputByte);
 	return 1;
 }
 
@@ -1511,14 +1496,28 @@ int Binasc::processHexWord(std::ostream& out, const std::string& word,
 
 //////////////////////////////
 //
-// Binasc::processStringWord -- interprets a binary word into
-//     its constituent byte
+// Binasc::processStringWord -- output the characters of a double-quoted
+//     string that starts at the given index of the line.  An escaped
+//     quote (\") is output as a quote; a missing closing quote ends the
+//     string at the end of the line.  Returns the index after the string.
 //
 
-int Binasc::processStringWord(std::ostream& out, const std::string& word,
-		int /* lineNum */) {
-	out << word;
-	return 1;
+size_t Binasc::processStringWord(std::vector<uchar>& out,
+		std::string_view input, size_t index) {
+	size_t i = index + 1;
+	size_t length = input.size();
+	while (i < length) {
+		if ((input[i] == '\\') && (i < length - 1) && (input[i+1] == '"')) {
+			out.push_back('"');
+			i += 2;
+		} else if (input[i] == '"') {
+			return i + 1;
+		} else {
+			out.push_back((uchar)input[i]);
+			i++;
+		}
+	}
+	return i;
 }
 
 
@@ -1529,7 +1528,7 @@ int Binasc::processStringWord(std::ostream& out, const std::string& word,
 //     its constituent byte
 //
 
-int Binasc::processAsciiWord(std::ostream& out, const std::string& word,
+int Binasc::processAsciiWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	int length = (int)word.size();
 	uchar outputByte;
@@ -1552,7 +1551,7 @@ int Binasc::processAsciiWord(std::ostream& out, const std::string& word,
 	} else {
 		outputByte = ' ';
 	}
-	out << outputByte;
+	out.push_back(outputByte);
 	return 1;
 }
 
@@ -1564,7 +1563,7 @@ int Binasc::processAsciiWord(std::ostream& out, const std::string& word,
 //     its constituent byte
 //
 
-int Binasc::processBinaryWord(std::ostream& out, const std::string& word,
+int Binasc::processBinaryWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	int length = (int)word.size();        // length of ascii binary number
 	int commaIndex = -1;             // index location of comma in number
@@ -1655,7 +1654,7 @@ int Binasc::processBinaryWord(std::ostream& out, const std::string& word,
 	}
 
 	// send the byte to the output
-	out << output;
+	out.push_back(output);
 	return 1;
 }
 
@@ -1672,7 +1671,7 @@ int Binasc::processBinaryWord(std::ostream& out, const std::string& word,
 //   without space by an integer.
 //
 
-int Binasc::processVlvWord(std::ostream& out, const std::string& word,
+int Binasc::processVlvWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	if (word.size() < 2) {
 		std::cerr << "Error on line: " << lineNum
@@ -1686,7 +1685,7 @@ int Binasc::processVlvWord(std::ostream& out, const std::string& word,
 			  << std::endl;
 		return 0;
 	}
-	ulong value = atoi(&word[1]);
+	ulong value = parseInt(word.substr(1));
 
 	uchar byte[5];
 	byte[0] = (value >> 28) & 0x7f;
@@ -1708,7 +1707,7 @@ int Binasc::processVlvWord(std::ostream& out, const std::string& word,
 
 	for (i=0; i<5; i++) {
 		if (byte[i] >= 0x80 || i == 4) {
-			out << byte[i];
+			out.push_back(byte[i]);
 		}
 	}
 
@@ -1723,7 +1722,7 @@ int Binasc::processVlvWord(std::ostream& out, const std::string& word,
 //   a three-byte number of microseconds per beat per minute value.
 //
 
-int Binasc::processMidiTempoWord(std::ostream& out, const std::string& word,
+int Binasc::processMidiTempoWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	if (word.size() < 2) {
 		std::cerr << "Error on line: " << lineNum
@@ -1738,7 +1737,7 @@ int Binasc::processMidiTempoWord(std::ostream& out, const std::string& word,
 			  << "a floating-point number" << std::endl;
 		return 0;
 	}
-	double value = strtod(&word[1], NULL);
+	double value = parseDouble(word.substr(1));
 
 	if (value < 0.0) {
 		value = -value;
@@ -1746,10 +1745,7 @@ int Binasc::processMidiTempoWord(std::ostream& out, const std::string& word,
 
 	int intval = int(60.0 * 1000000.0 / value + 0.5);
 
-	uchar byte0 = intval & 0xff;
-	uchar byte1 = (intval >>  8) & 0xff;
-	uchar byte2 = (intval >> 16) & 0xff;
-	out << byte2 << byte1 << byte0;
+	appendBigEndian(out, (uint64_t)intval, 3);
 	return 1;
 }
 
@@ -1764,7 +1760,7 @@ int Binasc::processMidiTempoWord(std::ostream& out, const std::string& word,
 //   7-bits of the 14-bit value, then the MSB coming second and containing
 //   the top 7-bits of the 14-bit value.
 
-int Binasc::processMidiPitchBendWord(std::ostream& out, const std::string& word,
+int Binasc::processMidiPitchBendWord(std::vector<uchar>& out, std::string_view word,
 		int lineNum) {
 	if (word.size() < 2) {
 		std::cerr << "Error on line: " << lineNum
@@ -1779,7 +1775,7 @@ int Binasc::processMidiPitchBendWord(std::ostream& out, const std::string& word,
 			  << "a floating-point number" << std::endl;
 		return 0;
 	}
-	double value = strtod(&word[1], NULL);
+	double value = parseDouble(word.substr(1));
 
 	if (value > 1.0) {
 		value = 1.0;
@@ -1791,12 +1787,77 @@ int Binasc::processMidiPitchBendWord(std::ostream& out, const std::string& word,
 	int intval = (int)(((1 << 13)-0.5)  * (value + 1.0) + 0.5);
 	uchar LSB = intval & 0x7f;
 	uchar MSB = (intval >>  7) & 0x7f;
-	out << LSB << MSB;
+	out.push_back(LSB);
+	out.push_back(MSB);
 	return 1;
 }
 
 
 
+//////////////////////////////
+//
+// Binasc::appendBigEndian -- append the lowest count bytes of a value,
+//     most significant byte first.
+//
+
+void Binasc::appendBigEndian(std::vector<uchar>& out, uint64_t value,
+		int count) {
+	for (int i=count-1; i>=0; i--) {
+		out.push_back((uchar)(value >> (8 * i)));
+	}
+}
+
+
+
+//////////////////////////////
+//
+// Binasc::appendLittleEndian -- append the lowest count bytes of a value,
+//     least significant byte first.
+//
+
+void Binasc::appendLittleEndian(std::vector<uchar>& out, uint64_t value,
+		int count) {
+	for (int i=0; i<count; i++) {
+		out.push_back((uchar)(value >> (8 * i)));
+	}
+}
+
+
+
+//////////////////////////////
+//
+// Binasc::parseInt -- atoi() for a word that is not null-terminated.
+//
+
+int Binasc::parseInt(std::string_view text) {
+	char buffer[64];
+	if (text.size() >= sizeof(buffer)) {
+		return atoi(std::string(text).c_str());
+	}
+	memcpy(buffer, text.data(), text.size());
+	buffer[text.size()] = '\0';
+	return atoi(buffer);
+}
+
+
+
+//////////////////////////////
+//
+// Binasc::parseDouble -- strtod() for a word that is not null-terminated.
+//
+
+double Binasc::parseDouble(std::string_view text) {
+	char buffer[64];
+	if (text.size() >= sizeof(buffer)) {
+		return strtod(std::string(text).c_str(), NULL);
+	}
+	memcpy(buffer, text.data(), text.size());
+	buffer[text.size()] = '\0';
+	return strtod(buffer, NULL);
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // Ordered byte writing functions --
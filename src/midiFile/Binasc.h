@@ -13,10 +13,13 @@
 #ifndef _BINASC_H_INCLUDED
 #define _BINASC_H_INCLUDED
 
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 namespace smf {
@@ -59,6 +62,8 @@ class Binasc {
 		                                              const std::string& infile);
 		int                  writeToBinary           (std::ostream& out,
 		                                              std::istream& input);
+		int                  writeToBinary           (std::vector<uchar>& out,
+		                                              std::string_view input);
 
 		// functions for converting into an ASCII file with hex bytes:
 		int                  readFromBinary          (const std::string&
@@ -108,33 +113,39 @@ class Binasc {
 
 	private:
 		// helper functions for reading ASCII content to conver to binary:
-		int                  processLine             (std::ostream& out,
-		                                              const std::string& input,
+		int                  processLine             (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processAsciiWord        (std::ostream& out,
-		                                              const std::string& input,
+		int                  processAsciiWord        (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processStringWord       (std::ostream& out,
-		                                              const std::string& input,
+		size_t               processStringWord       (std::vector<uchar>& out,
+		                                              std::string_view input,
+		                                              size_t index);
+		int                  processBinaryWord       (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processBinaryWord       (std::ostream& out,
-		                                              const std::string& input,
+		int                  processDecimalWord      (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processDecimalWord      (std::ostream& out,
-		                                              const std::string& input,
+		int                  processHexWord          (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processHexWord          (std::ostream& out,
-		                                              const std::string& input,
+		int                  processVlvWord          (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processVlvWord          (std::ostream& out,
-		                                              const std::string& input,
+		int                  processMidiPitchBendWord(std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
-		int                  processMidiPitchBendWord(std::ostream& out,
-		                                              const std::string& input,
-		                                              int lineNum);
-		int                  processMidiTempoWord    (std::ostream& out,
-		                                              const std::string& input,
+		int                  processMidiTempoWord    (std::vector<uchar>& out,
+		                                              std::string_view input,
 		                                              int lineNum);
+		static void          appendBigEndian         (std::vector<uchar>& out,
+		                                              uint64_t value, int count);
+		static void          appendLittleEndian      (std::vector<uchar>& out,
+		                                              uint64_t value, int count);
+		static int           parseInt                (std::string_view text);
+		static double        parseDouble             (std::string_view text);
 
 		// helper functions for reading binary content to convert to ASCII:
 		int  outputStyleAscii   (std::ostream& out, std::istream& input);
@@ -146,8 +157,6 @@ class Binasc {
 		int  readMidiEvent  (std::ostream& out, std::istream& infile,
 		                     int& trackbytes, int& command);
 		int  getVLV         (std::istream& infile, int& trackbytes);
-		int  getWord        (std::string& word, const std::string& input,
-		                     const std::string& terminators, int index);
 
 		static const char *GMinstrument[128];
 
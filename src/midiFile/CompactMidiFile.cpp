@@ -0,0 +1,340 @@
+//
+// Creation Date: Sun Oct 18 15:42:08 PDT 2026
+// Filename:      midifile/src/CompactMidiFile.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Compact in-memory copy of a MidiFile for keeping many
+//                songs resident.
+//
+
+#include "CompactMidiFile.h"
+#include "MidiFile.h"
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// CompactMidiFile::CompactMidiFile -- Constructor.
+//
+
+CompactMidiFile::CompactMidiFile(void) {
+	clear();
+}
+
+
+CompactMidiFile::CompactMidiFile(const MidiFile& midifile) {
+	pack(midifile);
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::pack -- Store a copy of all events of a MidiFile.
+//    Ticks are stored as absolute ticks whatever the tick state of the
+//    file, and unpack() restores the tick state.
+//
+
+void CompactMidiFile::pack(const MidiFile& midifile) {
+	clear();
+	m_ticksPerQuarterNote = midifile.getTicksPerQuarterNote();
+	m_deltaTicks = midifile.isDeltaTicks();
+	m_joinedTracks = midifile.hasJoinedTracks();
+
+	int tracks = midifile.getTrackCount();
+	size_t count = 0;
+	for (int i=0; i<tracks; i++) {
+		count += midifile[i].size();
+	}
+	m_events.reserve(count);
+	m_trackStart.clear();
+	m_trackStart.reserve(tracks + 1);
+	for (int i=0; i<tracks; i++) {
+		m_trackStart.push_back((uint32_t)m_events.size());
+		packTrack(midifile[i], m_deltaTicks);
+	}
+	m_trackStart.push_back((uint32_t)m_events.size());
+	m_outOfLine.shrink_to_fit();
+	m_bytes.shrink_to_fit();
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::unpack -- Replace the contents of a MidiFile with the
+//    stored events.  Event ticks, tracks and bytes, the order of events
+//    in each track, the ticks per quarter note and the track and tick
+//    states are restored.  Sequence numbers are marked in track order as
+//    when reading a file; call doTimeAnalysis() and linkNotePairs() if
+//    seconds and note links are needed.
+//
+
+void CompactMidiFile::unpack(MidiFile& midifile) const {
+	midifile.clear();
+	int tracks = getTrackCount();
+	if (tracks > 1) {
+		midifile.addTracks(tracks - 1);
+	}
+	midifile.setTicksPerQuarterNote(m_ticksPerQuarterNote);
+
+	for (int i=0; i<tracks; i++) {
+		MidiEventList& list = midifile[i];
+		list.reserve(getEventCount(i));
+		for (uint32_t j=m_trackStart[i]; j<m_trackStart[i+1]; j++) {
+			const PackedEvent& packed = m_events[j];
+			MidiEvent& event = list.emplace_back((int)packed.tick, i);
+			if (packed.message & OUT_OF_LINE) {
+				const OutOfLineEvent& other = m_outOfLine[packed.message & ~OUT_OF_LINE];
+				event.track = other.track;
+				event.assign(m_bytes.data() + other.offset,
+						m_bytes.data() + other.offset + other.size);
+			} else {
+				uchar bytes[3] = {(uchar)packed.message,
+						(uchar)(packed.message >> 8), (uchar)(packed.message >> 16)};
+				event.track = (int)(packed.message >> 24);
+				event.assign(bytes, bytes + MidiMessage::getChannelMessageSize(bytes[0]));
+			}
+		}
+	}
+
+	midifile.markSequence();
+	if (m_joinedTracks) {
+		// With a single track this only marks the tracks as joined.
+		midifile.joinTracks();
+	}
+	if (m_deltaTicks) {
+		midifile.makeDeltaTicks();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::clear -- Remove all events and release their memory.
+//
+
+void CompactMidiFile::clear(void) {
+	std::vector<PackedEvent>().swap(m_events);
+	std::vector<OutOfLineEvent>().swap(m_outOfLine);
+	std::vector<uchar>().swap(m_bytes);
+	m_trackStart.assign(1, 0);
+	m_ticksPerQuarterNote = 120;
+	m_deltaTicks = false;
+	m_joinedTracks = false;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::size -- Total number of events in all tracks.
+//
+
+int CompactMidiFile::size(void) const {
+	return (int)m_events.size();
+}
+
+
+bool CompactMidiFile::empty(void) const {
+	return m_events.empty();
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getTrackCount -- Number of tracks (event lists) in
+//    the source file.
+//
+
+int CompactMidiFile::getTrackCount(void) const {
+	return (int)m_trackStart.size() - 1;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::hasJoinedTracks -- True if the source file was in
+//    joined-track state.
+//
+
+bool CompactMidiFile::hasJoinedTracks(void) const {
+	return m_joinedTracks;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getEventCount -- Number of events in a track.
+//
+
+int CompactMidiFile::getEventCount(int track) const {
+	return (int)(m_trackStart.at(track + 1) - m_trackStart.at(track));
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getTicksPerQuarterNote -- TPQ of the source file.
+//
+
+int CompactMidiFile::getTicksPerQuarterNote(void) const {
+	return m_ticksPerQuarterNote;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getMemoryUsage -- Number of bytes used by the object
+//    and the storage it owns.
+//
+
+size_t CompactMidiFile::getMemoryUsage(void) const {
+	return sizeof(*this)
+			+ m_events.capacity() * sizeof(PackedEvent)
+			+ m_trackStart.capacity() * sizeof(uint32_t)
+			+ m_outOfLine.capacity() * sizeof(OutOfLineEvent)
+			+ m_bytes.capacity();
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getTick -- Absolute tick of an event.
+//
+
+int CompactMidiFile::getTick(int track, int index) const {
+	return (int)getPacked(track, index).tick;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getTrack -- MidiEvent::track of an event.
+//
+
+int CompactMidiFile::getTrack(int track, int index) const {
+	const PackedEvent& packed = getPacked(track, index);
+	if (packed.message & OUT_OF_LINE) {
+		return m_outOfLine[packed.message & ~OUT_OF_LINE].track;
+	}
+	return (int)(packed.message >> 24);
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getMessageSize -- Number of bytes in an event.
+//
+
+int CompactMidiFile::getMessageSize(int track, int index) const {
+	const PackedEvent& packed = getPacked(track, index);
+	if (packed.message & OUT_OF_LINE) {
+		return (int)m_outOfLine[packed.message & ~OUT_OF_LINE].size;
+	}
+	return MidiMessage::getChannelMessageSize(packed.message & 0xff);
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getMessage -- Return the bytes of an event.
+//
+
+MidiMessage CompactMidiFile::getMessage(int track, int index) const {
+	const PackedEvent& packed = getPacked(track, index);
+	MidiMessage message;
+	if (packed.message & OUT_OF_LINE) {
+		const OutOfLineEvent& other = m_outOfLine[packed.message & ~OUT_OF_LINE];
+		message.assign(m_bytes.data() + other.offset,
+				m_bytes.data() + other.offset + other.size);
+	} else {
+		uchar bytes[3] = {(uchar)packed.message,
+				(uchar)(packed.message >> 8), (uchar)(packed.message >> 16)};
+		message.assign(bytes, bytes + MidiMessage::getChannelMessageSize(bytes[0]));
+	}
+	return message;
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::isOutOfLine -- True if the event is stored in the
+//    side table rather than packed into its 8-byte record.
+//
+
+bool CompactMidiFile::isOutOfLine(int track, int index) const {
+	return (getPacked(track, index).message & OUT_OF_LINE) != 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// CompactMidiFile::packTrack -- Append the events of one track.  Channel
+//    messages of the expected length on tracks 0 to MAX_INLINE_TRACK are
+//    packed; everything else goes out of line.
+//
+
+void CompactMidiFile::packTrack(const MidiEventList& list, bool delta) {
+	int tick = 0;
+	for (int i=0; i<list.size(); i++) {
+		const MidiEvent& event = list[i];
+		tick = delta ? tick + event.tick : event.tick;
+		PackedEvent packed;
+		packed.tick = (uint32_t)tick;
+		int size = (int)event.size();
+		const uchar* bytes = event.data();
+		if ((size > 0) && (size == MidiMessage::getChannelMessageSize(bytes[0]))
+				&& (event.track >= 0) && (event.track <= MAX_INLINE_TRACK)) {
+			packed.message = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8)
+					| ((uint32_t)(size > 2 ? bytes[2] : 0) << 16)
+					| ((uint32_t)event.track << 24);
+		} else {
+			packed.message = OUT_OF_LINE | (uint32_t)m_outOfLine.size();
+			OutOfLineEvent other;
+			other.track = event.track;
+			other.offset = (uint32_t)m_bytes.size();
+			other.size = (uint32_t)size;
+			m_outOfLine.push_back(other);
+			m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+		}
+		m_events.push_back(packed);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// CompactMidiFile::getPacked -- Return the record of an event.  The
+//    index is not checked against the length of the track.
+//
+
+const CompactMidiFile::PackedEvent& CompactMidiFile::getPacked(int track,
+		int index) const {
+	return m_events[m_trackStart.at(track) + index];
+}
+
+
+} // end namespace smf
+
+
+
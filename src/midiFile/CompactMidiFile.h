@@ -0,0 +1,111 @@
+//
+// Creation Date: Sun Oct 18 15:42:08 PDT 2026
+// Filename:      midifile/include/CompactMidiFile.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Compact in-memory copy of a MidiFile for keeping many
+//                songs resident.  Each event is stored in 8 bytes: its
+//                absolute tick and a 32-bit message word.  Channel
+//                messages are packed into the word as status/data1/data2
+//                plus the track number; meta, sysex and any other message
+//                keep their bytes in a side table and the word holds an
+//                index into it.  Seconds and note links are not stored
+//                since they can be recomputed after unpack() with
+//                doTimeAnalysis() and linkNotePairs().
+//
+
+#ifndef _COMPACTMIDIFILE_H_INCLUDED
+#define _COMPACTMIDIFILE_H_INCLUDED
+
+#include "MidiMessage.h"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace smf {
+
+class MidiEventList;
+class MidiFile;
+
+class CompactMidiFile {
+	public:
+		                 CompactMidiFile        (void);
+		                 CompactMidiFile        (const MidiFile& midifile);
+
+		void             pack                   (const MidiFile& midifile);
+		void             unpack                 (MidiFile& midifile) const;
+		void             clear                  (void);
+
+		int              size                   (void) const;
+		bool             empty                  (void) const;
+		int              getTrackCount          (void) const;
+		bool             hasJoinedTracks        (void) const;
+		int              getEventCount          (int track) const;
+		int              getTicksPerQuarterNote (void) const;
+		size_t           getMemoryUsage         (void) const;
+
+		// per-event access, index relative to the start of the track:
+		int              getTick                (int track, int index) const;
+		int              getTrack               (int track, int index) const;
+		int              getMessageSize         (int track, int index) const;
+		MidiMessage      getMessage             (int track, int index) const;
+		bool             isOutOfLine            (int track, int index) const;
+
+	protected:
+		// PackedEvent == one event in 8 bytes.  If the high bit of message
+		// is clear, its three low bytes are status, data1 and data2 of a
+		// channel message and the next 7 bits are MidiEvent::track.
+		// Otherwise the low 31 bits are an index into m_outOfLine.
+		struct PackedEvent {
+			uint32_t tick;
+			uint32_t message;
+		};
+		static_assert(sizeof(PackedEvent) == 8, "PackedEvent must be 8 bytes");
+
+		// OutOfLineEvent == an event that cannot be packed into the
+		// message word: its bytes are m_bytes[offset, offset+size).
+		struct OutOfLineEvent {
+			int      track;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		static const uint32_t OUT_OF_LINE = 0x80000000u;
+		static const int      MAX_INLINE_TRACK = 127;
+
+	private:
+		void             packTrack              (const MidiEventList& list,
+		                                         bool delta);
+		const PackedEvent& getPacked            (int track, int index) const;
+
+		// m_events == all events, track by track.
+		std::vector<PackedEvent>    m_events;
+
+		// m_trackStart == index of the first event of each track in
+		// m_events, followed by the total number of events.
+		std::vector<uint32_t>       m_trackStart;
+
+		// m_outOfLine == events stored outside of m_events, with their
+		// bytes in m_bytes.
+		std::vector<OutOfLineEvent> m_outOfLine;
+		std::vector<uchar>          m_bytes;
+
+		// m_ticksPerQuarterNote == TPQ of the source file.
+		int m_ticksPerQuarterNote = 120;
+
+		// m_deltaTicks == true if the source file was in delta-tick state.
+		bool m_deltaTicks = false;
+
+		// m_joinedTracks == true if the source file was in joined-track
+		// state, in which case there is a single track.
+		bool m_joinedTracks = false;
+};
+
+} // end of namespace smf
+
+#endif /* _COMPACTMIDIFILE_H_INCLUDED */
+
+
+
@@ -0,0 +1,211 @@
+//
+// Creation Date: Sat Oct 17 09:12:44 PDT 2026
+// Filename:      midifile/src/MappedFile.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Read-only view of a file's contents as one contiguous
+//                byte range.  The file is memory-mapped where the
+//                platform allows it, otherwise it is read into a buffer.
+//
+
+#include "MappedFile.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define MAPPEDFILE_USE_MMAP 1
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// MappedFile::MappedFile -- Constructor.
+//
+
+MappedFile::MappedFile(void) {
+	// do nothing
+}
+
+
+MappedFile::MappedFile(const std::string& filename) {
+	open(filename);
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::~MappedFile -- Deconstructor.  Unmap the file if it was mapped.
+//
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::open -- Map the given file into memory.  If the file cannot
+//    be mapped (empty file, pipe, or no mmap support), read it into an
+//    internal buffer instead.  Returns false if the file cannot be read.
+//
+
+bool MappedFile::open(const std::string& filename) {
+	close();
+
+#ifdef MAPPEDFILE_USE_MMAP
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if ((fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size > 0)) {
+		void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED) {
+			// The whole file is parsed front to back, so let the kernel
+			// read ahead aggressively.
+			madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+			m_mapping = mapping;
+			m_size    = (size_t)info.st_size;
+			m_open    = true;
+			::close(fd);
+			return m_open;
+		}
+	}
+	::close(fd);
+#endif
+
+	m_open = readToBuffer(filename);
+	return m_open;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::assign -- Hold a copy of the given bytes instead of a
+//    file, so that in-memory data can be kept alive the same way.
+//
+
+void MappedFile::assign(std::span<const uchar> data) {
+	close();
+	m_buffer.assign(data.begin(), data.end());
+	m_size = m_buffer.size();
+	m_open = true;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::close -- Release the mapping or buffer.
+//
+
+void MappedFile::close(void) {
+#ifdef MAPPEDFILE_USE_MMAP
+	if (m_mapping != NULL) {
+		munmap(m_mapping, m_size);
+	}
+#endif
+	m_mapping = NULL;
+	m_size    = 0;
+	m_buffer.clear();
+	m_buffer.shrink_to_fit();
+	m_open    = false;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::isOpen -- Returns true if the file contents are available.
+//
+
+bool MappedFile::isOpen(void) const {
+	return m_open;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::isMapped -- Returns true if the contents are memory-mapped
+//    rather than copied into a buffer.
+//
+
+bool MappedFile::isMapped(void) const {
+	return m_mapping != NULL;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::data -- Return a pointer to the first byte of the file.
+//
+
+const uchar* MappedFile::data(void) const {
+	if (m_mapping != NULL) {
+		return static_cast<const uchar*>(m_mapping);
+	}
+	return m_buffer.data();
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::size -- Return the number of bytes in the file.
+//
+
+size_t MappedFile::size(void) const {
+	return m_size;
+}
+
+
+
+//////////////////////////////
+//
+// MappedFile::span -- Return the file contents as a byte span.
+//
+
+std::span<const uchar> MappedFile::span(void) const {
+	return std::span<const uchar>(data(), m_size);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MappedFile::readToBuffer -- Fallback for when the file cannot be mapped.
+//
+
+bool MappedFile::readToBuffer(const std::string& filename) {
+	std::ifstream input(filename.c_str(), std::ios::binary | std::ios::in);
+	if (!input.is_open()) {
+		return false;
+	}
+	m_buffer.assign(std::istreambuf_iterator<char>(input),
+			std::istreambuf_iterator<char>());
+	m_size = m_buffer.size();
+	return true;
+}
+
+
+} // end namespace smf
+
+
+
@@ -0,0 +1,65 @@
+//
+// Creation Date: Sat Oct 17 09:12:44 PDT 2026
+// Filename:      midifile/include/MappedFile.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Read-only view of a file's contents as one contiguous
+//                byte range.  The file is memory-mapped where the
+//                platform allows it, otherwise it is read into a buffer.
+//
+
+#ifndef _MAPPEDFILE_H_INCLUDED
+#define _MAPPEDFILE_H_INCLUDED
+
+#include "MidiMessage.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+
+namespace smf {
+
+class MappedFile {
+	public:
+		                       MappedFile   (void);
+		                       MappedFile   (const std::string& filename);
+		                       MappedFile   (const MappedFile& other) = delete;
+		                      ~MappedFile   ();
+
+		MappedFile&            operator=    (const MappedFile& other) = delete;
+
+		bool                   open         (const std::string& filename);
+		void                   assign       (std::span<const uchar> data);
+		void                   close        (void);
+		bool                   isOpen       (void) const;
+		bool                   isMapped     (void) const;
+		const uchar*           data         (void) const;
+		size_t                 size         (void) const;
+		std::span<const uchar> span         (void) const;
+
+	private:
+		bool                   readToBuffer (const std::string& filename);
+
+		// m_mapping == start of the memory-mapped region, or NULL if the
+		// contents were copied into m_buffer instead.
+		void*                  m_mapping = NULL;
+
+		// m_size == number of bytes in the file.
+		size_t                 m_size = 0;
+
+		// m_buffer == file contents when mapping is not possible.
+		std::vector<uchar>     m_buffer;
+
+		// m_open == true if the last open() call succeeded.
+		bool                   m_open = false;
+};
+
+} // end of namespace smf
+
+#endif /* _MAPPEDFILE_H_INCLUDED */
+
+
+
@@ -14,6 +14,7 @@
 #include "MidiEvent.h"
 
 #include <cstdlib>
+#include <utility>
 
 
 namespace smf {
@@ -44,7 +45,7 @@ MidiEvent::MidiEvent(int command, int p1, int p2)
 }
 
 
-MidiEvent::MidiEvent(int aTime, int aTrack, vector<uchar>& message)
+MidiEvent::MidiEvent(int aTime, int aTrack, std::vector<uchar>& message)
 		: MidiMessage(message) {
 	track       = aTrack;
 	tick        = aTime;
@@ -54,17 +55,27 @@ MidiEvent::MidiEvent(int aTime, int aTrack, vector<uchar>& message)
 }
 
 
-MidiEvent::MidiEvent(const MidiEvent& mfevent) : MidiMessage() {
+MidiEvent::MidiEvent(const MidiEvent& mfevent) : MidiMessage(mfevent) {
 	track   = mfevent.track;
 	tick    = mfevent.tick;
 	seconds = mfevent.seconds;
 	seq     = mfevent.seq;
 	m_eventlink = NULL;
+}
 
-	this->resize(mfevent.size());
-	for (int i=0; i<(int)this->size(); i++) {
-		(*this)[i] = mfevent[i];
-	}
+
+//
+// Move constructor: the message bytes are taken from the other event
+// instead of copied.  As with copying, the link is not transferred.
+//
+
+MidiEvent::MidiEvent(MidiEvent&& mfevent) noexcept
+		: MidiMessage(std::move(mfevent)) {
+	track   = mfevent.track;
+	tick    = mfevent.tick;
+	seconds = mfevent.seconds;
+	seq     = mfevent.seq;
+	m_eventlink = NULL;
 }
 
 
@@ -112,10 +123,21 @@ MidiEvent& MidiEvent::operator=(const MidiEvent& mfevent) {
 	seconds = mfevent.seconds;
 	seq     = mfevent.seq;
 	m_eventlink = NULL;
-	this->resize(mfevent.size());
-	for (int i=0; i<(int)this->size(); i++) {
-		(*this)[i] = mfevent[i];
+	this->assign(mfevent.begin(), mfevent.end());
+	return *this;
+}
+
+
+MidiEvent& MidiEvent::operator=(MidiEvent&& mfevent) noexcept {
+	if (this == &mfevent) {
+		return *this;
 	}
+	tick    = mfevent.tick;
+	track   = mfevent.track;
+	seconds = mfevent.seconds;
+	seq     = mfevent.seq;
+	m_eventlink = NULL;
+	MidiMessage::operator=(std::move(mfevent));
 	return *this;
 }
 
@@ -125,32 +147,26 @@ MidiEvent& MidiEvent::operator=(const MidiMessage& message) {
 		return *this;
 	}
 	clearVariables();
-	this->resize(message.size());
-	for (int i=0; i<(int)this->size(); i++) {
-		(*this)[i] = message[i];
-	}
+	this->assign(message.begin(), message.end());
 	return *this;
 }
 
 
-MidiEvent& MidiEvent::operator=(const vector<uchar>& bytes) {
+MidiEvent& MidiEvent::operator=(const std::vector<uchar>& bytes) {
 	clearVariables();
-	this->resize(bytes.size());
-	for (int i=0; i<(int)this->size(); i++) {
-		(*this)[i] = bytes[i];
-	}
+	this->assign(bytes.begin(), bytes.end());
 	return *this;
 }
 
 
-MidiEvent& MidiEvent::operator=(const vector<char>& bytes) {
+MidiEvent& MidiEvent::operator=(const std::vector<char>& bytes) {
 	clearVariables();
 	setMessage(bytes);
 	return *this;
 }
 
 
-MidiEvent& MidiEvent::operator=(const vector<int>& bytes) {
+MidiEvent& MidiEvent::operator=(const std::vector<int>& bytes) {
 	clearVariables();
 	setMessage(bytes);
 	return *this;
@@ -22,6 +22,8 @@
 
 namespace smf {
 
+class MidiEventArena;
+
 class MidiEvent : public MidiMessage {
 	public:
 		           MidiEvent             (void);
@@ -30,12 +32,14 @@ class MidiEvent : public MidiMessage {
 		           MidiEvent             (int command, int param1, int param2);
 		           MidiEvent             (const MidiMessage& message);
 		           MidiEvent             (const MidiEvent& mfevent);
+		           MidiEvent             (MidiEvent&& mfevent) noexcept;
 		           MidiEvent             (int aTime, int aTrack,
 		                                  std::vector<uchar>& message);
 
 		          ~MidiEvent             ();
 
 		MidiEvent& operator=             (const MidiEvent& mfevent);
+		MidiEvent& operator=             (MidiEvent&& mfevent) noexcept;
 		MidiEvent& operator=             (const MidiMessage& message);
 		MidiEvent& operator=             (const std::vector<uchar>& bytes);
 		MidiEvent& operator=             (const std::vector<char>& bytes);
@@ -64,7 +68,10 @@ class MidiEvent : public MidiMessage {
 
 	private:
 		MidiEvent* m_eventlink;  // used to match note-ons and note-offs
+		MidiEventArena* m_arena = NULL;  // arena holding the storage, if any
 
+	friend class MidiEventArena;
+	friend class MidiEventList;
 };
 
 
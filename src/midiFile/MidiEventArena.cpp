@@ -0,0 +1,161 @@
+//
+// Creation Date: Sun Oct 18 11:40:18 PDT 2026
+// Filename:      midifile/src/MidiEventArena.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Slab allocator for the MidiEvents of a MidiEventList.
+//
+
+#include "MidiEventArena.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// MidiEventArena::MidiEventArena -- Constructor.  No memory is allocated
+//    until the first event is created.
+//
+
+MidiEventArena::MidiEventArena(void) {
+	// do nothing
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::~MidiEventArena -- Free all slabs.  The events in them
+//    must already have been destroyed with release() by the lists that
+//    held them.
+//
+
+MidiEventArena::~MidiEventArena() {
+	// slabs are freed by m_slabs
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::create -- Construct an event in the arena, either empty
+//    or as a copy of another event (or from one that is moved in).  The
+//    event must be destroyed with release() rather than delete.
+//
+
+MidiEvent* MidiEventArena::create(void) {
+	MidiEvent* event = new (allocate()) MidiEvent;
+	event->m_arena = this;
+	return event;
+}
+
+
+MidiEvent* MidiEventArena::create(const MidiEvent& event) {
+	MidiEvent* copy = new (allocate()) MidiEvent(event);
+	copy->m_arena = this;
+	return copy;
+}
+
+
+MidiEvent* MidiEventArena::create(MidiEvent&& event) {
+	MidiEvent* moved = new (allocate()) MidiEvent(std::move(event));
+	moved->m_arena = this;
+	return moved;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::release -- Destroy an event that was created either by
+//    an arena or with new.  The storage of an arena event goes back to
+//    the free list of its arena, to be used by the next event created.
+//
+
+void MidiEventArena::release(MidiEvent* event) {
+	if (event == NULL) {
+		return;
+	}
+	if (event->m_arena) {
+		event->m_arena->recycle(event);
+	} else {
+		delete event;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::getSlabCount -- Number of memory blocks allocated.
+//
+
+int MidiEventArena::getSlabCount(void) const {
+	return (int)m_slabs.size();
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::getEventCount -- Number of events created in the arena
+//    (including any that have been released since).
+//
+
+size_t MidiEventArena::getEventCount(void) const {
+	return m_count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MidiEventArena::allocate -- Return uninitialized storage for one event,
+//    taking a released slot if there is one, and otherwise starting a new
+//    slab when the current one is full.
+//
+
+void* MidiEventArena::allocate(void) {
+	m_count++;
+	if (m_free != NULL) {
+		FreeSlot* slot = m_free;
+		m_free = slot->next;
+		slot->~FreeSlot();
+		return slot;
+	}
+	if (m_used == m_capacity) {
+		m_capacity = m_slabs.empty() ? MIN_SLAB_EVENTS
+				: std::min(m_capacity * 2, MAX_SLAB_EVENTS);
+		m_slabs.emplace_back(new std::byte[m_capacity * sizeof(MidiEvent)]);
+		m_used = 0;
+	}
+	return m_slabs.back().get() + (m_used++) * sizeof(MidiEvent);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventArena::recycle -- Destroy an event of the arena and put its
+//    storage at the front of the free list.
+//
+
+void MidiEventArena::recycle(MidiEvent* event) {
+	event->~MidiEvent();
+	m_free = new (static_cast<void*>(event)) FreeSlot{m_free};
+}
+
+
+} // end namespace smf
+
+
+
@@ -0,0 +1,86 @@
+//
+// Creation Date: Sun Oct 18 11:40:18 PDT 2026
+// Filename:      midifile/include/MidiEventArena.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Slab allocator for the MidiEvents of a MidiEventList.
+//                Events are constructed in large blocks instead of one
+//                heap allocation each.  Released events are kept on a
+//                free list for the next event created in the arena, and
+//                the blocks are freed together when the last list using
+//                the arena lets go of it.
+//
+//                An arena, including its free list, is not locked and
+//                may be used by only one thread at a time.  A list that
+//                owns its arena alone may be filled or cleared in
+//                parallel with other lists, as readSmf() does when it
+//                decodes tracks.  Lists that share arenas (after
+//                MidiEventList::adoptStorage(), such as in splitTracks())
+//                must not create or release events in parallel.
+//
+
+#ifndef _MIDIEVENTARENA_H_INCLUDED
+#define _MIDIEVENTARENA_H_INCLUDED
+
+#include "MidiEvent.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+namespace smf {
+
+class MidiEventArena {
+	public:
+		                MidiEventArena     (void);
+		                MidiEventArena     (const MidiEventArena& other) = delete;
+		               ~MidiEventArena     ();
+
+		MidiEventArena& operator=          (const MidiEventArena& other) = delete;
+
+		MidiEvent*      create             (void);
+		MidiEvent*      create             (const MidiEvent& event);
+		MidiEvent*      create             (MidiEvent&& event);
+		static void     release            (MidiEvent* event);
+
+		int             getSlabCount       (void) const;
+		size_t          getEventCount      (void) const;
+
+	private:
+		void*           allocate           (void);
+		void            recycle            (MidiEvent* event);
+
+		// FreeSlot == storage of a released event, linked into the free
+		// list in place of the event.
+		struct FreeSlot {
+			FreeSlot* next;
+		};
+
+		// m_slabs == raw storage for events.  Each slab is twice the
+		// size of the one before it, up to MAX_SLAB_EVENTS events.
+		std::vector<std::unique_ptr<std::byte[]>> m_slabs;
+
+		// m_used == number of events placed in the last slab, out of
+		// m_capacity.
+		int             m_used = 0;
+		int             m_capacity = 0;
+
+		// m_count == number of events created by the arena.
+		size_t          m_count = 0;
+
+		// m_free == released slots, reused before the last slab grows.
+		// Not locked (see the threading rule at the top of this file).
+		FreeSlot*       m_free = NULL;
+
+		static constexpr int MIN_SLAB_EVENTS = 64;
+		static constexpr int MAX_SLAB_EVENTS = 16384;
+};
+
+} // end of namespace smf
+
+#endif /* _MIDIEVENTARENA_H_INCLUDED */
+
+
+
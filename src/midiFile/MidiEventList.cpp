@@ -13,9 +13,11 @@
 #include "MidiEventList.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <functional>
 #include <iterator>
-#include <list>
+#include <queue>
 #include <utility>
 #include <vector>
 
@@ -40,10 +42,24 @@ MidiEventList::MidiEventList(void) {
 
 MidiEventList::MidiEventList(const MidiEventList& other) {
 	list.reserve(other.list.size());
-	auto it = other.list.begin();
-	std::generate_n(std::back_inserter(list), other.list.size(), [&]() -> MidiEvent* {
-		return new MidiEvent(**it++);
-	});
+	MidiEventArena& arena = getArena();
+	for (MidiEvent* event : other.list) {
+		list.push_back(arena.create(*event));
+	}
+	// Copied events are unlinked; restore the links from their indexes
+	// instead of matching the notes again, unless the events were linked
+	// or unlinked since then.
+	for (int i=0; i<(int)other.m_links.size(); i++) {
+		if (!other.isLinkIndexCurrent(i)) {
+			return;
+		}
+	}
+	m_links = other.m_links;
+	for (int i=0; i<(int)m_links.size(); i++) {
+		if (m_links[i] > i) {
+			list[i]->linkEvent(list[m_links[i]]);
+		}
+	}
 }
 
 
@@ -56,6 +72,11 @@ MidiEventList::MidiEventList(const MidiEventList& other) {
 MidiEventList::MidiEventList(MidiEventList&& other) {
 	list = std::move(other.list);
 	other.list.clear();
+	m_arena = std::move(other.m_arena);
+	m_sharedArenas = std::move(other.m_sharedArenas);
+	other.m_sharedArenas.clear();
+	m_links = std::move(other.m_links);
+	other.m_links.clear();
 }
 
 
@@ -137,17 +158,21 @@ const MidiEvent& MidiEventList::getEvent(int index) const {
 //////////////////////////////
 //
 // MidiEventList::clear -- De-allocate any MidiEvents present in the list
-//    and set the size of the list to 0.
+//    and set the size of the list to 0.  The event storage is released
+//    in bulk once no other list holds events from it.
 //
 
 void MidiEventList::clear(void) {
 	for (auto& item : list) {
 		if (item != NULL) {
-			delete item;
+			MidiEventArena::release(item);
 			item = NULL;
 		}
 	}
 	list.resize(0);
+	m_links.clear();
+	m_arena.reset();
+	m_sharedArenas.clear();
 }
 
 
@@ -156,10 +181,12 @@ void MidiEventList::clear(void) {
 //
 // MidiEventList::data -- Return the low-level array of MidiMessage
 //     pointers.  This is useful for applying your own sorting
-//     function to the list.
+//     function to the list.  The link indexes are dropped since the
+//     events may be reordered.
 //
 
 MidiEvent** MidiEventList::data(void) {
+	m_links.clear();
 	return list.data();
 }
 
@@ -209,12 +236,22 @@ int MidiEventList::getEventCount(void) const {
 //////////////////////////////
 //
 // MidiEventList::append -- add a MidiEvent at the end of the list.  Returns
-//     the index of the appended event.
+//     the index of the appended event.  The rvalue version moves the
+//     message bytes instead of copying them.
 //
 
 int MidiEventList::append(MidiEvent& event) {
-	MidiEvent* ptr = new MidiEvent(event);
+	MidiEvent* ptr = getArena().create(event);
 	list.push_back(ptr);
+	m_links.clear();
+	return (int)list.size()-1;
+}
+
+
+int MidiEventList::append(MidiEvent&& event) {
+	MidiEvent* ptr = getArena().create(std::move(event));
+	list.push_back(ptr);
+	m_links.clear();
 	return (int)list.size()-1;
 }
 
@@ -235,6 +272,43 @@ int MidiEventList::push_back(MidiEvent& event) {
 }
 
 
+int MidiEventList::push_back(MidiEvent&& event) {
+	return append(std::move(event));
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::emplace_back -- Construct an empty event at the end of
+//     the list and return it, so that it can be filled in place rather
+//     than copied in.  See MidiEventList.h for the variant that takes the
+//     tick, track and message bytes.
+//
+
+MidiEvent& MidiEventList::emplace_back(void) {
+	MidiEvent* ptr = getArena().create();
+	list.push_back(ptr);
+	m_links.clear();
+	return *ptr;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::pop_back -- Remove and deallocate the last event,
+//    unlinking it from its note-on or note-off first.
+//
+
+void MidiEventList::pop_back(void) {
+	list.back()->unlinkEvent();
+	MidiEventArena::release(list.back());
+	list.pop_back();
+	m_links.clear();
+}
+
+
 
 //////////////////////////////
 //
@@ -247,7 +321,8 @@ void MidiEventList::removeEmpties(void) {
 	int count = 0;
 	for (auto& item : list) {
 		if (item->empty()) {
-			delete item;
+			item->unlinkEvent();
+			MidiEventArena::release(item);
 			item = NULL;
 			count++;
 		}
@@ -255,6 +330,7 @@ void MidiEventList::removeEmpties(void) {
 	if (count == 0) {
 		return;
 	}
+	m_links.clear();
 	std::vector<MidiEvent*> newlist;
 	newlist.reserve(list.size() - count);
 	for (auto& item : list) {
@@ -285,240 +361,117 @@ int MidiEventList::linkEventPairs(void) {
 
 
 int MidiEventList::linkNotePairsFIFO(void) {
-	// Note-on states:
-	// dimension 1: MIDI channel (0-15)
-	// dimension 2: MIDI key     (0-127)  (but 0 not used for note-ons)
-	// dimension 3: List of active note-ons or note-offs (FIFO behavior).
-	std::vector<std::vector<std::list<MidiEvent*>>> noteons;
-	noteons.resize(16);
-	for (auto& noteon : noteons) {
-		noteon.resize(128);
-	}
+	return linkPairs(false, false);
+}
 
-	// Controller linking: The following General MIDI controller numbers are
-	// also monitored for linking within the track (but not between tracks).
-	// hex dec  name                                    range
-	// 40  64   Hold pedal (Sustain) on/off             0..63=off  64..127=on
-	// 41  65   Portamento on/off                       0..63=off  64..127=on
-	// 42  66   Sustenuto Pedal on/off                  0..63=off  64..127=on
-	// 43  67   Soft Pedal on/off                       0..63=off  64..127=on
-	// 44  68   Legato Pedal on/off                     0..63=off  64..127=on
-	// 45  69   Hold Pedal 2 on/off                     0..63=off  64..127=on
-	// 50  80   General Purpose Button                  0..63=off  64..127=on
-	// 51  81   General Purpose Button                  0..63=off  64..127=on
-	// 52  82   General Purpose Button                  0..63=off  64..127=on
-	// 53  83   General Purpose Button                  0..63=off  64..127=on
-	// 54  84   Undefined on/off                        0..63=off  64..127=on
-	// 55  85   Undefined on/off                        0..63=off  64..127=on
-	// 56  86   Undefined on/off                        0..63=off  64..127=on
-	// 57  87   Undefined on/off                        0..63=off  64..127=on
-	// 58  88   Undefined on/off                        0..63=off  64..127=on
-	// 59  89   Undefined on/off                        0..63=off  64..127=on
-	// 5A  90   Undefined on/off                        0..63=off  64..127=on
-	// 7A 122   Local Keyboard On/Off                   0..63=off  64..127=on
-
-	// first keep track of whether the controller is an on/off switch:
-	std::vector<std::pair<int, int>> contmap(128, {0, 0});
-	contmap[64] = {1, 0}; contmap[65] = {1, 1}; contmap[66] = {1, 2}; 
-	contmap[67] = {1, 3}; contmap[68] = {1, 4}; contmap[69] = {1, 5};
-	contmap[80] = {1, 6}; contmap[81] = {1, 7}; contmap[82] = {1, 8}; 
-	contmap[83] = {1, 9}; contmap[84] = {1, 10}; contmap[85] = {1, 11};
-	contmap[86] = {1, 12}; contmap[87] = {1, 13}; contmap[88] = {1, 14}; 
-	contmap[89] = {1, 15}; contmap[90] = {1, 16}; contmap[122] = {1, 17};
-
-	std::vector<std::vector<MidiEvent*>> contevents(18, std::vector<MidiEvent*>(16, nullptr));
-	std::vector<std::vector<int>> oldstates(18, std::vector<int>(16, -1));
 
-	int counter = 0;
-	for (int i = 0; i < getSize(); i++) {
-		MidiEvent* mev = &getEvent(i);
-		mev->unlinkEvent();
-
-		if (mev->isNoteOn()) {
-			int key = mev->getKeyNumber();
-			int channel = mev->getChannel();
-			noteons[channel][key].push_back(mev);  // Enqueue (FIFO)
-		} else if (mev->isNoteOff()) {
-			int key = mev->getKeyNumber();
-			int channel = mev->getChannel();
-			if (!noteons[channel][key].empty()) {  // **Check before accessing**
-				MidiEvent* noteon = noteons[channel][key].front(); // Safely access first event
-				noteons[channel][key].pop_front(); // Remove first event (FIFO)
-				noteon->linkEvent(mev);
-				counter++;
-			}
-		} else if (mev->isController()) {
-			int contnum = mev->getP1();
-			if (contmap[contnum].first) {
-				int conti = contmap[contnum].second;
-				int channel = mev->getChannel();
-				int contval = mev->getP2();
-				int contstate = contval < 64 ? 0 : 1;
-
-				if ((oldstates[conti][channel] == -1) && contstate) {
-					contevents[conti][channel] = mev;
-					oldstates[conti][channel] = contstate;
-				} else if (oldstates[conti][channel] == contstate) {
-					// Redundant controller state, ignore.
-				} else if ((oldstates[conti][channel] == 0) && contstate) {
-					contevents[conti][channel] = mev;
-					oldstates[conti][channel] = contstate;
-				} else if ((oldstates[conti][channel] == 1) && (contstate == 0)) {
-					contevents[conti][channel]->linkEvent(mev);
-					oldstates[conti][channel] = contstate;
-					contevents[conti][channel] = mev;
-				}
-			}
-		}
-	}
-	return counter;
+
+int MidiEventList::linkNotePairsLIFO(void) {
+	return linkPairs(true, false);
 }
 
 
 
-int MidiEventList::linkNotePairsLIFO(void) {
+//////////////////////////////
+//
+// MidiEventList::clearLinks -- remove all note-on/note-off links.
+//
 
-	// Note-on states:
-	// dimension 1: MIDI channel (0-15)
-	// dimension 2: MIDI key     (0-127)  (but 0 not used for note-ons)
-	// dimension 3: List of active note-ons or note-offs.
-	std::vector<std::vector<std::vector<MidiEvent*>>> noteons;
-	noteons.resize(16);
-	for (auto& noteon : noteons) {
-		noteon.resize(128);
+void MidiEventList::clearLinks(void) {
+	for (int i=0; i<(int)getSize(); i++) {
+		getEvent(i).unlinkEvent();
 	}
+	m_links.clear();
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::hasLinkIndexes -- True if the links made by the last
+//   linkNotePairs() call are also available as indexes into the list.
+//   The indexes are dropped when events are added, removed or sorted,
+//   and are kept when the list is copied if they still match the event
+//   links (see isLinkIndexCurrent()).
+//
+
+bool MidiEventList::hasLinkIndexes(void) const {
+	return !m_links.empty();
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::getLinkedIndex -- Return the index of the event linked
+//   to the given one, or -1 if it is not linked or the link indexes are
+//   not available (see hasLinkIndexes()).  If the event was linked or
+//   unlinked since its index was stored, the linked event is searched
+//   for in the list.
+//
 
-	// Controller linking: The following General MIDI controller numbers are
-	// also monitored for linking within the track (but not between tracks).
-	// hex dec  name                                    range
-	// 40  64   Hold pedal (Sustain) on/off             0..63=off  64..127=on
-	// 41  65   Portamento on/off                       0..63=off  64..127=on
-	// 42  66   Sustenuto Pedal on/off                  0..63=off  64..127=on
-	// 43  67   Soft Pedal on/off                       0..63=off  64..127=on
-	// 44  68   Legato Pedal on/off                     0..63=off  64..127=on
-	// 45  69   Hold Pedal 2 on/off                     0..63=off  64..127=on
-	// 50  80   General Purpose Button                  0..63=off  64..127=on
-	// 51  81   General Purpose Button                  0..63=off  64..127=on
-	// 52  82   General Purpose Button                  0..63=off  64..127=on
-	// 53  83   General Purpose Button                  0..63=off  64..127=on
-	// 54  84   Undefined on/off                        0..63=off  64..127=on
-	// 55  85   Undefined on/off                        0..63=off  64..127=on
-	// 56  86   Undefined on/off                        0..63=off  64..127=on
-	// 57  87   Undefined on/off                        0..63=off  64..127=on
-	// 58  88   Undefined on/off                        0..63=off  64..127=on
-	// 59  89   Undefined on/off                        0..63=off  64..127=on
-	// 5A  90   Undefined on/off                        0..63=off  64..127=on
-	// 7A 122   Local Keyboard On/Off                   0..63=off  64..127=on
-
-	// first keep track of whether the controller is an on/off switch:
-	std::vector<std::pair<int, int>> contmap;
-	contmap.resize(128);
-	std::pair<int, int> zero(0, 0);
-	std::fill(contmap.begin(), contmap.end(), zero);
-	contmap[64].first  = 1;   contmap[64].second = 0;
-	contmap[65].first  = 1;   contmap[65].second = 1;
-	contmap[66].first  = 1;   contmap[66].second = 2;
-	contmap[67].first  = 1;   contmap[67].second = 3;
-	contmap[68].first  = 1;   contmap[68].second = 4;
-	contmap[69].first  = 1;   contmap[69].second = 5;
-	contmap[80].first  = 1;   contmap[80].second = 6;
-	contmap[81].first  = 1;   contmap[81].second = 7;
-	contmap[82].first  = 1;   contmap[82].second = 8;
-	contmap[83].first  = 1;   contmap[83].second = 9;
-	contmap[84].first  = 1;   contmap[84].second = 10;
-	contmap[85].first  = 1;   contmap[85].second = 11;
-	contmap[86].first  = 1;   contmap[86].second = 12;
-	contmap[87].first  = 1;   contmap[87].second = 13;
-	contmap[88].first  = 1;   contmap[88].second = 14;
-	contmap[89].first  = 1;   contmap[89].second = 15;
-	contmap[90].first  = 1;   contmap[90].second = 16;
-	contmap[122].first = 1;   contmap[122].second = 17;
-
-	// dimensions:
-	// 1: mapped controller (0 to 17)
-	// 2: channel (0 to 15)
-	std::vector<std::vector<MidiEvent*>> contevents;
-	contevents.resize(18);
-	std::vector<std::vector<int>> oldstates;
-	oldstates.resize(18);
-	for (int i=0; i<18; i++) {
-		contevents[i].resize(16);
-		std::fill(contevents[i].begin(), contevents[i].end(), nullptr);
-		oldstates[i].resize(16);
-		std::fill(oldstates[i].begin(), oldstates[i].end(), -1);
+int MidiEventList::getLinkedIndex(int index) const {
+	if (m_links.empty()) {
+		return -1;
 	}
+	if (isLinkIndexCurrent(index)) {
+		return m_links[index];
+	}
+	const MidiEvent* linked = list[index]->getLinkedEvent();
+	if (linked == NULL) {
+		return -1;
+	}
+	auto found = std::find(list.begin(), list.end(), linked);
+	return found == list.end() ? -1 : (int)(found - list.begin());
+}
 
-	// Now iterate through the MidiEventList keeping track of note and
-	// select controller states and linking notes/controllers as needed.
-	int channel;
-	int key;
-	int contnum;
-	int contval;
-	int conti;
-	int contstate;
-	int counter = 0;
-	MidiEvent* mev;
-	MidiEvent* noteon;
-	for (int i=0; i<getSize(); i++) {
-		mev = &getEvent(i);
-		mev->unlinkEvent();
-		if (mev->isNoteOn()) {
-			// store the note-on to pair later with a note-off message.
-			key = mev->getKeyNumber();
-			channel = mev->getChannel();
-			noteons[channel][key].push_back(mev);
-		} else if (mev->isNoteOff()) {
-			key = mev->getKeyNumber();
-			channel = mev->getChannel();
-			if (noteons[channel][key].size() > 0) {
-				noteon = noteons[channel][key].back();
-				noteons[channel][key].pop_back();
-				noteon->linkEvent(mev);
-				counter++;
-			}
-		} else if (mev->isController()) {
-			contnum = mev->getP1();
-			if (contmap[contnum].first) {
-				conti     = contmap[contnum].second;
-				channel   = mev->getChannel();
-				contval   = mev->getP2();
-				contstate = contval < 64 ? 0 : 1;
-				if ((oldstates[conti][channel] == -1) && contstate) {
-					// a newly initialized onstate was detected, so store for
-					// later linking to an off state.
-					contevents[conti][channel] = mev;
-					oldstates[conti][channel] = contstate;
-				} else if (oldstates[conti][channel] == contstate) {
-					// the controller state is redundant and will be ignored.
-				} else if ((oldstates[conti][channel] == 0) && contstate) {
-					// controller is currently off, so store on-state for next link
-					contevents[conti][channel] = mev;
-					oldstates[conti][channel] = contstate;
-				} else if ((oldstates[conti][channel] == 1) && (contstate == 0)) {
-					// controller has just been turned off, so link to
-					// stored on-message.
-					contevents[conti][channel]->linkEvent(mev);
-					oldstates[conti][channel] = contstate;
-					// not necessary, but maybe use for something later:
-					contevents[conti][channel] = mev;
-				}
-			}
-		}
+
+
+//////////////////////////////
+//
+// MidiEventList::getLinkedEvent -- Return the event linked to the given
+//   one, or NULL.  Same as MidiEvent::getLinkedEvent().
+//
+
+MidiEvent* MidiEventList::getLinkedEvent(int index) {
+	return list[index]->getLinkedEvent();
+}
+
+
+const MidiEvent* MidiEventList::getLinkedEvent(int index) const {
+	return list[index]->getLinkedEvent();
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::getTickDuration -- Same as MidiEvent::getTickDuration()
+//   for the event at the given index.
+//
+
+int MidiEventList::getTickDuration(int index) const {
+	const MidiEvent* linked = getLinkedEvent(index);
+	if (linked == NULL) {
+		return 0;
 	}
-	return counter;
+	return std::abs(linked->tick - list[index]->tick);
 }
 
 
 
 //////////////////////////////
 //
-// MidiEventList::clearLinks -- remove all note-on/note-off links.
+// MidiEventList::getDurationInSeconds -- Same as
+//   MidiEvent::getDurationInSeconds() for the event at the given index.
 //
 
-void MidiEventList::clearLinks(void) {
-	for (int i=0; i<(int)getSize(); i++) {
-		getEvent(i).unlinkEvent();
+double MidiEventList::getDurationInSeconds(int index) const {
+	const MidiEvent* linked = getLinkedEvent(index);
+	if (linked == NULL) {
+		return 0.0;
 	}
+	return std::fabs(linked->seconds - list[index]->seconds);
 }
 
 
@@ -577,6 +530,7 @@ int MidiEventList::markSequence(int sequence) {
 
 void MidiEventList::detach(void) {
 	list.resize(0);
+	m_links.clear();
 }
 
 
@@ -590,11 +544,38 @@ void MidiEventList::detach(void) {
 
 int MidiEventList::push_back_no_copy(MidiEvent* event) {
 	list.push_back(event);
+	m_links.clear();
 	return (int)list.size()-1;
 }
 
 
 
+//////////////////////////////
+//
+// MidiEventList::adoptStorage -- Keep the event storage of another list
+//     alive for as long as this list exists.  Call this before moving
+//     events from the other list with push_back_no_copy() and detaching
+//     it; otherwise the moved events would be freed with the other list.
+//
+
+void MidiEventList::adoptStorage(MidiEventList& other) {
+	auto adopt = [this](const std::shared_ptr<MidiEventArena>& arena) {
+		if (!arena || (arena == m_arena)) {
+			return;
+		}
+		if (std::find(m_sharedArenas.begin(), m_sharedArenas.end(), arena)
+				== m_sharedArenas.end()) {
+			m_sharedArenas.push_back(arena);
+		}
+	};
+	adopt(other.m_arena);
+	for (auto& arena : other.m_sharedArenas) {
+		adopt(arena);
+	}
+}
+
+
+
 //////////////////////////////
 //
 // MidiEventList::operator=(MidiEventList) -- Assignment.
@@ -602,6 +583,9 @@ int MidiEventList::push_back_no_copy(MidiEvent* event) {
 
 MidiEventList& MidiEventList::operator=(MidiEventList& other) {
 	list.swap(other.list);
+	m_links.swap(other.m_links);
+	m_arena.swap(other.m_arena);
+	m_sharedArenas.swap(other.m_sharedArenas);
 	return *this;
 }
 
@@ -611,39 +595,343 @@ MidiEventList& MidiEventList::operator=(MidiEventList& other) {
 // private functions
 //
 
+//////////////////////////////
+//
+// MidiEventList::getArena -- Return the arena for new events, creating it
+//    if necessary.
+//
+
+MidiEventArena& MidiEventList::getArena(void) {
+	if (!m_arena) {
+		m_arena = std::make_shared<MidiEventArena>();
+	}
+	return *m_arena;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::isLinkIndexCurrent -- True if the stored link index of
+//    an event still matches its event link.  Editing an event in place,
+//    such as with MidiEvent::unlinkEvent(), does not update m_links.
+//
+
+bool MidiEventList::isLinkIndexCurrent(int index) const {
+	int link = m_links[index];
+	return list[index]->getLinkedEvent() == (link < 0 ? NULL : list[link]);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::linkIndexes -- Link two events both by pointer and by
+//    index, breaking any earlier links of either one.
+//
+
+void MidiEventList::linkIndexes(int first, int second) {
+	for (int index : {first, second}) {
+		if (m_links[index] >= 0) {
+			m_links[m_links[index]] = -1;
+		}
+	}
+	m_links[first] = second;
+	m_links[second] = first;
+	list[first]->linkEvent(list[second]);
+}
+
+
+
+//////////////////////////////
+//
+// switchControllerIndex -- Index of the on/off switch controllers that
+//    are linked by linkNotePairs() (the following General MIDI
+//    controller numbers are monitored for linking within the track but
+//    not between tracks), or -1 for any other controller.
+//
+//    hex dec  name                                    range
+//    40  64   Hold pedal (Sustain) on/off             0..63=off  64..127=on
+//    41  65   Portamento on/off                       0..63=off  64..127=on
+//    42  66   Sustenuto Pedal on/off                  0..63=off  64..127=on
+//    43  67   Soft Pedal on/off                       0..63=off  64..127=on
+//    44  68   Legato Pedal on/off                     0..63=off  64..127=on
+//    45  69   Hold Pedal 2 on/off                     0..63=off  64..127=on
+//    50  80   General Purpose Button                  0..63=off  64..127=on
+//    51  81   General Purpose Button                  0..63=off  64..127=on
+//    52  82   General Purpose Button                  0..63=off  64..127=on
+//    53  83   General Purpose Button                  0..63=off  64..127=on
+//    54  84   Undefined on/off                        0..63=off  64..127=on
+//    55  85   Undefined on/off                        0..63=off  64..127=on
+//    56  86   Undefined on/off                        0..63=off  64..127=on
+//    57  87   Undefined on/off                        0..63=off  64..127=on
+//    58  88   Undefined on/off                        0..63=off  64..127=on
+//    59  89   Undefined on/off                        0..63=off  64..127=on
+//    5A  90   Undefined on/off                        0..63=off  64..127=on
+//    7A 122   Local Keyboard On/Off                   0..63=off  64..127=on
+//
+
+static const int SWITCH_CONTROLLER_COUNT = 18;
+
+static int switchControllerIndex(int contnum) {
+	if ((contnum >= 64) && (contnum <= 69)) {
+		return contnum - 64;
+	} else if ((contnum >= 80) && (contnum <= 90)) {
+		return contnum - 80 + 6;
+	} else if (contnum == 122) {
+		return 17;
+	}
+	return -1;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventList::linkPairs -- Implementation of linkNotePairsFIFO()
+//    and linkNotePairsLIFO().  Pending note-ons are kept in one queue
+//    per channel and key, threaded through a per-thread scratch array
+//    of next-event indexes, so that after the first call on a thread
+//    linking a track allocates nothing besides m_links.  With lifo the
+//    queue is used as a stack: a note-off is paired with the latest
+//    pending note-on of its key instead of the earliest.
+//
+//    With allTracks, the caller links every track of the file, so an
+//    earlier link to an event in another track is only dropped on this
+//    side (the other track drops its own side).  No event outside of
+//    the list is written then, which lets MidiFile link the tracks in
+//    parallel.
+//
+
+int MidiEventList::linkPairs(bool lifo, bool allTracks) {
+	// LinkQueues == pending note-ons of each channel/key: the indexes of
+	// the first and last ones, or -1 if there are none, and for each
+	// pending note-on the index of the next one in its queue.
+	struct LinkQueues {
+		int              head[16 * 128];
+		int              tail[16 * 128];
+		std::vector<int> next;
+	};
+	thread_local LinkQueues queues;
+	std::fill(std::begin(queues.head), std::end(queues.head), -1);
+	std::fill(std::begin(queues.tail), std::end(queues.tail), -1);
+	if (queues.next.size() < list.size()) {
+		queues.next.resize(list.size());
+	}
+	int* head = queues.head;
+	int* tail = queues.tail;
+	int* next = queues.next.data();
+
+	// switch controller states, by controller index and channel:
+	int contevents[SWITCH_CONTROLLER_COUNT][16];
+	int oldstates[SWITCH_CONTROLLER_COUNT][16];
+	std::fill(&contevents[0][0], &contevents[0][0] + SWITCH_CONTROLLER_COUNT * 16, -1);
+	std::fill(&oldstates[0][0], &oldstates[0][0] + SWITCH_CONTROLLER_COUNT * 16, -1);
+
+	m_links.assign(list.size(), -1);
+	int counter = 0;
+	for (int i=0; i<(int)list.size(); i++) {
+		MidiEvent* mev = list[i];
+		if (allTracks) {
+			mev->m_eventlink = NULL;
+		} else {
+			mev->unlinkEvent();
+		}
+		if (mev->size() != 3) {
+			continue;
+		}
+		const uchar* bytes = mev->data();
+		int command = bytes[0] & 0xf0;
+		int channel = bytes[0] & 0x0f;
+		if ((command == 0x90) && (bytes[2] != 0)) {
+			// note-on: store to pair later with a note-off.
+			int slot = (channel << 7) | (bytes[1] & 0x7f);
+			if (lifo) {
+				next[i] = head[slot];
+				head[slot] = i;
+			} else {
+				next[i] = -1;
+				if (tail[slot] < 0) {
+					head[slot] = i;
+				} else {
+					next[tail[slot]] = i;
+				}
+				tail[slot] = i;
+			}
+		} else if ((command == 0x80) || (command == 0x90)) {
+			// note-off: pair with the first (or last) pending note-on.
+			int slot = (channel << 7) | (bytes[1] & 0x7f);
+			int noteon = head[slot];
+			if (noteon >= 0) {
+				head[slot] = next[noteon];
+				if (head[slot] < 0) {
+					tail[slot] = -1;
+				}
+				// Neither event can be linked yet, so there are no earlier
+				// links for linkIndexes() to break.
+				m_links[noteon] = i;
+				m_links[i] = noteon;
+				list[noteon]->linkEvent(mev);
+				counter++;
+			}
+		} else if (command == 0xb0) {
+			int conti = switchControllerIndex(bytes[1]);
+			if (conti < 0) {
+				continue;
+			}
+			int contstate = bytes[2] < 64 ? 0 : 1;
+			int& oldstate = oldstates[conti][channel];
+			int& contevent = contevents[conti][channel];
+			if ((oldstate == -1) && contstate) {
+				// a newly initialized onstate was detected, so store for
+				// later linking to an off state.
+				contevent = i;
+				oldstate = contstate;
+			} else if (oldstate == contstate) {
+				// the controller state is redundant and will be ignored.
+			} else if ((oldstate == 0) && contstate) {
+				// controller is currently off, so store on-state for next link
+				contevent = i;
+				oldstate = contstate;
+			} else if ((oldstate == 1) && (contstate == 0)) {
+				// controller has just been turned off, so link to
+				// stored on-message.
+				linkIndexes(contevent, i);
+				oldstate = contstate;
+				contevent = i;
+			}
+		}
+	}
+	return counter;
+}
+
+
 //////////////////////////////
 //
 // MidiEventList::sort -- Private because the MidiFile class keeps
 //    track of delta versus absolute tick states of the MidiEventList,
 //    and sorting is only allowed in absolute tick state (The MidiEventList
 //    does not know about delta/absolute tick states of its contents).
+//    See getSortKey() for the order of events on the same tick.
 //
 
 void MidiEventList::sortNoteOnsBeforeOffs(void) {
-	qsort(data(), getEventCount(), sizeof(MidiEvent*), MidiEventList::eventCompareNoteOnsBeforeOffs);
+	sortByKey(false);
 }
 
 void MidiEventList::sortNoteOffsBeforeOns(void) {
-	qsort(data(), getEventCount(), sizeof(MidiEvent*), MidiEventList::eventCompareNoteOnsBeforeOffs);
+	sortByKey(true);
 }
 
 
 
-///////////////////////////////////////////////////////////////////////////
-//
-// external functions
+//////////////////////////////
 //
+// MidiEventList::sortByKey -- Sort the events by getSortKey(), keeping
+//    the current order of events with equal keys.  The key of each
+//    event is computed once, so comparisons do not look at the events.
+//    Events are usually added at the end of a sorted list, so only the
+//    events after its longest sorted beginning are sorted, and then
+//    merged with it.
+//
+//    If only some of the events have sequence numbers (such as events
+//    added to a file that was read), the events with and without one
+//    are sorted separately.  Then each event without one is placed on
+//    its tick before the first event with one (in sequence order) that
+//    comes after it by the message type rules of getOrderKey().
+//
+
+void MidiEventList::sortByKey(bool noteOffsFirst) {
+	m_links.clear();
+	int count = (int)list.size();
+	std::vector<SortEntry> entries(count);
+	int sequenced = 0;
+	for (int i=0; i<count; i++) {
+		entries[i].key = getSortKey(*list[i], noteOffsFirst);
+		entries[i].order = entries[i].key;
+		entries[i].index = (uint32_t)i;
+		sequenced += list[i]->seq != 0;
+	}
+
+	auto byKey = [](const SortEntry& a, const SortEntry& b) {
+		return (a.key < b.key) || ((a.key == b.key) && (a.index < b.index));
+	};
+	// sortRange == sort a range of entries; returns false if it was
+	// already sorted.
+	auto sortRange = [&byKey](std::vector<SortEntry>::iterator begin,
+			std::vector<SortEntry>::iterator end) {
+		auto unsorted = std::is_sorted_until(begin, end, byKey);
+		if (unsorted == end) {
+			return false;
+		}
+		std::sort(unsorted, end, byKey);
+		std::inplace_merge(begin, unsorted, end, byKey);
+		return true;
+	};
+
+	if ((sequenced == 0) || (sequenced == count)) {
+		if (!sortRange(entries.begin(), entries.end())) {
+			return;
+		}
+	} else {
+		auto middle = std::stable_partition(entries.begin(), entries.end(),
+				[this](const SortEntry& entry) {
+					return list[entry.index]->seq != 0;
+				});
+		for (auto it=entries.begin(); it!=middle; it++) {
+			it->order = getOrderKey(*list[it->index], noteOffsFirst);
+		}
+		sortRange(entries.begin(), middle);
+		sortRange(middle, entries.end());
+		// The events with sequence numbers are in sequence order, which
+		// need not follow getOrderKey() within a tick, so this is not a
+		// std::merge: each event without one goes before the first event
+		// with one that it precedes by type, and after any ties.
+		std::vector<SortEntry> merged;
+		merged.reserve(count);
+		auto seqIt = entries.begin();
+		auto addedIt = middle;
+		while ((seqIt != middle) && (addedIt != entries.end())) {
+			if (seqIt->order <= addedIt->order) {
+				merged.push_back(*seqIt++);
+			} else {
+				merged.push_back(*addedIt++);
+			}
+		}
+		merged.insert(merged.end(), seqIt, middle);
+		merged.insert(merged.end(), addedIt, entries.end());
+		entries.swap(merged);
+	}
+
+	std::vector<MidiEvent*> events(count);
+	for (int i=0; i<count; i++) {
+		events[i] = list[entries[i].index];
+	}
+	list.swap(events);
+}
+
+
 
 //////////////////////////////
 //
-// MidiEventList::eventCompare -- Event comparison function for sorting tracks.
+// MidiEventList::getSortKey -- Key that gives the position of an event
+//    when sorting tracks: the tick in the upper 32 bits and the order
+//    within the tick in the lower 32 bits, which is the sequence number
+//    of the event if it has one (see markSequence()), and otherwise
+//    getOrderKey().  Keys of events with and without a sequence number
+//    are not compared with each other (see sortByKey()).
 //
 // Sorting rules:
 //    (1) sort by (absolute) tick value; otherwise, if tick values are the same:
-//    (2) end-of-track meta message is always last.
-//    (3) other meta-messages come before regular MIDI messages.
-//    (4) note-offs come after all other regular MIDI messages except note-ons.
-//    (5) note-ons come after all other regular MIDI messages.
+//    (2) if both events have a sequence number, keep the order of the
+//        numbers.
+//    Otherwise the events are sorted by message type (see getOrderKey()):
+//    (3) end-of-track meta message is always last.
+//    (4) other meta-messages come before regular MIDI messages.
+//    (5) notes come after all other regular MIDI messages, with note-ons
+//        before note-offs (or the reverse if noteOffsFirst is true), each
+//        sorted by key number.  Controllers are sorted by controller
+//        number and value (useful for sustain pedalling, for example).
 //
 // Note: If you load a MIDI file from a file, MidiMessage.seq numbers
 // will automatically be added, and sorting will follow the sequence
@@ -653,191 +941,104 @@ void MidiEventList::sortNoteOffsBeforeOns(void) {
 // occur at the same time).
 //
 
-int MidiEventList::eventCompareNoteOnsBeforeOffs(const void* a, const void* b) {
-	MidiEvent& aevent = **((MidiEvent**)a);
-	MidiEvent& bevent = **((MidiEvent**)b);
+uint64_t MidiEventList::getSortKey(const MidiEvent& event, bool noteOffsFirst) {
+	if (event.seq != 0) {
+		return ((uint64_t)((uint32_t)event.tick ^ 0x80000000u) << 32)
+				| (uint32_t)event.seq;
+	}
+	return getOrderKey(event, noteOffsFirst);
+}
 
-	if (aevent.tick < bevent.tick) {
-		// aevent occurs before bevent
-		return -1;
-	} else if (aevent.tick > bevent.tick) {
-		// aevent occurs after bevent
-		return +1;
-	} else if ((aevent.seq != 0) && (bevent.seq != 0) && (aevent.seq < bevent.seq)) {
-		// aevent sequencing state occurs before bevent
-		// see MidiEventList::markSequence()
-		return -1;
-	} else if ((aevent.seq != 0) && (bevent.seq != 0) && (aevent.seq > bevent.seq)) {
-		// aevent sequencing state occurs after bevent
-		// see MidiEventList::markSequence()
-		return +1;
-	} else if ((aevent.getP0() == 0xff) && (aevent.getP1() == 0x2f)) {
-		// end-of-track meta-message should always be last (but this won't really
-		// matter since the writing function ignores all end-of-track messages
-		// and writes its own.
-		return +1;
-	} else if ((bevent.getP0() == 0xff) && (bevent.getP1() == 0x2f)) {
-		// end-of-track meta-message should always be last (but won't really
-		// matter since the writing function ignores all end-of-track messages
-		// and writes its own.
-		return -1;
-	} else if (aevent.getP0() == 0xff && bevent.getP0() != 0xff) {
-		// other meta-messages are placed before real MIDI messages
-		return -1;
-	} else if ((aevent.getP0() != 0xff) && (bevent.getP0() == 0xff)) {
-		// other meta-messages are placed before real MIDI messages
-		return +1;
-	} else if ((aevent.getP0() == 0xff) && (bevent.getP0() == 0xff)) {
-		// could sort by meta-message number here
-		return 0;
-	} else if (aevent.isNote() && !bevent.isNote()) {
-		// notes come after all other message types
-		return +1;
-	} else if (!aevent.isNote() && bevent.isNote()) {
-		// notes come after all other message types
-		return -1;
-	} else if (aevent.isNoteOff() && bevent.isNoteOn()) {
-		// note-offs come after note-ons
-		return +1;
-	} else if (aevent.isNoteOn() && bevent.isNoteOff()) {
-		// note-ons come before all other types of MIDI messages
-		return -1;
-	} else if (aevent.isNoteOn() && bevent.isNoteOn()) {
-		// sorted further by key number
-		if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} else {
-			return 0;
-		}
-		return 0;
-	} else if (aevent.isNoteOff() && bevent.isNoteOff()) {
-		// sorted further by key number
-		if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} else {
-			return 0;
-		}
-		// could be sorted further by key number.
-		return 0;
-	} else if (((aevent.getP0() & 0xf0) == 0xb0) && ((bevent.getP0() & 0xf0) == 0xb0)) {
-		// both events are continuous controllers.  Sort them by controller number and value if equal
-		if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else {
-			// same controller number, so sort by data value
-			// useful for sustain pedalling, for example.
-			if (aevent.getP2() > bevent.getP2()) {
-				return +1;
-			} if (aevent.getP2() < bevent.getP2()) {
-				return -1;
-			} else {
-				return 0;
-			}
-		}
+
+
+//////////////////////////////
+//
+// MidiEventList::getOrderKey -- Key that sorts events by tick and then by
+//    message type, rules (3) to (5) of getSortKey(), ignoring sequence
+//    numbers.
+//
+
+uint64_t MidiEventList::getOrderKey(const MidiEvent& event, bool noteOffsFirst) {
+	uint64_t key = (uint64_t)((uint32_t)event.tick ^ 0x80000000u) << 32;
+	int p0 = event.getP0();
+	int p1 = event.getP1() & 0x7f;
+	uint32_t order;
+	if ((p0 == 0xff) && (event.getP1() == 0x2f)) {
+		order = 4 << 14;
+	} else if (p0 == 0xff) {
+		order = 0;
+	} else if (event.isNoteOn()) {
+		order = ((noteOffsFirst ? 3 : 2) << 14) | (p1 << 7);
+	} else if (event.isNoteOff()) {
+		order = ((noteOffsFirst ? 2 : 3) << 14) | (p1 << 7);
+	} else if ((p0 & 0xf0) == 0xb0) {
+		order = (1 << 14) | (p1 << 7) | (event.getP2() & 0x7f);
 	} else {
-		return 0;
+		order = 1 << 14;
 	}
+	return key | order;
 }
 
-int MidiEventList::eventCompareNoteOffsBeforeOns(const void* a, const void* b) {
-	MidiEvent& aevent = **((MidiEvent**)a);
-	MidiEvent& bevent = **((MidiEvent**)b);
 
-	if (aevent.tick < bevent.tick) {
-		// aevent occurs before bevent
-		return -1;
-	} else if (aevent.tick > bevent.tick) {
-		// aevent occurs after bevent
-		return +1;
-	} else if ((aevent.seq != 0) && (bevent.seq != 0) && (aevent.seq < bevent.seq)) {
-		// aevent sequencing state occurs before bevent
-		// see MidiEventList::markSequence()
-		return -1;
-	} else if ((aevent.seq != 0) && (bevent.seq != 0) && (aevent.seq > bevent.seq)) {
-		// aevent sequencing state occurs after bevent
-		// see MidiEventList::markSequence()
-		return +1;
-	} else if ((aevent.getP0() == 0xff) && (aevent.getP1() == 0x2f)) {
-		// end-of-track meta-message should always be last (but this won't really
-		// matter since the writing function ignores all end-of-track messages
-		// and writes its own.
-		return +1;
-	} else if ((bevent.getP0() == 0xff) && (bevent.getP1() == 0x2f)) {
-		// end-of-track meta-message should always be last (but won't really
-		// matter since the writing function ignores all end-of-track messages
-		// and writes its own.
-		return -1;
-	} else if (aevent.getP0() == 0xff && bevent.getP0() != 0xff) {
-		// other meta-messages are placed before real MIDI messages
-		return -1;
-	} else if ((aevent.getP0() != 0xff) && (bevent.getP0() == 0xff)) {
-		// other meta-messages are placed before real MIDI messages
-		return +1;
-	} else if ((aevent.getP0() == 0xff) && (bevent.getP0() == 0xff)) {
-		// could sort by meta-message number here
-		return 0;
-	} else if (aevent.isNote() && !bevent.isNote()) {
-		// notes come after all other message types
-		return +1;
-	} else if (!aevent.isNote() && bevent.isNote()) {
-		// notes come after all other message types
-		return -1;
-	} else if (aevent.isNoteOff() && bevent.isNoteOn()) {
-		// note-offs come before note-ons
-		return -1;
-	} else if (aevent.isNoteOn() && bevent.isNoteOff()) {
-		// note-ons come after all other types of MIDI messages
-		return +1;
-	} else if (aevent.isNoteOn() && bevent.isNoteOn()) {
-		// sorted further by key number
-		if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} else {
-			return 0;
+
+
+//////////////////////////////
+//
+// MidiEventList::mergeByKey -- Store the events of several lists in
+//    the order that sorting all of them together would give (see
+//    sortByKey()), if each list is already in that order: the lists
+//    are merged by taking the event with the smallest key next, with
+//    ties going to the earlier list.  This takes O(n log k) time for n
+//    events in k lists instead of sorting all n events.  Returns false
+//    without storing anything if one of the lists is not sorted, or if
+//    only some of the events have sequence numbers.
+//
+
+bool MidiEventList::mergeByKey(const std::vector<const MidiEventList*>& lists,
+		std::vector<MidiEvent*>& events) {
+	events.clear();
+	int count = (int)lists.size();
+	std::vector<std::vector<uint64_t>> keys(count);
+	size_t total = 0;
+	size_t sequenced = 0;
+	for (int i=0; i<count; i++) {
+		const MidiEventList& list = *lists[i];
+		keys[i].resize(list.size());
+		for (int j=0; j<list.size(); j++) {
+			keys[i][j] = getSortKey(list[j], false);
+			sequenced += list[j].seq != 0;
+			if ((j > 0) && (keys[i][j] < keys[i][j-1])) {
+				return false;
+			}
 		}
-		return 0;
-	} else if (aevent.isNoteOff() && bevent.isNoteOff()) {
-		// sorted further by key number
-		if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} else {
-			return 0;
+		total += list.size();
+	}
+	if ((sequenced != 0) && (sequenced != total)) {
+		return false;
+	}
+
+	std::priority_queue<std::pair<uint64_t, int>,
+	                    std::vector<std::pair<uint64_t, int>>,
+	                    std::greater<std::pair<uint64_t, int>>> order;
+	std::vector<int> positions(count, 0);
+	for (int i=0; i<count; i++) {
+		if (!keys[i].empty()) {
+			order.emplace(keys[i][0], i);
 		}
-		// could be sorted further by key number.
-		return 0;
-	} else if (((aevent.getP0() & 0xf0) == 0xb0) && ((bevent.getP0() & 0xf0) == 0xb0)) {
-		// both events are continuous controllers.  Sort them by controller number and value if equal
-		if (aevent.getP1() > bevent.getP1()) {
-			return +1;
-		} if (aevent.getP1() < bevent.getP1()) {
-			return -1;
-		} else {
-			// same controller number, so sort by data value
-			// useful for sustain pedalling, for example.
-			if (aevent.getP2() > bevent.getP2()) {
-				return +1;
-			} if (aevent.getP2() < bevent.getP2()) {
-				return -1;
-			} else {
-				return 0;
-			}
+	}
+	events.reserve(total);
+	while (!order.empty()) {
+		int i = order.top().second;
+		order.pop();
+		int& position = positions[i];
+		events.push_back(lists[i]->list[position++]);
+		if (position < (int)keys[i].size()) {
+			order.emplace(keys[i][position], i);
 		}
-	} else {
-		return 0;
 	}
+	return true;
 }
 
-
 } // end namespace smf
 
 
@@ -14,7 +14,10 @@
 #define _MIDIEVENTLIST_H_INCLUDED
 
 #include "MidiEvent.h"
+#include "MidiEventArena.h"
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 
@@ -49,16 +52,29 @@ class MidiEventList {
 		int              linkNotePairs      (void) { return linkNotePairsFIFO(); }
 		int              linkEventPairs     (void);
 		void             clearLinks         (void);
+		bool             hasLinkIndexes     (void) const;
+		int              getLinkedIndex     (int index) const;
+		MidiEvent*       getLinkedEvent     (int index);
+		const MidiEvent* getLinkedEvent     (int index) const;
+		int              getTickDuration    (int index) const;
+		double           getDurationInSeconds(int index) const;
 		void             clearSequence      (void);
 		int              markSequence       (int sequence = 1);
 
 		int              push               (MidiEvent& event);
 		int              push_back          (MidiEvent& event);
+		int              push_back          (MidiEvent&& event);
 		int              append             (MidiEvent& event);
+		int              append             (MidiEvent&& event);
+		MidiEvent&       emplace_back       (void);
+		template <class... Bytes>
+		MidiEvent&       emplace_back       (int tick, int track, Bytes... bytes);
+		void             pop_back           (void);
 
 		// careful when using these, intended for internal use in MidiFile class:
 		void             detach             (void);
 		int              push_back_no_copy  (MidiEvent* event);
+		void             adoptStorage       (MidiEventList& other);
 
 		// access to the list of MidiEvents for sorting with an external function:
 		MidiEvent**      data               (void);
@@ -66,20 +82,71 @@ class MidiEventList {
 	protected:
 		std::vector<MidiEvent*> list;
 
+		// m_arena == storage for events appended to this list, created on
+		// first use.  Only this list allocates from it, but events moved
+		// to other lists are released into it (see MidiEventArena.h for
+		// when lists may be filled in parallel).
+		std::shared_ptr<MidiEventArena> m_arena;
+
+		// m_sharedArenas == arenas of other lists that hold events which
+		// were moved into this list with push_back_no_copy().
+		std::vector<std::shared_ptr<MidiEventArena>> m_sharedArenas;
+
+		// m_links == for each event, the index of the event it is linked
+		// to by linkNotePairs(), or -1.  Empty if the list has not been
+		// linked or has changed since.
+		std::vector<int> m_links;
+
 	private:
+		MidiEventArena&  getArena               (void);
+		bool             isLinkIndexCurrent     (int index) const;
+		void             linkIndexes            (int first, int second);
+		int              linkPairs              (bool lifo, bool allTracks);
 		void             sort                   (void) { return sortNoteOnsBeforeOffs(); }
 		void             sortNoteOnsBeforeOffs  (void);
 		void             sortNoteOffsBeforeOns  (void);
+		void             sortByKey              (bool noteOffsFirst);
+
+		// SortEntry == sort keys of the event at index in the list (see
+		// getSortKey() and getOrderKey()).
+		struct SortEntry {
+			uint64_t key;
+			uint64_t order;
+			uint32_t index;
+		};
 
 	// MidiFile class calls sort()
 	friend class MidiFile;
 
-	static int eventCompareNoteOffsBeforeOns(const void* a, const void* b);
-	static int eventCompareNoteOnsBeforeOffs(const void* a, const void* b);
-	static int eventCompare(const void* a, const void* b) { return eventCompareNoteOnsBeforeOffs(a, b); }
+	static uint64_t getSortKey(const MidiEvent& event, bool noteOffsFirst);
+	static uint64_t getOrderKey(const MidiEvent& event, bool noteOffsFirst);
+	static bool     mergeByKey(const std::vector<const MidiEventList*>& lists,
+	                           std::vector<MidiEvent*>& events);
 };
 
 
+
+//////////////////////////////
+//
+// MidiEventList::emplace_back -- Construct an event at the end of the list
+//    from its tick, track and message bytes, for example
+//    emplace_back(tick, track, 0x90, key, velocity).  Returns the new
+//    event.
+//
+
+template <class... Bytes>
+MidiEvent& MidiEventList::emplace_back(int tick, int track, Bytes... bytes) {
+	MidiEvent& event = emplace_back();
+	event.tick = tick;
+	event.track = track;
+	if constexpr (sizeof...(bytes) > 0) {
+		const uchar message[] = {(uchar)bytes...};
+		event.setMessage(message, (int)sizeof...(bytes));
+	}
+	return event;
+}
+
+
 } // end of namespace smf
 
 #endif /* _MIDIEVENTLIST_H_INCLUDED */
@@ -0,0 +1,409 @@
+//
+// Creation Date: Sun Oct 18 14:20:52 PDT 2026
+// Filename:      midifile/src/MidiEventTable.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Column-oriented copy of the events in a MidiFile.
+//
+
+#include "MidiEventTable.h"
+#include "MidiFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// MidiEventTable::MidiEventTable -- Constructor.
+//
+
+MidiEventTable::MidiEventTable(void) {
+	clear();
+}
+
+
+MidiEventTable::MidiEventTable(const MidiFile& midifile) {
+	build(midifile);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::build -- Copy all events of a MidiFile, track by track
+//    in their current order.  Ticks and seconds are copied as they are,
+//    so call doTimeAnalysis() and linkNotePairs() on the MidiFile first
+//    if seconds and links are needed.  Links to events that are not in
+//    the file are dropped.
+//
+
+void MidiEventTable::build(const MidiFile& midifile) {
+	clear();
+	int tracks = midifile.getTrackCount();
+	size_t count = 0;
+	for (int i=0; i<tracks; i++) {
+		count += midifile[i].size();
+	}
+	m_tick.reserve(count);
+	m_seconds.reserve(count);
+	m_status.reserve(count);
+	m_data1.reserve(count);
+	m_data2.reserve(count);
+	m_track.reserve(count);
+	m_payload.reserve(count);
+	m_trackStart.clear();
+	m_trackStart.reserve(tracks + 1);
+
+	for (int i=0; i<tracks; i++) {
+		const MidiEventList& list = midifile[i];
+		m_trackStart.push_back((int)m_tick.size());
+		for (int j=0; j<list.size(); j++) {
+			const MidiEvent& event = list[j];
+			int size = (int)event.size();
+			const uchar* bytes = event.data();
+			m_tick.push_back(event.tick);
+			m_seconds.push_back(event.seconds);
+			m_track.push_back(event.track);
+			m_status.push_back(size > 0 ? bytes[0] : 0);
+			m_data1.push_back(size > 1 ? bytes[1] : 0);
+			if ((size > 0) && (size == MidiMessage::getChannelMessageSize(bytes[0]))) {
+				m_data2.push_back(size > 2 ? bytes[2] : 0);
+				m_payload.push_back(-1);
+			} else if (size == 0) {
+				m_data2.push_back(0);
+				m_payload.push_back(-1);
+			} else {
+				m_data2.push_back(0);
+				m_payload.push_back((int)m_payloadStart.size() - 1);
+				m_payloadBytes.insert(m_payloadBytes.end(), bytes, bytes + size);
+				m_payloadStart.push_back(m_payloadBytes.size());
+			}
+		}
+	}
+	m_trackStart.push_back((int)m_tick.size());
+
+	linkRows(midifile);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::clear -- Remove all events.
+//
+
+void MidiEventTable::clear(void) {
+	m_tick.clear();
+	m_seconds.clear();
+	m_status.clear();
+	m_data1.clear();
+	m_data2.clear();
+	m_track.clear();
+	m_link.clear();
+	m_payload.clear();
+	m_payloadBytes.clear();
+	m_payloadStart.assign(1, 0);
+	m_trackStart.assign(1, 0);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::size -- Number of events in the table.
+//
+
+int MidiEventTable::size(void) const {
+	return (int)m_tick.size();
+}
+
+
+bool MidiEventTable::empty(void) const {
+	return m_tick.empty();
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getTrackCount -- Number of tracks in the source file.
+//
+
+int MidiEventTable::getTrackCount(void) const {
+	return (int)m_trackStart.size() - 1;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getTrackStart -- Index of the first event of a track
+//    of the source file.  getTrackEnd() returns the index after its last
+//    event.
+//
+
+int MidiEventTable::getTrackStart(int track) const {
+	return m_trackStart.at(track);
+}
+
+
+int MidiEventTable::getTrackEnd(int track) const {
+	return m_trackStart.at(track + 1);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::get* -- Event columns.  For meta messages data1 is the
+//    meta type; for any message other than a channel message data2 is 0
+//    and the complete bytes are available from getMessage().
+//
+
+std::span<const int> MidiEventTable::getTicks(void) const {
+	return m_tick;
+}
+
+
+std::span<const double> MidiEventTable::getSeconds(void) const {
+	return m_seconds;
+}
+
+
+std::span<const uchar> MidiEventTable::getStatus(void) const {
+	return m_status;
+}
+
+
+std::span<const uchar> MidiEventTable::getData1(void) const {
+	return m_data1;
+}
+
+
+std::span<const uchar> MidiEventTable::getData2(void) const {
+	return m_data2;
+}
+
+
+std::span<const int> MidiEventTable::getTracks(void) const {
+	return m_track;
+}
+
+
+std::span<const int> MidiEventTable::getLinks(void) const {
+	return m_link;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getMessage -- Return the bytes of an event.
+//
+
+MidiMessage MidiEventTable::getMessage(int index) const {
+	MidiMessage message;
+	int payload = m_payload[index];
+	if (payload >= 0) {
+		message.assign(m_payloadBytes.data() + m_payloadStart[payload],
+				m_payloadBytes.data() + m_payloadStart[payload + 1]);
+	} else {
+		uchar bytes[3] = {m_status[index], m_data1[index], m_data2[index]};
+		int size = m_status[index] ? MidiMessage::getChannelMessageSize(m_status[index]) : 0;
+		message.assign(bytes, bytes + size);
+	}
+	return message;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getMessageSize -- Number of bytes in an event.
+//
+
+int MidiEventTable::getMessageSize(int index) const {
+	int payload = m_payload[index];
+	if (payload >= 0) {
+		return (int)(m_payloadStart[payload + 1] - m_payloadStart[payload]);
+	}
+	return m_status[index] ? MidiMessage::getChannelMessageSize(m_status[index]) : 0;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::isNoteOn -- Same as MidiMessage::isNoteOn() for the
+//    given event.
+//
+
+bool MidiEventTable::isNoteOn(int index) const {
+	return ((m_status[index] & 0xf0) == 0x90) && (m_data2[index] != 0)
+			&& (m_payload[index] < 0);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::isNoteOff -- Same as MidiMessage::isNoteOff() for the
+//    given event.
+//
+
+bool MidiEventTable::isNoteOff(int index) const {
+	int command = m_status[index] & 0xf0;
+	return (m_payload[index] < 0) && ((command == 0x80)
+			|| ((command == 0x90) && (m_data2[index] == 0)));
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getLinkedIndex -- Index of the event linked to the
+//    given one (note-on to note-off and vice-versa), or -1.
+//
+
+int MidiEventTable::getLinkedIndex(int index) const {
+	return m_link[index];
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getTickDuration -- Same as MidiEvent::getTickDuration()
+//    for the given event.
+//
+
+int MidiEventTable::getTickDuration(int index) const {
+	int link = m_link[index];
+	if (link < 0) {
+		return 0;
+	}
+	return std::abs(m_tick[link] - m_tick[index]);
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getDurationInSeconds -- Same as
+//    MidiEvent::getDurationInSeconds() for the given event.
+//
+
+double MidiEventTable::getDurationInSeconds(int index) const {
+	int link = m_link[index];
+	if (link < 0) {
+		return 0.0;
+	}
+	double duration = m_seconds[link] - m_seconds[index];
+	return duration < 0.0 ? -duration : duration;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getNoteOnIndexes -- Store the indexes of all note-on
+//    events, in table order.  Returns the number of note-ons.
+//
+
+int MidiEventTable::getNoteOnIndexes(std::vector<int>& indexes) const {
+	indexes.resize(m_status.size());
+	const uchar* status = m_status.data();
+	const uchar* data2 = m_data2.data();
+	const int* payload = m_payload.data();
+	int count = 0;
+	// Branch-free compaction: every index is written, and the output
+	// position only advances for note-ons.
+	for (int i=0; i<(int)m_status.size(); i++) {
+		indexes[count] = i;
+		count += ((status[i] & 0xf0) == 0x90) & (data2[i] != 0) & (payload[i] < 0);
+	}
+	indexes.resize(count);
+	return count;
+}
+
+
+
+//////////////////////////////
+//
+// MidiEventTable::getDurationsInSeconds -- Store the duration of every
+//    event, as getDurationInSeconds() would return it.
+//
+
+void MidiEventTable::getDurationsInSeconds(std::vector<double>& durations) const {
+	durations.resize(m_seconds.size());
+	const double* seconds = m_seconds.data();
+	const int* link = m_link.data();
+	for (int i=0; i<(int)m_seconds.size(); i++) {
+		double duration = link[i] < 0 ? 0.0 : seconds[link[i]] - seconds[i];
+		durations[i] = duration < 0.0 ? -duration : duration;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MidiEventTable::linkRows -- Convert the event links of the MidiFile
+//    into table indexes.  Tracks with link indexes are copied directly.
+//    For the others, the linked events are sorted by address so that
+//    each partner can be found with a binary search.
+//
+
+void MidiEventTable::linkRows(const MidiFile& midifile) {
+	m_link.assign(m_tick.size(), -1);
+	std::vector<std::pair<const MidiEvent*, int>> linked;
+	int index = 0;
+	for (int i=0; i<midifile.getTrackCount(); i++) {
+		const MidiEventList& list = midifile[i];
+		if (list.hasLinkIndexes()) {
+			// Links within the track are already known by index.
+			for (int j=0; j<list.size(); j++, index++) {
+				int link = list.getLinkedIndex(j);
+				m_link[index] = link < 0 ? -1 : m_trackStart[i] + link;
+			}
+			continue;
+		}
+		for (int j=0; j<list.size(); j++, index++) {
+			if (list[j].isLinked()) {
+				linked.emplace_back(&list[j], index);
+			}
+		}
+	}
+	if (linked.empty()) {
+		return;
+	}
+	auto byAddress = [](const std::pair<const MidiEvent*, int>& a,
+			const std::pair<const MidiEvent*, int>& b) {
+		return std::less<const MidiEvent*>()(a.first, b.first);
+	};
+	std::sort(linked.begin(), linked.end(), byAddress);
+	for (const auto& entry : linked) {
+		const MidiEvent* partner = entry.first->getLinkedEvent();
+		auto found = std::lower_bound(linked.begin(), linked.end(),
+				std::make_pair(partner, 0), byAddress);
+		if ((found != linked.end()) && (found->first == partner)) {
+			m_link[entry.second] = found->second;
+		}
+	}
+}
+
+
+} // end namespace smf
+
+
+
@@ -0,0 +1,98 @@
+//
+// Creation Date: Sun Oct 18 14:20:52 PDT 2026
+// Filename:      midifile/include/MidiEventTable.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Column-oriented copy of the events in a MidiFile.
+//                Each event field is stored in its own contiguous array
+//                so that analysis passes (finding note-ons, computing
+//                durations, histograms over keys) are linear scans over
+//                a few small arrays instead of pointer chases through
+//                MidiEvent objects.  Channel messages are kept entirely
+//                in the status/data1/data2 columns; meta, sysex and
+//                other messages keep their complete bytes in a side
+//                table.
+//
+
+#ifndef _MIDIEVENTTABLE_H_INCLUDED
+#define _MIDIEVENTTABLE_H_INCLUDED
+
+#include "MidiMessage.h"
+
+#include <span>
+#include <vector>
+
+
+namespace smf {
+
+class MidiFile;
+
+class MidiEventTable {
+	public:
+		                       MidiEventTable     (void);
+		                       MidiEventTable     (const MidiFile& midifile);
+
+		void                   build              (const MidiFile& midifile);
+		void                   clear              (void);
+
+		int                    size               (void) const;
+		bool                   empty              (void) const;
+		int                    getTrackCount      (void) const;
+		int                    getTrackStart      (int track) const;
+		int                    getTrackEnd        (int track) const;
+
+		// columns, one entry per event:
+		std::span<const int>    getTicks          (void) const;
+		std::span<const double> getSeconds        (void) const;
+		std::span<const uchar>  getStatus         (void) const;
+		std::span<const uchar>  getData1          (void) const;
+		std::span<const uchar>  getData2          (void) const;
+		std::span<const int>    getTracks         (void) const;
+		std::span<const int>    getLinks          (void) const;
+
+		// per-event access:
+		MidiMessage            getMessage         (int index) const;
+		int                    getMessageSize     (int index) const;
+		bool                   isNoteOn           (int index) const;
+		bool                   isNoteOff          (int index) const;
+		int                    getLinkedIndex     (int index) const;
+		int                    getTickDuration    (int index) const;
+		double                 getDurationInSeconds(int index) const;
+
+		// whole-table analysis:
+		int                    getNoteOnIndexes   (std::vector<int>& indexes) const;
+		void                   getDurationsInSeconds(std::vector<double>& durations) const;
+
+	private:
+		void                   linkRows           (const MidiFile& midifile);
+
+		// event columns:
+		std::vector<int>       m_tick;     // absolute or delta ticks
+		std::vector<double>    m_seconds;  // seconds (after doTimeAnalysis())
+		std::vector<uchar>     m_status;   // first byte, 0 for empty events
+		std::vector<uchar>     m_data1;    // second byte, or meta type
+		std::vector<uchar>     m_data2;    // third byte of channel messages
+		std::vector<int>       m_track;    // MidiEvent::track
+		std::vector<int>       m_link;     // index of linked event, or -1
+
+		// m_payload == index into m_payloadStart for events whose bytes are
+		// not fully described by the status/data columns, or -1.
+		std::vector<int>       m_payload;
+
+		// m_payloadBytes == complete bytes of the payload events.  Payload
+		// i occupies [m_payloadStart[i], m_payloadStart[i+1]).
+		std::vector<uchar>     m_payloadBytes;
+		std::vector<size_t>    m_payloadStart;
+
+		// m_trackStart == first index of each track of the source file,
+		// followed by the total number of events.
+		std::vector<int>       m_trackStart;
+};
+
+} // end of namespace smf
+
+#endif /* _MIDIEVENTTABLE_H_INCLUDED */
+
+
+
@@ -13,33 +13,33 @@
 //
 
 #include "MidiFile.h"
+#include "Base64.h"
 #include "Binasc.h"
+#include "MappedFile.h"
+#include "MidiTrackDecoder.h"
+#include "WorkerPool.h"
 
 #include <algorithm>
+#include <climits>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <numeric>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
 
-namespace smf {
-
-
-const std::string MidiFile::encodeLookup = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
 
-const std::vector<int> MidiFile::decodeLookup {
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
-		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
-		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
-};
+namespace smf {
 
 
 const char* MidiFile::GMinstrument[128] = {
@@ -142,6 +142,7 @@ MidiFile& MidiFile::operator=(const MidiFile& other) {
 	if (this == &other) {
 		return *this;
 	}
+	other.loadAllTracks();
 	m_events.reserve(other.m_events.size());
 	auto it = other.m_events.begin();
 	std::generate_n(std::back_inserter(m_events), other.m_events.size(),
@@ -154,10 +155,22 @@ MidiFile& MidiFile::operator=(const MidiFile& other) {
 	m_theTimeState        = other.m_theTimeState;
 	m_readFileName        = other.m_readFileName;
 	m_timemapvalid        = other.m_timemapvalid;
+	m_timemapdirty        = other.m_timemapdirty;
+	m_timemapDirtyTick    = other.m_timemapDirtyTick;
 	m_timemap             = other.m_timemap;
+	m_timemapTracks.clear();
 	m_rwstatus            = other.m_rwstatus;
+	m_threadCount         = other.m_threadCount;
+	m_lazyLoading         = other.m_lazyLoading;
 	if (other.m_linkedEventsQ) {
-		linkEventPairs();
+		// Tracks that still have their link indexes were linked when
+		// they were copied.
+		for (auto* track : m_events) {
+			if (!track->hasLinkIndexes()) {
+				track->linkEventPairs();
+			}
+		}
+		m_linkedEventsQ = true;
 	}
 	return *this;
 }
@@ -174,8 +187,17 @@ MidiFile& MidiFile::operator=(MidiFile&& other) {
 	m_theTimeState        = other.m_theTimeState;
 	m_readFileName        = other.m_readFileName;
 	m_timemapvalid        = other.m_timemapvalid;
+	m_timemapdirty        = other.m_timemapdirty;
+	m_timemapDirtyTick    = other.m_timemapDirtyTick;
 	m_timemap             = other.m_timemap;
+	m_timemapTracks.clear();
 	m_rwstatus            = other.m_rwstatus;
+	m_threadCount         = other.m_threadCount;
+	m_lazyLoading         = other.m_lazyLoading;
+	m_lazyData            = std::move(other.m_lazyData);
+	m_lazyOffsets         = std::move(other.m_lazyOffsets);
+	m_lazyCount           = other.m_lazyCount;
+	other.clearLazyTracks();
 	return *this;
 }
 
@@ -197,15 +219,18 @@ bool MidiFile::read(const std::string& filename) {
 	setFilename(filename);
 	m_rwstatus = true;
 
-	std::fstream input;
-	input.open(filename.c_str(), std::ios::binary | std::ios::in);
-
-	if (!input.is_open()) {
+	auto input = std::make_shared<MappedFile>();
+	if (!input->open(filename)) {
 		m_rwstatus = false;
 		return m_rwstatus;
 	}
 
-	m_rwstatus = read(input);
+	std::span<const uchar> data = input->span();
+	if (!data.empty() && (data[0] == 'M')) {
+		m_rwstatus = readSmf(data, input);
+	} else {
+		m_rwstatus = read(data);
+	}
 	return m_rwstatus;
 }
 
@@ -218,26 +243,33 @@ bool MidiFile::read(std::istream& input) {
 	if (input.peek() != 'M') {
 		// If the first byte in the input stream is not 'M', then presume that
 		// the MIDI file is in the binasc format which is an ASCII representation
-		// of the MIDI file.  Convert the binasc content into binary content and
-		// then continue reading with this function.
-		std::stringstream binarydata;
-		Binasc binasc;
-		binasc.writeToBinary(binarydata, input);
-		binarydata.seekg(0, std::ios_base::beg);
-		if (binarydata.peek() != 'M') {
-			std::cerr << "Bad MIDI data input" << std::endl;
-			m_rwstatus = false;
-			return m_rwstatus;
-		} else {
-			m_rwstatus = readSmf(binarydata);
-			return m_rwstatus;
-		}
+		// of the MIDI file.
+		std::string text((std::istreambuf_iterator<char>(input)),
+				std::istreambuf_iterator<char>());
+		m_rwstatus = readBinasc(text);
+		return m_rwstatus;
 	} else {
 		m_rwstatus = readSmf(input);
 		return m_rwstatus;
 	}
 }
 
+//
+// In-memory version of read().  Standard MIDI data is decoded in place,
+// and binasc content is compiled into a buffer that is decoded in place.
+//
+
+bool MidiFile::read(std::span<const uchar> data) {
+	m_rwstatus = true;
+	if (data.empty() || (data[0] != 'M')) {
+		m_rwstatus = readBinasc(std::string_view((const char*)data.data(),
+				data.size()));
+		return m_rwstatus;
+	}
+	m_rwstatus = readSmf(data);
+	return m_rwstatus;
+}
+
 
 
 //////////////////////////////
@@ -247,17 +279,15 @@ bool MidiFile::read(std::istream& input) {
 //
 
 bool MidiFile::readBase64(const std::string& base64data) {
-	std::stringstream stream;
-	stream << MidiFile::base64Decode(base64data);
-	return MidiFile::read(stream);
+	std::vector<uchar> data;
+	Base64::decode(base64data, data);
+	return MidiFile::read(std::span<const uchar>(data));
 }
 
 bool MidiFile::readBase64(std::istream& instream) {
 	std::string base64data((std::istreambuf_iterator<char>(instream)),
 			std::istreambuf_iterator<char>());
-	std::stringstream stream;
-	stream << MidiFile::base64Decode(base64data);
-	return MidiFile::read(stream);
+	return MidiFile::readBase64(base64data);
 }
 
 
@@ -273,15 +303,13 @@ bool MidiFile::readSmf(const std::string& filename) {
 	setFilename(filename);
 	m_rwstatus = true;
 
-	std::fstream input;
-	input.open(filename.c_str(), std::ios::binary | std::ios::in);
-
-	if (!input.is_open()) {
+	auto input = std::make_shared<MappedFile>();
+	if (!input->open(filename)) {
 		m_rwstatus = false;
 		return m_rwstatus;
 	}
 
-	m_rwstatus = readSmf(input);
+	m_rwstatus = readSmf(input->span(), input);
 	return m_rwstatus;
 }
 
@@ -432,7 +460,6 @@ bool MidiFile::readSmf(std::istream& input) {
 	//
 
 	uchar runningCommand;
-	MidiEvent event;
 	std::vector<uchar> bytes;
 	int xstatus;
 
@@ -519,19 +546,12 @@ bool MidiFile::readSmf(std::istream& input) {
 			if (xstatus == 0) {
 				m_rwstatus = false; return m_rwstatus;
 			}
-			event.setMessage(bytes);
-			event.tick = absticks;
-			event.track = i;
-
+			// end-of-track messages are kept (they are always required, and
+			// will be added automatically when a MIDI file is written).
+			m_events[i]->emplace_back(absticks, i).setMessage(bytes);
 			if (bytes[0] == 0xff && bytes[1] == 0x2f) {
-				// end-of-track message
-				// comment out the following line if you don't want to see the
-				// end of track message (which is always required, and will added
-				// automatically when a MIDI is written, so it is not necessary.
-				m_events[i]->push_back(event);
 				break;
 			}
-			m_events[i]->push_back(event);
 		}
 	}
 
@@ -546,6 +566,411 @@ bool MidiFile::readSmf(std::istream& input) {
 }
 
 
+//
+// In-memory version of readSmf().  The data is decoded directly from the
+// given bytes (such as a memory-mapped file) rather than through an
+// istream, and produces the same events as the stream version.  Data
+// that is cut short fails at the same point, leaving the same partial
+// contents.
+//
+
+bool MidiFile::readSmf(std::span<const uchar> data) {
+	std::shared_ptr<MappedFile> storage;
+	if (m_lazyLoading) {
+		// Undecoded tracks must outlive the caller's buffer.
+		storage = std::make_shared<MappedFile>();
+		storage->assign(data);
+		data = storage->span();
+	}
+	return readSmf(data, storage);
+}
+
+//
+// Private version of readSmf() for in-memory data.  If lazy loading is
+// enabled, the storage holding the data is kept until all tracks have
+// been decoded; otherwise it is not needed after the function returns.
+//
+
+bool MidiFile::readSmf(std::span<const uchar> data,
+		std::shared_ptr<MappedFile> storage) {
+	m_rwstatus = true;
+
+	std::string filename = getFilename();
+
+	ulong  longdata;
+	ushort shortdata;
+
+	// Read the MIDI header (4 bytes of ID, 4 byte data size,
+	// anticipated 6 bytes of data.
+
+	if (!checkChunkId(data, 0, "MThd", filename, "")) {
+		m_rwstatus = false; return m_rwstatus;
+	}
+
+	// Header values cut off by the end of the data are read as 0, and
+	// the stream version carries on with them, so do the same here to
+	// fail at the same point (or not at all) with the same contents.
+	auto readHeaderValue = [&data](size_t offset, int count) {
+		if (data.size() < offset + count) {
+			std::cerr << "Error: unexpected end of file." << std::endl;
+			return (ulong)0;
+		}
+		ulong value = 0;
+		for (int i=0; i<count; i++) {
+			value = (value << 8) | data[offset + i];
+		}
+		return value;
+	};
+
+	// read header size (allow larger header size?)
+	longdata = readHeaderValue(4, 4);
+	if (longdata != 6) {
+		std::cerr << "File " << filename
+		     << " is not a MIDI 1.0 Standard MIDI file." << std::endl;
+		std::cerr << "The header size is " << longdata << " bytes." << std::endl;
+		m_rwstatus = false; return m_rwstatus;
+	}
+
+	// Header parameter #1: format type
+	int type;
+	shortdata = (ushort)readHeaderValue(8, 2);
+	switch (shortdata) {
+		case 0:
+			type = 0;
+			break;
+		case 1:
+			type = 1;
+			break;
+		case 2:
+		default:
+			std::cerr << "Error: cannot handle a type-" << shortdata
+			     << " MIDI file" << std::endl;
+			m_rwstatus = false; return m_rwstatus;
+	}
+
+	// Header parameter #2: track count
+	int tracks;
+	shortdata = (ushort)readHeaderValue(10, 2);
+	if (type == 0 && shortdata != 1) {
+		std::cerr << "Error: Type 0 MIDI file can only contain one track" << std::endl;
+		std::cerr << "Instead track count is: " << shortdata << std::endl;
+		m_rwstatus = false; return m_rwstatus;
+	} else {
+		tracks = shortdata;
+	}
+	clear();
+	if (m_events[0] != NULL) {
+		delete m_events[0];
+	}
+	bool lazy = m_lazyLoading && storage;
+	m_events.resize(tracks);
+	for (int z=0; z<tracks; z++) {
+		m_events[z] = new MidiEventList;
+		if (!lazy) {
+			m_events[z]->reserve(10000);   // Initialize with 10,000 event storage.
+		}
+		m_events[z]->clear();
+	}
+
+	// Header parameter #3: Ticks per quarter note
+	shortdata = (ushort)readHeaderValue(12, 2);
+	if (shortdata >= 0x8000) {
+		int framespersecond = 255 - ((shortdata >> 8) & 0x00ff) + 1;
+		int subframes       = shortdata & 0x00ff;
+		switch (framespersecond) {
+			case 25:  framespersecond = 25; break;
+			case 24:  framespersecond = 24; break;
+			case 29:  framespersecond = 29; break;  // really 29.97 for color television
+			case 30:  framespersecond = 30; break;
+			default:
+					std::cerr << "Warning: unknown FPS: " << framespersecond << std::endl;
+					std::cerr << "Using non-standard FPS: " << framespersecond << std::endl;
+		}
+		m_ticksPerQuarterNote = framespersecond * subframes;
+	}  else {
+		m_ticksPerQuarterNote = shortdata;
+	}
+
+	//////////////////////////////////////////////////
+	//
+	// now read individual tracks:
+	//
+
+	size_t offset = std::min(data.size(), (size_t)14);
+	if (lazy) {
+		m_lazyData = storage;
+		m_rwstatus = indexTracks(data, tracks, offset);
+		m_theTimeState = TIME_STATE_ABSOLUTE;
+		return m_rwstatus;
+	}
+
+	int first = 0;
+	if ((m_threadCount != 1) && (tracks > 1)) {
+		first = readTracksInParallel(data, tracks, offset);
+	}
+
+	for (int i=first; i<tracks; i++) {
+		if (!checkChunkId(data, offset, "MTrk", filename, " in track")) {
+			m_rwstatus = false; return m_rwstatus;
+		}
+		if (data.size() - offset < 8) {
+			// The stream version leaves a track with a truncated chunk size
+			// empty rather than failing, so do the same here.
+			std::cerr << "Error: unexpected end of file." << std::endl;
+			m_events[i]->clear();
+			offset = data.size();
+			continue;
+		}
+
+		// The chunk size is only used as an allocation hint, as in the
+		// stream version: the track ends at its end-of-track message.
+		// Every event needs at least two bytes, so a corrupt size cannot
+		// request more than the remaining data could hold.
+		longdata = ((ulong)data[offset+4] << 24) | (data[offset+5] << 16)
+				| (data[offset+6] << 8) | data[offset+7];
+		longdata = std::min(longdata, (ulong)(data.size() - offset));
+		m_events[i]->reserve((int)longdata/2);
+		m_events[i]->clear();
+		offset += 8;
+
+		MidiTrackDecoder decoder(data.subspan(offset), i);
+		if (!decoder.decode(*m_events[i])) {
+			m_rwstatus = false;
+			if (!decoder.isTruncated()) {
+				return m_rwstatus;
+			}
+			// The stream version goes on with the next track, which
+			// then fails at the end of the data, or with markSequence()
+			// if this was the last one.
+		}
+		offset += decoder.getOffset();
+	}
+
+	m_theTimeState = TIME_STATE_ABSOLUTE;
+	markSequence();
+
+	return m_rwstatus;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::readBinasc -- Compile binasc text (an ASCII representation
+//    of a Standard MIDI File) into binary data and parse it.
+//
+
+bool MidiFile::readBinasc(std::string_view text) {
+	std::vector<uchar> binarydata;
+	Binasc binasc;
+	if (!binasc.writeToBinary(binarydata, text)) {
+		return false;
+	}
+	if (binarydata.empty() || (binarydata[0] != 'M')) {
+		std::cerr << "Bad MIDI data input" << std::endl;
+		return false;
+	}
+	return readSmf(std::span<const uchar>(binarydata));
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::readTracksInParallel -- Decode the MTrk chunks of in-memory
+//    MIDI data on several threads (see setThreadCount()).  The chunk
+//    boundaries are first located from the declared chunk sizes; each
+//    track is then decoded independently since running status does not
+//    carry over between tracks.  Declared sizes are not always correct in
+//    files found in the wild, so a track is only kept if its end-of-track
+//    message falls exactly at the declared end of its chunk.  Returns the
+//    number of leading tracks that were decoded, with offset set to the
+//    start of the first track that still has to be read sequentially.
+//
+
+int MidiFile::readTracksInParallel(std::span<const uchar> data, int tracks,
+		size_t& offset) {
+	std::vector<size_t> starts;
+	std::vector<size_t> sizes;
+	starts.reserve(tracks);
+	sizes.reserve(tracks);
+	size_t position = offset;
+	for (int i=0; i<tracks; i++) {
+		if ((data.size() - position < 8) || (data[position] != 'M') ||
+				(data[position+1] != 'T') || (data[position+2] != 'r') ||
+				(data[position+3] != 'k')) {
+			break;
+		}
+		size_t size = ((size_t)data[position+4] << 24) | (data[position+5] << 16)
+				| (data[position+6] << 8) | data[position+7];
+		if (size > data.size() - position - 8) {
+			break;
+		}
+		starts.push_back(position + 8);
+		sizes.push_back(size);
+		position += 8 + size;
+	}
+	int count = (int)starts.size();
+	if (count < 2) {
+		return 0;
+	}
+
+	std::vector<char> valid(count, 0);
+	WorkerPool::run(count, m_threadCount, [&](int i) {
+		std::ostringstream errors;
+		MidiTrackDecoder decoder(data.subspan(starts[i], sizes[i]), i);
+		decoder.setErrorStream(errors);
+		m_events[i]->reserve((int)sizes[i]/2);
+		valid[i] = decoder.decode(*m_events[i]) && decoder.isEndOfTrack()
+				&& (decoder.getOffset() == sizes[i]);
+	});
+
+	// Keep the leading run of tracks whose chunk sizes were trustworthy;
+	// the remainder is re-read sequentially by the caller, which also
+	// reports any errors.
+	int decoded = 0;
+	while ((decoded < count) && valid[decoded]) {
+		decoded++;
+	}
+	for (int i=decoded; i<count; i++) {
+		m_events[i]->clear();
+	}
+	if (decoded > 0) {
+		offset = starts[decoded-1] + sizes[decoded-1];
+	}
+	return decoded;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::indexTracks -- Record where the event data of each MTrk chunk
+//    starts without decoding it (see setLazyLoading()).  As when decoding,
+//    the declared chunk sizes are not trusted: a size is only used when
+//    another MTrk chunk begins where it says the track ends, otherwise
+//    the track is scanned for its end-of-track message.
+//
+
+bool MidiFile::indexTracks(std::span<const uchar> data, int tracks,
+		size_t offset) {
+	std::string filename = getFilename();
+	m_lazyOffsets.assign(tracks, 0);
+	m_lazyCount = 0;
+	for (int i=0; i<tracks; i++) {
+		if (!checkChunkId(data, offset, "MTrk", filename, " in track")) {
+			clearLazyTracks();
+			return false;
+		}
+		if (data.size() - offset < 8) {
+			// Truncated chunk size: leave the track empty (see readSmf()).
+			std::cerr << "Error: unexpected end of file." << std::endl;
+			break;
+		}
+		size_t size = ((size_t)data[offset+4] << 24) | (data[offset+5] << 16)
+				| (data[offset+6] << 8) | data[offset+7];
+		offset += 8;
+		m_lazyOffsets[i] = offset;
+		m_lazyCount++;
+		if (i == tracks - 1) {
+			break;
+		}
+		size_t next = offset + size;
+		if ((size <= data.size() - offset) && (data.size() - next >= 4) &&
+				(data[next] == 'M') && (data[next+1] == 'T') &&
+				(data[next+2] == 'r') && (data[next+3] == 'k')) {
+			offset = next;
+			continue;
+		}
+		MidiTrackDecoder decoder(data.subspan(offset), i);
+		MidiEvent event;
+		while (decoder.next(event)) {
+			// skip to the end of the track
+		}
+		if (!decoder.status()) {
+			clearLazyTracks();
+			return false;
+		}
+		offset += decoder.getOffset();
+	}
+	if (m_lazyCount == 0) {
+		m_lazyData.reset();
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::loadTrack -- Decode a track that was indexed but not decoded
+//    when the file was read.  Does nothing if the track is already loaded.
+//    Sequence numbers start from the offset of the track data in the file,
+//    so events keep their file order when tracks are joined even though
+//    the tracks are decoded in any order (the numbers are therefore not
+//    consecutive across tracks as they are after markSequence()).  A
+//    decoding error leaves the events read so far and clears status().
+//
+
+void MidiFile::loadTrack(int aTrack) const {
+	if ((m_lazyCount == 0) || (aTrack < 0) ||
+			(aTrack >= (int)m_lazyOffsets.size()) || (m_lazyOffsets[aTrack] == 0)) {
+		return;
+	}
+	size_t offset = m_lazyOffsets[aTrack];
+	m_lazyOffsets[aTrack] = 0;
+	std::span<const uchar> data = m_lazyData->span();
+
+	MidiEventList& events = *m_events[aTrack];
+	size_t size = ((size_t)data[offset-4] << 24) | (data[offset-3] << 16)
+			| (data[offset-2] << 8) | data[offset-1];
+	size = std::min(size, data.size() - offset);
+	events.reserve((int)(events.size() + size/2));
+
+	MidiTrackDecoder decoder(data.subspan(offset), aTrack);
+	int first = events.size();
+	if (!decoder.decode(events)) {
+		std::cerr << "Error: could not decode track " << aTrack << std::endl;
+		m_rwstatus = false;
+	}
+	int sequence = (int)offset;
+	for (int i=first; i<events.size(); i++) {
+		events[i].seq = sequence++;
+	}
+
+	if (--m_lazyCount == 0) {
+		m_lazyData.reset();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::loadAllTracks -- Decode all tracks that are not loaded yet.
+//    Called before any operation that works on all tracks at once.
+//
+
+void MidiFile::loadAllTracks(void) const {
+	for (int i=0; (m_lazyCount > 0) && (i<(int)m_lazyOffsets.size()); i++) {
+		loadTrack(i);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::clearLazyTracks -- Forget about undecoded tracks.
+//
+
+void MidiFile::clearLazyTracks(void) {
+	m_lazyData.reset();
+	m_lazyOffsets.clear();
+	m_lazyCount = 0;
+}
+
+
 
 //////////////////////////////
 //
@@ -570,6 +995,7 @@ bool MidiFile::write(const std::string& filename) {
 //
 
 bool MidiFile::write(std::ostream& out) {
+	loadAllTracks();
 	int oldTimeState = getTickState();
 	if (oldTimeState == TIME_STATE_ABSOLUTE) {
 		makeDeltaTicks();
@@ -699,25 +1125,10 @@ bool MidiFile::writeBase64(const std::string& filename, int width) {
 
 
 bool MidiFile::writeBase64(std::ostream& out, int width) {
-	std::stringstream raw;
-	bool status = MidiFile::write(raw);
-	if (!status) {
-		return status;
-	}
-	std::string encoded = MidiFile::base64Encode(raw.str());
-	if (width <= 0) {
-		out << encoded;
-		return status;
-	}
-	int length = (int)encoded.size();
-	for (int i=0; i<length; i++) {
-		out << encoded[i];
-		if ((i + 1) % width == 0) {
-			out << "\n";
-		}
-	}
-	if ((length + 1) % width != 0) {
-		out << "\n";
+	std::string encoded;
+	bool status = encodeBase64(encoded, width);
+	if (status) {
+		out.write(encoded.data(), encoded.size());
 	}
 	return status;
 }
@@ -731,12 +1142,12 @@ bool MidiFile::writeBase64(std::ostream& out, int width) {
 //
 
 std::string MidiFile::getBase64(int width) {
-	std::stringstream output;
-	bool status = MidiFile::writeBase64(output, width);
+	std::string output;
+	bool status = encodeBase64(output, width);
 	if (!status) {
 		return "";
 	} else {
-		return output.str();
+		return output;
 	}
 }
 
@@ -896,10 +1307,12 @@ bool MidiFile::status(void) const {
 //
 
 MidiEventList& MidiFile::operator[](int aTrack) {
+	loadTrack(aTrack);
 	return *m_events[aTrack];
 }
 
 const MidiEventList& MidiFile::operator[](int aTrack) const {
+	loadTrack(aTrack);
 	return *m_events[aTrack];
 }
 
@@ -939,9 +1352,11 @@ int MidiFile::size(void) const {
 //
 
 void MidiFile::removeEmpties(void) {
+	loadAllTracks();
 	for (auto &event : m_events) {
 		event->removeEmpties();
 	}
+	m_timemapTracks.clear();
 }
 
 
@@ -1017,6 +1432,7 @@ void MidiFile::clearSequence(int track) {
 //
 
 void MidiFile::joinTracks(void) {
+	loadAllTracks();
 	if (getTrackState() == TRACK_STATE_JOINED) {
 		return;
 	}
@@ -1040,18 +1456,35 @@ void MidiFile::joinTracks(void) {
 	if (oldTimeState == TIME_STATE_DELTA) {
 		makeAbsoluteTicks();
 	}
+
+	// The tracks are normally sorted already, so they only have to be
+	// merged; otherwise they are appended one after the other and the
+	// joined track is sorted.
+	std::vector<MidiEvent*> merged;
+	bool sorted = MidiEventList::mergeByKey(
+			std::vector<const MidiEventList*>(m_events.begin(), m_events.end()), merged);
 	for (i=0; i<length; i++) {
+		joinedTrack->adoptStorage(*m_events[i]);
+		if (sorted) {
+			continue;
+		}
 		for (j=0; j<(int)m_events[i]->size(); j++) {
 			joinedTrack->push_back_no_copy(&(*m_events[i])[j]);
 		}
 	}
+	for (MidiEvent* event : merged) {
+		joinedTrack->push_back_no_copy(event);
+	}
 
 	clear_no_deallocate();
 
 	delete m_events[0];
 	m_events.resize(0);
 	m_events.push_back(joinedTrack);
-	sortTracks();
+	m_timemapTracks.clear();
+	if (!sorted) {
+		sortTracks();
+	}
 	if (oldTimeState == TIME_STATE_DELTA) {
 		makeDeltaTicks();
 	}
@@ -1093,8 +1526,10 @@ void MidiFile::splitTracks(void) {
 	MidiEventList* olddata = m_events[0];
 	m_events[0] = NULL;
 	m_events.resize(trackCount);
+	m_timemapTracks.clear();
 	for (i=0; i<trackCount; i++) {
 		m_events[i] = new MidiEventList;
+		m_events[i]->adoptStorage(*olddata);
 	}
 
 	for (i=0; i<length; i++) {
@@ -1157,8 +1592,10 @@ void MidiFile::splitTracksByChannel(void) {
 
 	m_events[0] = NULL;
 	m_events.resize(trackCount);
+	m_timemapTracks.clear();
 	for (i=0; i<trackCount; i++) {
 		m_events[i] = new MidiEventList;
+		m_events[i]->adoptStorage(eventlist);
 	}
 
 	for (i=0; i<length; i++) {
@@ -1265,6 +1702,7 @@ int MidiFile::getSplitTrack(int index) const {
 //
 
 void MidiFile::makeDeltaTicks(void) {
+	loadAllTracks();
 	if (getTickState() == TIME_STATE_DELTA) {
 		return;
 	}
@@ -1316,6 +1754,7 @@ void MidiFile::deltaTicks(void) {
 //
 
 void MidiFile::makeAbsoluteTicks(void) {
+	loadAllTracks();
 	if (getTickState() == TIME_STATE_ABSOLUTE) {
 		return;
 	}
@@ -1404,7 +1843,7 @@ int MidiFile::getFileDurationInTicks(void) {
 	const MidiFile& mf = *this;
 	int output = 0;
 	for (int i=0; i<mf.getTrackCount(); i++) {
-		if (mf[i].back().tick > output) {
+		if ((mf[i].size() > 0) && (mf[i].back().tick > output)) {
 			output = mf[i].back().tick;
 		}
 	}
@@ -1442,11 +1881,8 @@ double MidiFile::getFileDurationInQuarters(void) {
 //    of the max time.
 
 double MidiFile::getFileDurationInSeconds(void) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
+	if (!updateTimeMap()) {
+		return -1.0;    // something went wrong
 	}
 	bool revertToDelta = false;
 	if (isDeltaTicks()) {
@@ -1456,7 +1892,7 @@ double MidiFile::getFileDurationInSeconds(void) {
 	const MidiFile& mf = *this;
 	double output = 0.0;
 	for (int i=0; i<mf.getTrackCount(); i++) {
-		if (mf[i].back().seconds > output) {
+		if ((mf[i].size() > 0) && (mf[i].back().seconds > output)) {
 			output = mf[i].back().seconds;
 		}
 	}
@@ -1467,6 +1903,90 @@ double MidiFile::getFileDurationInSeconds(void) {
 }
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// multi-threading functions --
+//
+
+//////////////////////////////
+//
+// MidiFile::setThreadCount -- Set the number of threads used for work
+//    that can be done separately for each track, such as decoding the
+//    tracks of a type-1 file in readSmf(), setting the time in seconds
+//    of the events in doTimeAnalysis() or linking note pairs in
+//    linkNotePairs().  The results do not depend on
+//    the thread count.  Use 1 (the default) for single-threaded operation
+//    or 0 to use one thread per hardware thread.
+//
+
+void MidiFile::setThreadCount(int count) {
+	m_threadCount = count < 0 ? 0 : count;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getThreadCount -- Return the thread count setting.
+//
+
+int MidiFile::getThreadCount(void) const {
+	return m_threadCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// lazy track loading functions --
+//
+
+//////////////////////////////
+//
+// MidiFile::setLazyLoading -- When enabled, readSmf() and read() only
+//    locate the MTrk chunks of a Standard MIDI File, and each track is
+//    decoded the first time it is accessed through operator[], getEvent()
+//    or getEventCount().  Functions that work on all tracks (joinTracks(),
+//    doTimeAnalysis(), write(), etc.) decode all remaining tracks first.
+//    Tracks that are never accessed cost no event allocations.  The file
+//    contents are kept in memory (or mapped) until every track has been
+//    decoded, and errors in a track are reported when it is decoded
+//    rather than by the read function.  Decoding on access modifies the
+//    object, so a lazily loaded file must not be accessed from several
+//    threads at once.  Takes effect on the next read.
+//
+
+void MidiFile::setLazyLoading(bool state) {
+	m_lazyLoading = state;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getLazyLoading -- Return the lazy loading setting.
+//
+
+bool MidiFile::getLazyLoading(void) const {
+	return m_lazyLoading;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::isTrackLoaded -- Returns false if the track has not been
+//    decoded yet (see setLazyLoading()).
+//
+
+bool MidiFile::isTrackLoaded(int aTrack) const {
+	if ((aTrack < 0) || (aTrack >= (int)m_lazyOffsets.size())) {
+		return true;
+	}
+	return m_lazyOffsets[aTrack] == 0;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // physical-time analysis functions --
@@ -1476,7 +1996,9 @@ double MidiFile::getFileDurationInSeconds(void) {
 //
 // MidiFile::doTimeAnalysis -- Identify the real-time position of
 //    all events by monitoring the tempo in relations to the tick
-//    times in the file.
+//    times in the file.  The track layout and tick state are left
+//    unchanged.  The whole time map is rebuilt, even if only part of
+//    it was invalidated (see invalidateTimeMap()).
 //
 
 void MidiFile::doTimeAnalysis(void) {
@@ -1487,77 +2009,288 @@ void MidiFile::doTimeAnalysis(void) {
 
 //////////////////////////////
 //
-// MidiFile::getTimeInSeconds -- return the time in seconds for
-//     the current message.
+// MidiFile::invalidateTimeMap -- Mark the time map and the event times in
+//    seconds as out of date from the given tick onwards.  The add*()
+//    functions call this for the tick of each new event; call it after
+//    changing the tick of an event (with the smaller of the old and new
+//    ticks) or removing a tempo message.  The next function that needs
+//    the time map (getTimeInSeconds(), getFileDurationInSeconds(), ...)
+//    then rebuilds the tempo segments from the earliest invalidated tick
+//    and recomputes MidiEvent::seconds only for events at or after it.
+//    Events before that tick are not touched, and in tracks that were
+//    sorted when the map was built they are not even visited, so edits
+//    that make such a track unsorted should be followed by sortTracks()
+//    or doTimeAnalysis().  In delta-tick state, or for a tick of 0 or
+//    less, the whole map is rebuilt.
+//
+
+void MidiFile::invalidateTimeMap(int tick) {
+	if (m_timemapvalid == 0) {
+		return;
+	}
+	if ((tick <= 0) || isDeltaTicks()) {
+		m_timemapvalid = 0;
+		m_timemapdirty = false;
+		return;
+	}
+	if (!m_timemapdirty || (tick < m_timemapDirtyTick)) {
+		m_timemapDirtyTick = tick;
+	}
+	m_timemapdirty = true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getTimeInSeconds -- return the time in seconds for
+//     the current message.  The time is computed from the tempo segment
+//     containing the tick, so ticks between events and after the last
+//     event are converted exactly as well.  Negative ticks return -1.
+//
+
+double MidiFile::getTimeInSeconds(int aTrack, int anIndex) {
+	return getTimeInSeconds(getEvent(aTrack, anIndex).tick);
+}
+
+
+double MidiFile::getTimeInSeconds(int tickvalue) {
+	if (!updateTimeMap()) {
+		return -1.0;    // something went wrong
+	}
+	if (tickvalue < 0) {
+		return -1.0;
+	}
+	const _TempoSegment& segment = getTempoSegmentAtTick(tickvalue);
+	return segment.seconds + (tickvalue - segment.tick) * segment.secondsPerTick;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getAbsoluteTickTime -- return the tick value represented
+//    by the input time in seconds.  The result is fractional when the
+//    time falls between two ticks.  Negative times return -1.
+//
+
+double MidiFile::getAbsoluteTickTime(double starttime) {
+	if (!updateTimeMap()) {
+		return -1.0;    // something went wrong
+	}
+	if (starttime < 0.0) {
+		return -1.0;
+	}
+	const _TempoSegment& segment = getTempoSegmentAtSecond(starttime);
+	return segment.tick + (starttime - segment.seconds) / segment.secondsPerTick;
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getTimesInSeconds -- convert a list of ticks to seconds, as
+//    getTimeInSeconds() would for each of them.  The ticks do not have to
+//    be sorted, but sorted (or mostly sorted) input is fastest: the tempo
+//    segment found for one tick is kept for the following ones, and each
+//    run of ticks in the same segment is converted in a single loop, four
+//    ticks at a time with SSE2.  The SSE2 loop does the same multiply and
+//    add as the scalar one, so the results are identical.
+//
+
+void MidiFile::getTimesInSeconds(std::span<const int> ticks,
+		std::vector<double>& seconds) {
+	seconds.resize(ticks.size());
+	if (!updateTimeMap()) {
+		std::fill(seconds.begin(), seconds.end(), -1.0);
+		return;
+	}
+	const _TempoSegment* segments = m_timemap.data();
+	int count = (int)m_timemap.size();
+	const int* input = ticks.data();
+	double* output = seconds.data();
+	size_t size = ticks.size();
+	int k = 0;
+	size_t i = 0;
+	while (i < size) {
+		int tick = input[i];
+		if (tick < 0) {
+			output[i++] = -1.0;
+			continue;
+		}
+		if ((k + 1 < count) && (tick >= segments[k+1].tick)) {
+			if ((k + 2 >= count) || (tick < segments[k+2].tick)) {
+				k++;
+			} else {
+				k = (int)(&getTempoSegmentAtTick(tick) - segments);
+			}
+		} else if (tick < segments[k].tick) {
+			k = (int)(&getTempoSegmentAtTick(tick) - segments);
+		}
+		int start = segments[k].tick;
+		int end = k + 1 < count ? segments[k+1].tick : INT_MAX;
+		size_t last = i + 1;
+		while ((last < size) && (input[last] >= start) && (input[last] < end)) {
+			last++;
+		}
+		double base = segments[k].seconds;
+		double secondsPerTick = segments[k].secondsPerTick;
+		size_t j = i;
+#if defined(__SSE2__)
+		__m128i startx4 = _mm_set1_epi32(start);
+		__m128d basex2 = _mm_set1_pd(base);
+		__m128d secondsPerTickx2 = _mm_set1_pd(secondsPerTick);
+		for (; last - j >= 4; j += 4) {
+			__m128i offsets = _mm_sub_epi32(
+					_mm_loadu_si128((const __m128i*)(input + j)), startx4);
+			__m128d low = _mm_cvtepi32_pd(offsets);
+			__m128d high = _mm_cvtepi32_pd(_mm_srli_si128(offsets, 8));
+			_mm_storeu_pd(output + j,
+					_mm_add_pd(basex2, _mm_mul_pd(low, secondsPerTickx2)));
+			_mm_storeu_pd(output + j + 2,
+					_mm_add_pd(basex2, _mm_mul_pd(high, secondsPerTickx2)));
+		}
+#endif
+		for (; j<last; j++) {
+			output[j] = base + (input[j] - start) * secondsPerTick;
+		}
+		i = last;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getAbsoluteTickTimes -- convert a list of times in seconds
+//    to ticks, as getAbsoluteTickTime() would for each of them.  Like
+//    getTimesInSeconds(), sorted input is converted one tempo segment at
+//    a time, two times at a time with SSE2.
 //
 
-double MidiFile::getTimeInSeconds(int aTrack, int anIndex) {
-	return getTimeInSeconds(getEvent(aTrack, anIndex).tick);
-}
-
-
-double MidiFile::getTimeInSeconds(int tickvalue) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
+void MidiFile::getAbsoluteTickTimes(std::span<const double> seconds,
+		std::vector<double>& ticks) {
+	ticks.resize(seconds.size());
+	if (!updateTimeMap()) {
+		std::fill(ticks.begin(), ticks.end(), -1.0);
+		return;
+	}
+	const _TempoSegment* segments = m_timemap.data();
+	int count = (int)m_timemap.size();
+	const double* input = seconds.data();
+	double* output = ticks.data();
+	size_t size = seconds.size();
+	int k = 0;
+	size_t i = 0;
+	while (i < size) {
+		double time = input[i];
+		if (time < 0.0) {
+			output[i++] = -1.0;
+			continue;
+		}
+		if ((k + 1 < count) && (time >= segments[k+1].seconds)) {
+			if ((k + 2 >= count) || (time < segments[k+2].seconds)) {
+				k++;
+			} else {
+				k = (int)(&getTempoSegmentAtSecond(time) - segments);
+			}
+		} else if (time < segments[k].seconds) {
+			k = (int)(&getTempoSegmentAtSecond(time) - segments);
+		}
+		double start = segments[k].seconds;
+		double end = k + 1 < count ? segments[k+1].seconds : HUGE_VAL;
+		size_t last = i + 1;
+		while ((last < size) && (input[last] >= start) && (input[last] < end)) {
+			last++;
+		}
+		double base = segments[k].tick;
+		double secondsPerTick = segments[k].secondsPerTick;
+		size_t j = i;
+#if defined(__SSE2__)
+		__m128d startx2 = _mm_set1_pd(start);
+		__m128d basex2 = _mm_set1_pd(base);
+		__m128d secondsPerTickx2 = _mm_set1_pd(secondsPerTick);
+		for (; last - j >= 2; j += 2) {
+			__m128d offsets = _mm_sub_pd(_mm_loadu_pd(input + j), startx2);
+			_mm_storeu_pd(output + j,
+					_mm_add_pd(basex2, _mm_div_pd(offsets, secondsPerTickx2)));
+		}
+#endif
+		for (; j<last; j++) {
+			output[j] = base + (input[j] - start) / secondsPerTick;
 		}
+		i = last;
 	}
+}
 
-	_TickTime key;
-	key.tick    = tickvalue;
-	key.seconds = -1;
 
-	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
-			sizeof(_TickTime), ticksearch);
 
-	if (ptr == NULL) {
-		// The specific tick value was not found, so do a linear
-		// search for the two tick values which occur before and
-		// after the tick value, and do a linear interpolation of
-		// the time in seconds values to figure out the final
-		// time in seconds.
-		// Since the code is not yet written, kill the program at this point:
-		return linearSecondInterpolationAtTick(tickvalue);
-	} else {
-		return ((_TickTime*)ptr)->seconds;
+//////////////////////////////
+//
+// MidiFile::getTimeInNanoseconds -- return the time of a tick as an
+//    integer number of nanoseconds.  The time is computed exactly from
+//    the tempo messages (microseconds per quarter note) and the ticks per
+//    quarter note with integer arithmetic, and rounded to the nearest
+//    nanosecond once, so it does not depend on floating-point rounding
+//    and does not drift over long files.  Negative ticks return -1.
+//
+
+int64_t MidiFile::getTimeInNanoseconds(int tickvalue) {
+	if (!updateTimeMap()) {
+		return -1;    // something went wrong
+	}
+	if (tickvalue < 0) {
+		return -1;
 	}
+	return getSegmentNanoseconds(getTempoSegmentAtTick(tickvalue), tickvalue);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::getAbsoluteTickTime -- return the tick value represented
-//    by the input time in seconds.  If there is not tick entry at
-//    the given time in seconds, then interpolate between two values.
+// MidiFile::getTimesInNanoseconds -- convert a list of ticks to
+//    nanoseconds, as getTimeInNanoseconds() would for each of them.  The
+//    tempo segment found for one tick is reused for the following ones
+//    while they stay inside it.
 //
 
-double MidiFile::getAbsoluteTickTime(double starttime) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
+void MidiFile::getTimesInNanoseconds(std::span<const int> ticks,
+		std::vector<int64_t>& nanoseconds) {
+	nanoseconds.resize(ticks.size());
+	if (!updateTimeMap()) {
+		std::fill(nanoseconds.begin(), nanoseconds.end(), -1);
+		return;
+	}
+	const _TempoSegment* segments = m_timemap.data();
+	int count = (int)m_timemap.size();
+	int k = 0;
+	for (size_t i=0; i<ticks.size(); i++) {
+		int tick = ticks[i];
+		if (tick < 0) {
+			nanoseconds[i] = -1;
+			continue;
+		}
+		if ((tick < segments[k].tick)
+				|| ((k + 1 < count) && (tick >= segments[k+1].tick))) {
+			k = (int)(&getTempoSegmentAtTick(tick) - segments);
 		}
+		nanoseconds[i] = getSegmentNanoseconds(segments[k], tick);
 	}
+}
 
-	_TickTime key;
-	key.tick    = -1;
-	key.seconds = starttime;
 
-	void* ptr = bsearch(&key, m_timemap.data(), m_timemap.size(),
-			sizeof(_TickTime), secondsearch);
 
-	if (ptr == NULL) {
-		// The specific seconds value was not found, so do a linear
-		// search for the two time values which occur before and
-		// after the given time value, and do a linear interpolation of
-		// the time in tick values to figure out the final time in ticks.
-		return linearTickInterpolationAtSecond(starttime);
-	} else {
-		return ((_TickTime*)ptr)->tick;
-	}
+//////////////////////////////
+//
+// MidiFile::getTempoSegmentCount -- return the number of constant-tempo
+//    segments in the time map: one for the start of the file plus one
+//    for each tick with a tempo change.
+//
 
+int MidiFile::getTempoSegmentCount(void) {
+	updateTimeMap();
+	return (int)m_timemap.size();
 }
 
 
@@ -1571,34 +2304,17 @@ double MidiFile::getAbsoluteTickTime(double starttime) {
 //
 // MidiFile::linkNotePairs --  Link note-ons to note-offs separately
 //     for each track.  Returns the total number of note message pairs
-//     that were linked.
+//     that were linked.  The tracks are linked in parallel according to
+//     setThreadCount().
 //
 
 int MidiFile::linkNotePairsFIFO(void) {
-	int i;
-	int sum = 0;
-	for (i=0; i<getTrackCount(); i++) {
-		if (m_events[i] == NULL) {
-			continue;
-		}
-		sum += m_events[i]->linkNotePairsFIFO();
-	}
-	m_linkedEventsQ = true;
-	return sum;
+	return linkTracks(false);
 }
 
 
 int MidiFile::linkNotePairsLIFO(void) {
-	int i;
-	int sum = 0;
-	for (i=0; i<getTrackCount(); i++) {
-		if (m_events[i] == NULL) {
-			continue;
-		}
-		sum += m_events[i]->linkNotePairsLIFO();
-	}
-	m_linkedEventsQ = true;
-	return sum;
+	return linkTracks(true);
 }
 
 //
@@ -1610,6 +2326,167 @@ int MidiFile::linkEventPairs(void) {
 }
 
 
+
+//////////////////////////////
+//
+// MidiFile::doTimeAnalysisAndLinkNotePairs -- Same as doTimeAnalysis()
+//     followed by linkNotePairs(), but each track is timed and linked by
+//     the same thread right after each other, while its events are
+//     still in cache, instead of going over all tracks twice.  Returns
+//     the number of note pairs that were linked.
+//
+
+int MidiFile::doTimeAnalysisAndLinkNotePairs(void) {
+	loadAllTracks();
+	std::vector<int> counts(getTrackCount(), 0);
+	buildTimeMap(0, [&](int track) {
+		counts[track] = m_events[track]->linkPairs(false, true);
+	});
+	m_linkedEventsQ = true;
+	return std::accumulate(counts.begin(), counts.end(), 0);
+}
+
+
+
+//////////////////////////////
+//
+// MidiFile::getNoteSpans -- Store all notes of the file in onset order
+//     (ties are in track order, then in file order), with their onsets
+//     and durations in ticks, seconds and nanoseconds (computed as in
+//     getTimeInNanoseconds(), without accumulating rounding errors from
+//     the times in seconds).  Each track is read once:
+//     note-ons are paired with note-offs in the same way as
+//     linkNotePairsFIFO(), but the events are not linked, so the notes
+//     can be extracted without linking the file first.  Note-ons that
+//     are never turned off last until the last event of their track and
+//     have "terminated" set to false.  Returns the number of notes.
+//
+
+int MidiFile::getNoteSpans(std::vector<NoteSpan>& notes) {
+	notes.clear();
+	if (!updateTimeMap()) {
+		return 0;
+	}
+	bool delta = isDeltaTicks();
+
+	// sounding notes of each channel/key, oldest first: the indexes in
+	// notes of the first and last one (or -1), and of the next one for
+	// each sounding note.
+	std::vector<int> head(16 * 128);
+	std::vector<int> tail(16 * 128);
+	std::vector<int> next;
+
+	// runs == index in notes of the first note of each track, followed
+	// by the number of notes.
+	std::vector<size_t> runs;
+
+	for (int i=0; i<getTrackCount(); i++) {
+		const MidiEventList& list = *m_events[i];
+		std::fill(head.begin(), head.end(), -1);
+		std::fill(tail.begin(), tail.end(), -1);
+		size_t first = notes.size();
+		runs.push_back(first);
+		int tick = 0;
+		int endTick = 0;
+		double endSeconds = 0.0;
+		for (int j=0; j<list.size(); j++) {
+			const MidiEvent& event = list[j];
+			tick = delta ? tick + event.tick : event.tick;
+			if (tick >= endTick) {
+				endTick = tick;
+				endSeconds = event.seconds;
+			}
+			if (event.size() != 3) {
+				continue;
+			}
+			const uchar* bytes = event.data();
+			int command = bytes[0] & 0xf0;
+			if ((command != 0x80) && (command != 0x90)) {
+				continue;
+			}
+			int slot = ((bytes[0] & 0x0f) << 7) | (bytes[1] & 0x7f);
+			if ((command == 0x90) && (bytes[2] != 0)) {
+				NoteSpan note;
+				note.seconds  = event.seconds;
+				note.tick     = tick;
+				note.key      = bytes[1];
+				note.velocity = bytes[2];
+				note.channel  = bytes[0] & 0x0f;
+				note.track    = i;
+				int index = (int)notes.size();
+				notes.push_back(note);
+				next.push_back(-1);
+				if (tail[slot] < 0) {
+					head[slot] = index;
+				} else {
+					next[tail[slot]] = index;
+				}
+				tail[slot] = index;
+			} else if (head[slot] >= 0) {
+				NoteSpan& note = notes[head[slot]];
+				note.tickDuration = tick - note.tick;
+				note.duration     = event.seconds - note.seconds;
+				note.terminated   = true;
+				head[slot] = next[head[slot]];
+				if (head[slot] < 0) {
+					tail[slot] = -1;
+				}
+			}
+		}
+		for (size_t j=first; j<notes.size(); j++) {
+			NoteSpan& note = notes[j];
+			if (!note.terminated) {
+				note.tickDuration = endTick - note.tick;
+				note.duration     = endSeconds - note.seconds;
+			}
+			int endNoteTick = note.tick + note.tickDuration;
+			note.nanoseconds  = getSegmentNanoseconds(
+					getTempoSegmentAtTick(note.tick), note.tick);
+			note.nanoDuration = getSegmentNanoseconds(
+					getTempoSegmentAtTick(endNoteTick), endNoteTick) - note.nanoseconds;
+		}
+	}
+	runs.push_back(notes.size());
+
+	// The notes of each track are usually in onset order already, in
+	// which case the tracks are merged, taking the smallest (tick, track)
+	// next.  Otherwise all notes are sorted.
+	auto byTick = [](const NoteSpan& a, const NoteSpan& b) {
+		return a.tick < b.tick;
+	};
+	bool sorted = true;
+	for (int i=0; i+1<(int)runs.size(); i++) {
+		sorted = sorted && std::is_sorted(notes.begin() + runs[i],
+				notes.begin() + runs[i+1], byTick);
+	}
+	if (!sorted) {
+		std::stable_sort(notes.begin(), notes.end(), byTick);
+		return (int)notes.size();
+	}
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>,
+			std::greater<std::pair<int, int>>> order;
+	for (int i=0; i+1<(int)runs.size(); i++) {
+		if (runs[i] < runs[i+1]) {
+			order.emplace(notes[runs[i]].tick, i);
+		}
+	}
+	std::vector<size_t> positions(runs.begin(), runs.end() - 1);
+	std::vector<NoteSpan> merged;
+	merged.reserve(notes.size());
+	while (!order.empty()) {
+		int run = order.top().second;
+		order.pop();
+		size_t& position = positions[run];
+		merged.push_back(notes[position++]);
+		if (position < runs[run+1]) {
+			order.emplace(notes[position].tick, run);
+		}
+	}
+	notes.swap(merged);
+	return (int)notes.size();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // filename functions --
@@ -1650,14 +2527,11 @@ const char* MidiFile::getFilename(void) const {
 //
 
 MidiEvent* MidiFile::addEvent(int aTrack, int aTick,
-		std::vector<uchar>& midiData) {
-	m_timemapvalid = 0;
-	MidiEvent* me = new MidiEvent;
-	me->tick = aTick;
-	me->track = aTrack;
-	me->setMessage(midiData);
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+		const std::vector<uchar>& midiData) {
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.setMessage(midiData);
+	return &me;
 }
 
 
@@ -1665,9 +2539,13 @@ MidiEvent* MidiFile::addEvent(int aTrack, int aTick,
 //////////////////////////////
 //
 // MidiFile::addEvent -- Some bug here when joinedTracks(), but track==1...
+//     The rvalue versions move the message bytes into the track instead
+//     of copying them.
 //
 
 MidiEvent* MidiFile::addEvent(MidiEvent& mfevent) {
+	invalidateTimeMap(mfevent.tick);
+	loadTrack(mfevent.track);
 	if (getTrackState() == TRACK_STATE_JOINED) {
 		m_events[0]->push_back(mfevent);
 		return &m_events[0]->back();
@@ -1677,11 +2555,19 @@ MidiEvent* MidiFile::addEvent(MidiEvent& mfevent) {
 	}
 }
 
+
+MidiEvent* MidiFile::addEvent(MidiEvent&& mfevent) {
+	int track = mfevent.track;
+	return addEvent(track, std::move(mfevent));
+}
+
 //
 // Variant where the track is an input parameter:
 //
 
 MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent& mfevent) {
+	invalidateTimeMap(mfevent.tick);
+	loadTrack(aTrack);
 	if (getTrackState() == TRACK_STATE_JOINED) {
 		m_events[0]->push_back(mfevent);
       m_events[0]->back().track = aTrack;
@@ -1694,6 +2580,19 @@ MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent& mfevent) {
 }
 
 
+MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent&& mfevent) {
+	invalidateTimeMap(mfevent.tick);
+	loadTrack(aTrack);
+	int index = aTrack;
+	if (getTrackState() == TRACK_STATE_JOINED) {
+		index = 0;
+	}
+	m_events.at(index)->push_back(std::move(mfevent));
+	m_events.at(index)->back().track = aTrack;
+	return &m_events.at(index)->back();
+}
+
+
 
 ///////////////////////////////
 //
@@ -1702,7 +2601,6 @@ MidiEvent* MidiFile::addEvent(int aTrack, MidiEvent& mfevent) {
 
 MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
 		std::vector<uchar>& metaData) {
-	m_timemapvalid = 0;
 	int i;
 	int length = (int)metaData.size();
 	std::vector<uchar> fulldata;
@@ -1743,11 +2641,10 @@ MidiEvent* MidiFile::addMetaEvent(int aTrack, int aTick, int aType,
 //
 
 MidiEvent* MidiFile::addText(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeText(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeText(text);
+	return &me;
 }
 
 
@@ -1758,11 +2655,10 @@ MidiEvent* MidiFile::addText(int aTrack, int aTick, const std::string& text) {
 //
 
 MidiEvent* MidiFile::addCopyright(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeCopyright(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeCopyright(text);
+	return &me;
 }
 
 
@@ -1773,11 +2669,10 @@ MidiEvent* MidiFile::addCopyright(int aTrack, int aTick, const std::string& text
 //
 
 MidiEvent* MidiFile::addTrackName(int aTrack, int aTick, const std::string& name) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTrackName(name);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeTrackName(name);
+	return &me;
 }
 
 
@@ -1789,11 +2684,10 @@ MidiEvent* MidiFile::addTrackName(int aTrack, int aTick, const std::string& name
 
 MidiEvent* MidiFile::addInstrumentName(int aTrack, int aTick,
 		const std::string& name) {
-	MidiEvent* me = new MidiEvent;
-	me->makeInstrumentName(name);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeInstrumentName(name);
+	return &me;
 }
 
 
@@ -1804,11 +2698,10 @@ MidiEvent* MidiFile::addInstrumentName(int aTrack, int aTick,
 //
 
 MidiEvent* MidiFile::addLyric(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeLyric(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeLyric(text);
+	return &me;
 }
 
 
@@ -1819,11 +2712,10 @@ MidiEvent* MidiFile::addLyric(int aTrack, int aTick, const std::string& text) {
 //
 
 MidiEvent* MidiFile::addMarker(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeMarker(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeMarker(text);
+	return &me;
 }
 
 
@@ -1834,11 +2726,10 @@ MidiEvent* MidiFile::addMarker(int aTrack, int aTick, const std::string& text) {
 //
 
 MidiEvent* MidiFile::addCue(int aTrack, int aTick, const std::string& text) {
-	MidiEvent* me = new MidiEvent;
-	me->makeCue(text);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeCue(text);
+	return &me;
 }
 
 
@@ -1849,11 +2740,10 @@ MidiEvent* MidiFile::addCue(int aTrack, int aTick, const std::string& text) {
 //
 
 MidiEvent* MidiFile::addTempo(int aTrack, int aTick, double aTempo) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTempo(aTempo);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeTempo(aTempo);
+	return &me;
 }
 
 
@@ -1873,11 +2763,10 @@ MidiEvent* MidiFile::addTempo(int aTrack, int aTick, double aTempo) {
 //
 
 MidiEvent* MidiFile::addKeySignature (int aTrack, int aTick, int fifths, bool mode) {
-    MidiEvent* me = new MidiEvent;
-    me->makeKeySignature(fifths, mode);
-    me->tick = aTick;
-    m_events[aTrack]->push_back_no_copy(me);
-    return me;
+    invalidateTimeMap(aTick);
+    MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+    me.makeKeySignature(fifths, mode);
+    return &me;
 }
 
 
@@ -1907,11 +2796,10 @@ MidiEvent* MidiFile::addKeySignature (int aTrack, int aTick, int fifths, bool mo
 
 MidiEvent* MidiFile::addTimeSignature(int aTrack, int aTick, int top, int bottom,
 		int clocksPerClick, int num32ndsPerQuarter) {
-	MidiEvent* me = new MidiEvent;
-	me->makeTimeSignature(top, bottom, clocksPerClick, num32ndsPerQuarter);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeTimeSignature(top, bottom, clocksPerClick, num32ndsPerQuarter);
+	return &me;
 }
 
 
@@ -1999,11 +2887,10 @@ int MidiFile::makeVLV(uchar *buffer, int number) {
 //
 
 MidiEvent* MidiFile::addNoteOn(int aTrack, int aTick, int aChannel, int key, int vel) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOn(aChannel, key, vel);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeNoteOn(aChannel, key, vel);
+	return &me;
 }
 
 
@@ -2015,11 +2902,10 @@ MidiEvent* MidiFile::addNoteOn(int aTrack, int aTick, int aChannel, int key, int
 
 MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key,
 		int vel) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOff(aChannel, key, vel);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeNoteOff(aChannel, key, vel);
+	return &me;
 }
 
 
@@ -2031,11 +2917,10 @@ MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key,
 //
 
 MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key) {
-	MidiEvent* me = new MidiEvent;
-	me->makeNoteOff(aChannel, key);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeNoteOff(aChannel, key);
+	return &me;
 }
 
 
@@ -2048,11 +2933,10 @@ MidiEvent* MidiFile::addNoteOff(int aTrack, int aTick, int aChannel, int key) {
 
 MidiEvent* MidiFile::addController(int aTrack, int aTick, int aChannel,
 		int num, int value) {
-	MidiEvent* me = new MidiEvent;
-	me->makeController(aChannel, num, value);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makeController(aChannel, num, value);
+	return &me;
 }
 
 
@@ -2065,11 +2949,10 @@ MidiEvent* MidiFile::addController(int aTrack, int aTick, int aChannel,
 
 MidiEvent* MidiFile::addPatchChange(int aTrack, int aTick, int aChannel,
 		int patchnum) {
-	MidiEvent* me = new MidiEvent;
-	me->makePatchChange(aChannel, patchnum);
-	me->tick = aTick;
-	m_events[aTrack]->push_back_no_copy(me);
-	return me;
+	invalidateTimeMap(aTick);
+	MidiEvent& me = operator[](aTrack).emplace_back(aTick, aTrack);
+	me.makePatchChange(aChannel, patchnum);
+	return &me;
 }
 
 
@@ -2098,7 +2981,7 @@ MidiEvent* MidiFile::addTimbre(int aTrack, int aTick, int aChannel, int patchnum
 //
 
 MidiEvent* MidiFile::addPitchBend(int aTrack, int aTick, int aChannel, double amount) {
-	m_timemapvalid = 0;
+	invalidateTimeMap(aTick);
 	amount += 1.0;
 	int value = int(amount * 8192 + 0.5);
 
@@ -2113,18 +2996,13 @@ MidiEvent* MidiFile::addPitchBend(int aTrack, int aTick, int aChannel, double am
 	int lsbint = 0x7f & value;
 	int msbint = 0x7f & (value  >> 7);
 
-	std::vector<uchar> mididata;
-	mididata.resize(3);
 	if (aChannel < 0) {
 		aChannel = 0;
 	} else if (aChannel > 15) {
 		aChannel = 15;
 	}
-	mididata[0] = uchar(0xe0 | aChannel);
-	mididata[1] = uchar(lsbint);
-	mididata[2] = uchar(msbint);
-
-	return addEvent(aTrack, aTick, mididata);
+	return &operator[](aTrack).emplace_back(aTick, aTrack, 0xe0 | aChannel,
+			lsbint, msbint);
 }
 
 
@@ -2240,6 +3118,7 @@ int MidiFile::addTrack(void) {
 	m_events[length] = new MidiEventList;
 	m_events[length]->reserve(10000);
 	m_events[length]->clear();
+	m_timemapTracks.clear();
 	return length;
 }
 
@@ -2252,6 +3131,7 @@ int MidiFile::addTrack(int count) {
 		m_events[length + i]->reserve(10000);
 		m_events[length + i]->clear();
 	}
+	m_timemapTracks.clear();
 	return length + count - 1;
 }
 
@@ -2287,6 +3167,7 @@ void MidiFile::allocateEvents(int track, int aSize) {
 //
 
 void MidiFile::deleteTrack(int aTrack) {
+	loadAllTracks();
 	int length = getNumTracks();
 	if (aTrack < 0 || aTrack >= length) {
 		return;
@@ -2301,6 +3182,8 @@ void MidiFile::deleteTrack(int aTrack) {
 
 	m_events[length-1] = NULL;
 	m_events.resize(length-1);
+	invalidateTimeMap(0);
+	m_timemapTracks.clear();
 }
 
 
@@ -2319,8 +3202,10 @@ void MidiFile::clear(void) {
 	}
 	m_events.resize(1);
 	m_events[0] = new MidiEventList;
+	clearLazyTracks();
 	m_timemapvalid=0;
 	m_timemap.clear();
+	m_timemapTracks.clear();
 	m_theTrackState = TRACK_STATE_SPLIT;
 	m_theTimeState = TIME_STATE_ABSOLUTE;
 }
@@ -2339,11 +3224,13 @@ void MidiFile::erase(void) {
 //
 
 MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) {
+	loadTrack(aTrack);
 	return (*m_events[aTrack])[anIndex];
 }
 
 
 const MidiEvent& MidiFile::getEvent(int aTrack, int anIndex) const {
+	loadTrack(aTrack);
 	return (*m_events[aTrack])[anIndex];
 }
 
@@ -2384,11 +3271,13 @@ int MidiFile::getTPQ(void) const {
 //
 
 int MidiFile::getEventCount(int aTrack) const {
+	loadTrack(aTrack);
 	return m_events[aTrack]->size();
 }
 
 
 int MidiFile::getNumEvents(int aTrack) const {
+	loadTrack(aTrack);
 	return m_events[aTrack]->size();
 }
 
@@ -2405,6 +3294,10 @@ int MidiFile::getNumEvents(int aTrack) const {
 //
 
 void MidiFile::mergeTracks(int aTrack1, int aTrack2) {
+	if (aTrack1 == aTrack2) {
+		return;
+	}
+	loadAllTracks();
 	MidiEventList* mergedTrack;
 	mergedTrack = new MidiEventList;
 	int oldTimeState = getTickState();
@@ -2412,17 +3305,36 @@ void MidiFile::mergeTracks(int aTrack1, int aTrack2) {
 		makeAbsoluteTicks();
 	}
 	int length = getNumTracks();
-	for (int i=0; i<(int)m_events[aTrack1]->size(); i++) {
-		mergedTrack->push_back((*m_events[aTrack1])[i]);
-	}
 	for (int j=0; j<(int)m_events[aTrack2]->size(); j++) {
 		(*m_events[aTrack2])[j].track = aTrack1;
-		mergedTrack->push_back((*m_events[aTrack2])[j]);
 	}
 
-	mergedTrack->sort();
+	// Both tracks are normally sorted already, so they only have to be
+	// merged; otherwise they are appended and the result is sorted.
+	std::vector<MidiEvent*> merged;
+	bool sorted = MidiEventList::mergeByKey({m_events[aTrack1], m_events[aTrack2]},
+			merged);
+	mergedTrack->reserve(m_events[aTrack1]->size() + m_events[aTrack2]->size());
+	mergedTrack->adoptStorage(*m_events[aTrack1]);
+	mergedTrack->adoptStorage(*m_events[aTrack2]);
+	if (sorted) {
+		for (MidiEvent* event : merged) {
+			mergedTrack->push_back_no_copy(event);
+		}
+	} else {
+		for (int i=0; i<(int)m_events[aTrack1]->size(); i++) {
+			mergedTrack->push_back_no_copy(&(*m_events[aTrack1])[i]);
+		}
+		for (int j=0; j<(int)m_events[aTrack2]->size(); j++) {
+			mergedTrack->push_back_no_copy(&(*m_events[aTrack2])[j]);
+		}
+		mergedTrack->sort();
+	}
 
+	m_events[aTrack1]->detach();
+	m_events[aTrack2]->detach();
 	delete m_events[aTrack1];
+	delete m_events[aTrack2];
 
 	m_events[aTrack1] = mergedTrack;
 
@@ -2435,6 +3347,7 @@ void MidiFile::mergeTracks(int aTrack1, int aTrack2) {
 
 	m_events[length-1] = NULL;
 	m_events.resize(length-1);
+	m_timemapTracks.clear();
 
 	if (oldTimeState == TIME_STATE_DELTA) {
 		deltaTicks();
@@ -2493,6 +3406,7 @@ void MidiFile::setMillisecondTicks(void) {
 
 
 void MidiFile::sortTrackNoteOnsBeforeOffs(int track) {
+	loadTrack(track);
 	if ((track >= 0) && (track < getTrackCount())) {
 		m_events.at(track)->sortNoteOnsBeforeOffs();
 	} else {
@@ -2501,6 +3415,7 @@ void MidiFile::sortTrackNoteOnsBeforeOffs(int track) {
 }
 
 void MidiFile::sortTrackNoteOffsBeforeOns(int track) {
+	loadTrack(track);
 	if ((track >= 0) && (track < getTrackCount())) {
 		m_events.at(track)->sortNoteOffsBeforeOns();
 	} else {
@@ -2516,6 +3431,7 @@ void MidiFile::sortTrackNoteOffsBeforeOns(int track) {
 //
 
 void MidiFile::sortTracksNoteOnsBeforeOffs(void) {
+	loadAllTracks();
 	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
 		for (int i=0; i<getTrackCount(); i++) {
 			m_events.at(i)->sortNoteOnsBeforeOffs();
@@ -2526,6 +3442,7 @@ void MidiFile::sortTracksNoteOnsBeforeOffs(void) {
 }
 
 void MidiFile::sortTracksNoteOffsBeforeOns(void) {
+	loadAllTracks();
 	if (m_theTimeState == TIME_STATE_ABSOLUTE) {
 		for (int i=0; i<getTrackCount(); i++) {
 			m_events.at(i)->sortNoteOffsBeforeOns();
@@ -2568,6 +3485,7 @@ int MidiFile::getTrackCountAsType1(void) {
 //
 
 void MidiFile::clearLinks(void) {
+	loadAllTracks();
 	for (int i=0; i<getTrackCount(); i++) {
 		if (m_events[i] == NULL) {
 			continue;
@@ -2586,221 +3504,317 @@ void MidiFile::clearLinks(void) {
 
 //////////////////////////////
 //
-// MidiFile::linearTickInterpolationAtSecond -- return the tick value at the
-//    given input time.
+// MidiFile::updateTimeMap -- make the time map current: build it if it
+//      is not valid, or update it from the earliest tick passed to
+//      invalidateTimeMap() since it was built.  Returns false if the
+//      time map could not be built.
 //
 
-double MidiFile::linearTickInterpolationAtSecond(double seconds) {
+bool MidiFile::updateTimeMap(void) {
 	if (m_timemapvalid == 0) {
 		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
+	} else if (m_timemapdirty) {
+		buildTimeMap(m_timemapDirtyTick);
 	}
+	return m_timemapvalid;
+}
 
-	int i;
-	double lasttime = m_timemap[m_timemap.size()-1].seconds;
-	// give an error value of -1 if time is out of range of data.
-	if (seconds < 0.0) {
-		return -1.0;
+
+
+//////////////////////////////
+//
+// MidiFile::buildTimeMap -- build the list of tempo segments of the
+//      file and set the time in seconds of every event from them.
+//      Until the first tempo message the tempo is 120 beats per minute.
+//      Each tempo message starts a new segment at its tick (several
+//      tempo messages on the same tick leave the last one in sequence
+//      order in effect), so the map grows with the number of tempo
+//      changes rather than the number of events.  Only the tempo
+//      messages are collected and sorted; the tracks are not joined,
+//      sorted or otherwise modified apart from MidiEvent::seconds, which
+//      is set for each track separately (see setThreadCount()).  If
+//      SMPTE time code is used, then ticks are actually time values, and
+//      the default tempo is kept for the whole file (1000 ticks per
+//      second SMPTE is the only mode tested (25 frames per second and 40
+//      subframes per frame).
+//
+//      With a positive fromTick and a valid time map, only the segments
+//      from that tick onwards are rebuilt, and only events at or after
+//      it get new times (see invalidateTimeMap()).
+//
+//      If given, trackTask is called with the index of each track after
+//      its times have been set, on the thread that set them.
+//
+
+void MidiFile::buildTimeMap(int fromTick,
+		const std::function<void(int)>& trackTask) {
+	loadAllTracks();
+	bool delta = isDeltaTicks();
+	bool full = (fromTick <= 0) || delta || (m_timemapvalid == 0)
+			|| m_timemap.empty();
+	if (full) {
+		fromTick = INT_MIN;
 	}
-	if (seconds > m_timemap[m_timemap.size()-1].seconds) {
-		return -1.0;
+	int tpq = getTicksPerQuarterNote();
+	int tracks = getNumTracks();
+
+	// first event of each track that can be at or after fromTick:
+	std::vector<int> starts(tracks, 0);
+	if (!full) {
+		for (int i=0; i<tracks; i++) {
+			starts[i] = getTrackUpdateStart(i, fromTick);
+		}
 	}
 
-	// Guess which side of the list is closest to target:
-	// Could do a more efficient algorithm since time values are sorted,
-	// but good enough for now...
-	int startindex = -1;
-	if (seconds < lasttime / 2) {
-		for (i=0; i<(int)m_timemap.size(); i++) {
-			if (m_timemap[i].seconds > seconds) {
-				startindex = i-1;
-				break;
-			} else if (m_timemap[i].seconds == seconds) {
-				startindex = i;
-				break;
+	// collect the tempo messages of all tracks in file order:
+	struct TempoChange {
+		int    tick;
+		int    seq;
+		double secondsPerTick;
+		int    microseconds;
+	};
+	std::vector<TempoChange> tempos;
+	for (int i=0; i<tracks; i++) {
+		const MidiEventList& list = *m_events[i];
+		int tick = 0;
+		for (int j=starts[i]; j<list.size(); j++) {
+			const MidiEvent& event = list[j];
+			tick = delta ? tick + event.tick : event.tick;
+			if ((tick >= fromTick) && event.isTempo()) {
+				tempos.push_back({tick, event.seq, event.getTempoSPT(tpq),
+						event.getTempoMicroseconds()});
 			}
 		}
+	}
+	std::stable_sort(tempos.begin(), tempos.end(),
+			[](const TempoChange& a, const TempoChange& b) {
+				return (a.tick < b.tick) || ((a.tick == b.tick) && (a.seq < b.seq));
+			});
+
+	_TempoSegment segment;
+	if (full) {
+		m_timemap.clear();
+		double defaultTempo = 120.0;
+		segment.tick = 0;
+		segment.seconds = 0.0;
+		segment.secondsPerTick = 60.0 / (defaultTempo * tpq);
+		segment.scaledNanoseconds = 0;
+		segment.microsecondsPerQuarter = (int)(60000000.0 / defaultTempo);
+		m_timemap.push_back(segment);
 	} else {
-		for (i=(int)m_timemap.size()-1; i>0; i--) {
-			if (m_timemap[i].seconds < seconds) {
-				startindex = i+1;
-				break;
-			} else if (m_timemap[i].seconds == seconds) {
-				startindex = i;
-				break;
-			}
+		// keep the segments that start before fromTick (always including
+		// the first one, which starts at tick 0):
+		m_timemap.erase(m_timemap.begin() + (&getTempoSegmentAtTick(fromTick - 1)
+				- m_timemap.data()) + 1, m_timemap.end());
+	}
+	for (const TempoChange& tempo : tempos) {
+		_TempoSegment& current = m_timemap.back();
+		if (tempo.tick == current.tick) {
+			current.secondsPerTick = tempo.secondsPerTick;
+			current.microsecondsPerQuarter = tempo.microseconds;
+			continue;
 		}
+		segment.tick = tempo.tick;
+		segment.seconds = current.seconds
+				+ (tempo.tick - current.tick) * current.secondsPerTick;
+		segment.secondsPerTick = tempo.secondsPerTick;
+		segment.scaledNanoseconds = current.scaledNanoseconds
+				+ (int64_t)(tempo.tick - current.tick) * current.microsecondsPerQuarter * 1000;
+		segment.microsecondsPerQuarter = tempo.microseconds;
+		m_timemap.push_back(segment);
 	}
-
-	if (startindex < 0) {
-		return -1.0;
-	}
-	if (startindex >= (int)m_timemap.size()-1) {
-		return -1.0;
+	m_timemapvalid = 1;
+	m_timemapdirty = false;
+
+	std::vector<int> sortedSizes(tracks);
+	WorkerPool::run(tracks, m_threadCount, [&](int i) {
+		bool sorted = setTrackSeconds(*m_events[i], delta, fromTick, starts[i]);
+		sortedSizes[i] = sorted ? m_events[i]->size() : -1;
+		if (trackTask) {
+			trackTask(i);
+		}
+	});
+	m_timemapTracks.resize(tracks);
+	for (int i=0; i<tracks; i++) {
+		m_timemapTracks[i] = std::make_pair(m_events[i], sortedSizes[i]);
 	}
+}
+
 
-	double x1 = m_timemap[startindex].seconds;
-	double x2 = m_timemap[startindex+1].seconds;
-	double y1 = m_timemap[startindex].tick;
-	double y2 = m_timemap[startindex+1].tick;
-	double xi = seconds;
 
-	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+//////////////////////////////
+//
+// MidiFile::linkTracks -- link the note pairs of all tracks, each one
+//     separately (see setThreadCount()).  Returns the total number of
+//     note pairs that were linked.
+//
+
+int MidiFile::linkTracks(bool lifo) {
+	loadAllTracks();
+	int tracks = getTrackCount();
+	std::vector<int> counts(tracks, 0);
+	WorkerPool::run(tracks, m_threadCount, [&](int i) {
+		if (m_events[i] != NULL) {
+			counts[i] = m_events[i]->linkPairs(lifo, true);
+		}
+	});
+	m_linkedEventsQ = true;
+	return std::accumulate(counts.begin(), counts.end(), 0);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::linearSecondInterpolationAtTick -- return the time in seconds
-//    value at the given input tick time. (Ticks input could be made double).
+// MidiFile::getTrackUpdateStart -- return the index of the first event
+//     of a track that an update from fromTick has to look at.  If the
+//     track was sorted by tick when the time map was last built, the
+//     events it had then are still sorted (edits that reorder them must
+//     be followed by sortTracks() or doTimeAnalysis()), so the index is
+//     found with a binary search; events appended since then come after
+//     them.  Otherwise the whole track has to be scanned.
 //
 
-double MidiFile::linearSecondInterpolationAtTick(int ticktime) {
-	if (m_timemapvalid == 0) {
-		buildTimeMap();
-		if (m_timemapvalid == 0) {
-			return -1.0;    // something went wrong
-		}
+int MidiFile::getTrackUpdateStart(int track, int fromTick) const {
+	if (track >= (int)m_timemapTracks.size()) {
+		return 0;
 	}
-
-	int i;
-	double lasttick = m_timemap[m_timemap.size()-1].tick;
-	// give an error value of -1 if time is out of range of data.
-	if (ticktime < 0.0) {
-		return -1;
+	const MidiEventList& list = *m_events[track];
+	const std::pair<const MidiEventList*, int>& known = m_timemapTracks[track];
+	if ((known.first != &list) || (known.second < 0)
+			|| (known.second > list.size())) {
+		return 0;
 	}
-	if (ticktime > m_timemap.back().tick) {
-		return -1;  // don't try to extrapolate
+	int low = 0;
+	int high = known.second;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (list[middle].tick < fromTick) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
 	}
+	return low;
+}
 
-	// Guess which side of the list is closest to target:
-	// Could do a more efficient algorithm since time values are sorted,
-	// but good enough for now...
-	int startindex = -1;
-	if (ticktime < lasttick / 2) {
-		for (i=0; i<(int)m_timemap.size(); i++) {
-			if (m_timemap[i].tick > ticktime) {
-				startindex = i-1;
-				break;
-			} else if (m_timemap[i].tick == ticktime) {
-				startindex = i;
-				break;
-			}
+
+
+//////////////////////////////
+//
+// MidiFile::setTrackSeconds -- set MidiEvent::seconds for the events of
+//     a track at or after fromTick from the time map, looking at the
+//     events from index start onwards.  The tempo segment is carried from
+//     one event to the next, so a sorted track is handled in a single
+//     pass.  Returns true if the events from start onwards are sorted by
+//     tick and none of them comes before the event at start-1.
+//
+
+bool MidiFile::setTrackSeconds(MidiEventList& list, bool delta,
+		int fromTick, int start) const {
+	const _TempoSegment* segments = m_timemap.data();
+	int count = (int)m_timemap.size();
+	int k = 0;
+	int tick = 0;
+	int lasttick = start > 0 ? list[start-1].tick : INT_MIN;
+	bool sorted = true;
+	for (int i=start; i<list.size(); i++) {
+		MidiEvent& event = list[i];
+		tick = delta ? tick + event.tick : event.tick;
+		sorted = sorted && (tick >= lasttick);
+		lasttick = tick;
+		if (tick < fromTick) {
+			continue;
 		}
-	} else {
-		for (i=(int)m_timemap.size()-1; i>0; i--) {
-			if (m_timemap[i].tick < ticktime) {
-				startindex = i;
-				break;
-			} else if (m_timemap[i].tick == ticktime) {
-				startindex = i;
-				break;
-			}
+		if (tick < segments[k].tick) {
+			k = (int)(&getTempoSegmentAtTick(tick) - segments);
+		}
+		while ((k + 1 < count) && (tick >= segments[k+1].tick)) {
+			k++;
 		}
+		event.seconds = segments[k].seconds
+				+ (tick - segments[k].tick) * segments[k].secondsPerTick;
 	}
+	return sorted;
+}
 
-	if (startindex < 0) {
-		return -1;
-	}
-	if (startindex >= (int)m_timemap.size()-1) {
-		return -1;
-	}
 
-	if (m_timemap[startindex].tick == ticktime) {
-		return m_timemap[startindex].seconds;
-	}
 
-	double x1 = m_timemap[startindex].tick;
-	double x2 = m_timemap[startindex+1].tick;
-	double y1 = m_timemap[startindex].seconds;
-	double y2 = m_timemap[startindex+1].seconds;
-	double xi = ticktime;
+//////////////////////////////
+//
+// MidiFile::getTempoSegmentAtTick -- return the last tempo segment that
+//     starts at or before the given tick (the first one for ticks before
+//     it).  The time map must be valid.
+//
 
-	return (xi-x1) * ((y2-y1)/(x2-x1)) + y1;
+const _TempoSegment& MidiFile::getTempoSegmentAtTick(int tick) const {
+	auto found = std::upper_bound(m_timemap.begin() + 1, m_timemap.end(), tick,
+			[](int value, const _TempoSegment& segment) {
+				return value < segment.tick;
+			});
+	return *(found - 1);
 }
 
 
 
 //////////////////////////////
 //
-// MidiFile::buildTimeMap -- build an index of the absolute tick values
-//      found in a MIDI file, and their corresponding time values in
-//      seconds, taking into consideration tempo change messages.  If no
-//      tempo messages are given (or until they are given, then the
-//      tempo is set to 120 beats per minute).  If SMPTE time code is
-//      used, then ticks are actually time values.  So don't build
-//      a time map for SMPTE ticks, and just calculate the time in
-//      seconds from the tick value (1000 ticks per second SMPTE
-//      is the only mode tested (25 frames per second and 40 subframes
-//      per frame).
+// MidiFile::getTempoSegmentAtSecond -- return the last tempo segment that
+//     starts at or before the given time in seconds.  The time map must
+//     be valid.
 //
 
-void MidiFile::buildTimeMap(void) {
-
-	// convert the MIDI file to absolute time representation
-	// in single track mode (and undo if the MIDI file was not
-	// in that state when this function was called.
-	//
-	int trackstate = getTrackState();
-	int timestate  = getTickState();
-
-	makeAbsoluteTicks();
-	joinTracks();
-
-	int allocsize = getNumEvents(0);
-	m_timemap.reserve(allocsize+10);
-	m_timemap.clear();
+const _TempoSegment& MidiFile::getTempoSegmentAtSecond(double seconds) const {
+	auto found = std::upper_bound(m_timemap.begin() + 1, m_timemap.end(), seconds,
+			[](double value, const _TempoSegment& segment) {
+				return value < segment.seconds;
+			});
+	return *(found - 1);
+}
 
-	_TickTime value;
 
-	int lasttick = 0;
-	int tickinit = 0;
 
-	int i;
-	int tpq = getTicksPerQuarterNote();
-	double defaultTempo = 120.0;
-	double secondsPerTick = 60.0 / (defaultTempo * tpq);
+//////////////////////////////
+//
+// MidiFile::getSegmentNanoseconds -- return the time of a tick inside a
+//     tempo segment in nanoseconds, rounded to the nearest nanosecond.
+//
 
-	double lastsec = 0.0;
-	double cursec = 0.0;
+int64_t MidiFile::getSegmentNanoseconds(const _TempoSegment& segment,
+		int tick) const {
+	int64_t tpq = std::max(1, getTicksPerQuarterNote());
+	int64_t scaled = segment.scaledNanoseconds
+			+ (int64_t)(tick - segment.tick) * segment.microsecondsPerQuarter * 1000;
+	return (scaled + tpq / 2) / tpq;
+}
 
-	for (i=0; i<getNumEvents(0); i++) {
-		int curtick = getEvent(0, i).tick;
-		getEvent(0, i).seconds = cursec;
-		if ((curtick > lasttick) || !tickinit) {
-			tickinit = 1;
 
-			// calculate the current time in seconds:
-			cursec = lastsec + (curtick - lasttick) * secondsPerTick;
-			getEvent(0, i).seconds = cursec;
 
-			// store the new tick to second mapping
-			value.tick = curtick;
-			value.seconds = cursec;
-			m_timemap.push_back(value);
-			lasttick   = curtick;
-			lastsec    = cursec;
-		}
+//////////////////////////////
+//
+// MidiFile::checkChunkId -- Verify that the four-character chunk ID
+//    (such as "MThd" or "MTrk") is found at the given offset of in-memory
+//    MIDI data.  Prints the same diagnostics as the stream reader.
+//
 
-		// update the tempo if needed:
-		if (getEvent(0,i).isTempo()) {
-			secondsPerTick = getEvent(0,i).getTempoSPT(getTicksPerQuarterNote());
+bool MidiFile::checkChunkId(std::span<const uchar> data, size_t offset,
+		const char* chunkId, const std::string& filename, const char* location) {
+	static const char* ordinals[4] = {"first", "second", "third", "fourth"};
+	for (int i=0; i<4; i++) {
+		if (offset + i >= data.size()) {
+			std::cerr << "In file " << filename << ": unexpected end of file." << std::endl;
+			std::cerr << "Expecting '" << chunkId[i] << "' at " << ordinals[i]
+			     << " byte" << location << ", but found nothing." << std::endl;
+			return false;
+		} else if (data[offset + i] != (uchar)chunkId[i]) {
+			std::cerr << "File " << filename << " is not a MIDI file" << std::endl;
+			std::cerr << "Expecting '" << chunkId[i] << "' at " << ordinals[i]
+			     << " byte" << location << " but got '"
+			     << (char)data[offset + i] << "'" << std::endl;
+			return false;
 		}
 	}
-
-	// reset the states of the tracks or time values if necessary here:
-	if (timestate == TIME_STATE_DELTA) {
-		deltaTicks();
-	}
-	if (trackstate == TRACK_STATE_SPLIT) {
-		splitTracks();
-	}
-
-	m_timemapvalid = 1;
-
+	return true;
 }
 
 
@@ -3086,50 +4100,15 @@ void MidiFile::clear_no_deallocate(void) {
 	}
 	m_events.resize(1);
 	m_events[0] = new MidiEventList;
+	clearLazyTracks();
 	m_timemapvalid=0;
 	m_timemap.clear();
+	m_timemapTracks.clear();
 	// m_events.resize(0);   // causes a memory leak [20150205 Jorden Thatcher]
 }
 
 
 
-//////////////////////////////
-//
-// MidiFile::ticksearch -- for finding a tick entry in the time map.
-//
-
-int MidiFile::ticksearch(const void* A, const void* B) {
-	_TickTime& a = *((_TickTime*)A);
-	_TickTime& b = *((_TickTime*)B);
-
-	if (a.tick < b.tick) {
-		return -1;
-	} else if (a.tick > b.tick) {
-		return 1;
-	}
-	return 0;
-}
-
-
-
-//////////////////////////////
-//
-// MidiFile::secondsearch -- for finding a second entry in the time map.
-//
-
-int MidiFile::secondsearch(const void* A, const void* B) {
-	_TickTime& a = *((_TickTime*)A);
-	_TickTime& b = *((_TickTime*)B);
-
-	if (a.seconds < b.seconds) {
-		return -1;
-	} else if (a.seconds > b.seconds) {
-		return 1;
-	}
-	return 0;
-}
-
-
 ///////////////////////////////////////////////////////////////////////////
 //
 // Static functions:
@@ -3419,60 +4398,38 @@ std::string MidiFile::getGMInstrumentName(int patchIndex) {
 
 //////////////////////////////
 //
-// MidiFile::base64Encode -- Encode a string as base64.
+// MidiFile::encodeBase64 -- Store the Standard MIDI File data encoded as
+//    base64 in output, with a line break after every width characters if
+//    width is positive (see writeBase64()).
 //
 
-std::string MidiFile::base64Encode(const std::string& input) {
-	std::string output;
-	output.reserve(((input.size()/3) + (input.size() % 3 > 0)) * 4);
-	int vala = 0;
-	int valb = -6;
-	for (uchar c : input) {
-		vala = (vala << 8) + c;
-		valb += 8;
-		while (valb >=0) {
-			output.push_back(MidiFile::encodeLookup[(vala >> valb) & 0x3F]);
-			valb -= 6;
-		}
-	}
-	if (valb > -6) {
-		output.push_back(MidiFile::encodeLookup[((vala << 8) >> (valb + 8)) & 0x3F]);
+bool MidiFile::encodeBase64(std::string& output, int width) {
+	std::stringstream raw;
+	bool status = MidiFile::write(raw);
+	if (!status) {
+		return status;
 	}
-	while (output.size() % 4) {
-		output.push_back(MidiFile::encodeLookup.back());
+	std::string_view data = raw.view();
+	std::span<const uchar> bytes((const uchar*)data.data(), data.size());
+	if (width <= 0) {
+		Base64::encode(bytes, output);
+		return status;
 	}
-	return output;
-}
-
-
-
-//////////////////////////////
-//
-// MidiFile::base64Decode -- Decode a base64 string.
-//
-
-std::string MidiFile::base64Decode(const std::string& input) {
-	// vector<int> decodeLookup(256,-1);
-	// for (int i=0; i<64; i++) decodeLookup[encodeLookup[i]] = i;
 
-	std::string output;
-	int vala = 0;
-	int valb = -8;
-	for (uchar c : input) {
-		if (c == '=') {
-			break;
-		} else if (MidiFile::decodeLookup[c] == -1) {
-         // Ignore whitespace, for example.
-			continue;
-		}
-		vala = (vala << 6) + MidiFile::decodeLookup[c];
-		valb += 6;
-		if (valb >= 0) {
-			output.push_back(char((vala >> valb) & 0xFF));
-			valb -= 8;
+	std::string encoded;
+	Base64::encode(bytes, encoded);
+	size_t length = encoded.size();
+	output.reserve(output.size() + length + length / width + 2);
+	for (size_t i=0; i<length; i+=width) {
+		output.append(encoded, i, width);
+		if (i + width <= length) {
+			output.push_back('\n');
 		}
 	}
-	return output;
+	if ((length + 1) % width != 0) {
+		output.push_back('\n');
+	}
+	return status;
 }
 
 
@@ -15,15 +15,24 @@
 #define _MIDIFILE_H_INCLUDED
 
 #include "MidiEventList.h"
+#include "NoteSpan.h"
 
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <istream>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 
 namespace smf {
 
+class MappedFile;
+
 enum {
     TRACK_STATE_SPLIT  = 0, // Tracks are separated into separate vector postions.
     TRACK_STATE_JOINED = 1  // Tracks are merged into a single vector position,
@@ -34,10 +43,17 @@ enum {
     TIME_STATE_ABSOLUTE = 1  // MidiMessage::ticks are in absolute time format (0=start time).
 };
 
-class _TickTime {
+// _TempoSegment == a span of ticks with a constant tempo, starting at
+// the given tick and time in seconds and lasting until the start of the
+// next segment.  The start time is also kept exactly as an integer
+// number of nanoseconds multiplied by the ticks per quarter note.
+class _TempoSegment {
 	public:
-		int    tick;
-		double seconds;
+		int     tick;
+		double  seconds;
+		double  secondsPerTick;
+		int64_t scaledNanoseconds;
+		int     microsecondsPerQuarter;
 };
 
 
@@ -59,12 +75,14 @@ class MidiFile {
 		// Auto-detected SMF or ASCII-encoded SMF (decoded with Binasc class):
 		bool           read                        (const std::string& filename);
 		bool           read                        (std::istream& instream);
+		bool           read                        (std::span<const uchar> data);
 		bool           readBase64                  (const std::string& base64data);
 		bool           readBase64                  (std::istream& instream);
 
 		// Only allow Standard MIDI File input:
 		bool           readSmf                     (const std::string& filename);
 		bool           readSmf                     (std::istream& instream);
+		bool           readSmf                     (std::span<const uchar> data);
 
 		bool           write                       (const std::string& filename);
 		bool           write                       (std::ostream& out);
@@ -133,11 +151,29 @@ class MidiFile {
 		void             setTicksPerQuarterNote    (int ticks);
 		void             setTPQ                    (int ticks);
 
+		// multi-threading functions:
+		void             setThreadCount            (int count);
+		int              getThreadCount            (void) const;
+
+		// lazy track loading functions:
+		void             setLazyLoading            (bool state = true);
+		bool             getLazyLoading            (void) const;
+		bool             isTrackLoaded             (int aTrack) const;
+
 		// physical-time analysis functions:
 		void             doTimeAnalysis            (void);
 		double           getTimeInSeconds          (int aTrack, int anIndex);
 		double           getTimeInSeconds          (int tickvalue);
 		double           getAbsoluteTickTime       (double starttime);
+		int              getTempoSegmentCount      (void);
+		void             invalidateTimeMap         (int tick = 0);
+		void             getTimesInSeconds         (std::span<const int> ticks,
+		                                            std::vector<double>& seconds);
+		void             getAbsoluteTickTimes      (std::span<const double> seconds,
+		                                            std::vector<double>& ticks);
+		int64_t          getTimeInNanoseconds      (int tickvalue);
+		void             getTimesInNanoseconds     (std::span<const int> ticks,
+		                                            std::vector<int64_t>& nanoseconds);
 		int              getFileDurationInTicks    (void);
 		double           getFileDurationInQuarters (void);
 		double           getFileDurationInSeconds  (void);
@@ -147,6 +183,8 @@ class MidiFile {
 		int              linkNotePairsLIFO         (void);
 		int              linkNotePairs             (void) { return linkNotePairsFIFO(); }
 		int              linkEventPairs            (void);
+		int              doTimeAnalysisAndLinkNotePairs(void);
+		int              getNoteSpans              (std::vector<NoteSpan>& notes);
 		void             clearLinks                (void);
 
 		// filename functions:
@@ -155,9 +193,11 @@ class MidiFile {
 
 		// event functionality:
 		MidiEvent*       addEvent                  (int aTrack, int aTick,
-		                                            std::vector<uchar>& midiData);
+		                                            const std::vector<uchar>& midiData);
 		MidiEvent*       addEvent                  (MidiEvent& mfevent);
+		MidiEvent*       addEvent                  (MidiEvent&& mfevent);
 		MidiEvent*       addEvent                  (int aTrack, MidiEvent& mfevent);
+		MidiEvent*       addEvent                  (int aTrack, MidiEvent&& mfevent);
 		MidiEvent&       getEvent                  (int aTrack, int anIndex);
 		const MidiEvent& getEvent                  (int aTrack, int anIndex) const;
 		int              getEventCount             (int aTrack) const;
@@ -292,39 +332,95 @@ class MidiFile {
 		// the object.
 		std::string m_readFileName;
 
-		// m_timemapvalid ==
+		// m_timemapvalid == true if m_timemap matches the tempo events.
 		bool m_timemapvalid = false;
 
-		// m_timemap ==
-		std::vector<_TickTime> m_timemap;
+		// m_timemapdirty == true if events were added or changed at or
+		// after m_timemapDirtyTick since the time map was built.
+		bool m_timemapdirty = false;
+		int  m_timemapDirtyTick = 0;
+
+		// m_timemapTracks == for each track, its event list and its size
+		// when the time map was last built, or a size of -1 if the track
+		// was not sorted by tick then.  Lets updates skip the unchanged
+		// part of sorted tracks.  Cleared by every function that adds,
+		// removes or replaces track lists, since a new list may be
+		// allocated at the address of a deleted one.
+		std::vector<std::pair<const MidiEventList*, int>> m_timemapTracks;
+
+		// m_timemap == tempo segments in tick order, one for the start of
+		// the file and one for each tick where the tempo changes.
+		std::vector<_TempoSegment> m_timemap;
 
 		// m_rwstatus == True if last read was successful, false if a problem.
-		bool m_rwstatus = true;
+		// Mutable since a lazily loaded track can fail to decode on access.
+		mutable bool m_rwstatus = true;
 
 		// m_linkedEventQ == True if link analysis has been done.
 		bool m_linkedEventsQ = false;
 
+		// m_threadCount == Number of threads used for per-track work such
+		// as decoding tracks when reading.  1 means single-threaded and
+		// 0 means one thread for each hardware thread.
+		int m_threadCount = 1;
+
+		// m_lazyLoading == True if tracks are decoded when first accessed
+		// rather than when the file is read (see setLazyLoading()).
+		bool m_lazyLoading = false;
+
+		// m_lazyData == Contents of the last file read, kept while some
+		// of its tracks have not been decoded yet.
+		mutable std::shared_ptr<MappedFile> m_lazyData;
+
+		// m_lazyOffsets == For each track, the offset in m_lazyData of its
+		// undecoded event data, or 0 if the track is already loaded.
+		mutable std::vector<size_t> m_lazyOffsets;
+
+		// m_lazyCount == Number of tracks that are not decoded yet.
+		mutable int m_lazyCount = 0;
+
 	private:
 		int         extractMidiData                 (std::istream& inputfile,
 		                                             std::vector<uchar>& array,
 		                                             uchar& runningCommand);
 		ulong       readVLValue                     (std::istream& inputfile);
+		bool        readSmf                         (std::span<const uchar> data,
+		                                             std::shared_ptr<MappedFile> storage);
+		bool        readBinasc                      (std::string_view text);
+		int         readTracksInParallel            (std::span<const uchar> data,
+		                                             int tracks, size_t& offset);
+		bool        indexTracks                     (std::span<const uchar> data,
+		                                             int tracks, size_t offset);
+		void        loadTrack                       (int aTrack) const;
+		void        loadAllTracks                   (void) const;
+		void        clearLazyTracks                 (void);
+		static bool checkChunkId                    (std::span<const uchar> data,
+		                                             size_t offset,
+		                                             const char* chunkId,
+		                                             const std::string& filename,
+		                                             const char* location);
 		ulong       unpackVLV                       (uchar a = 0, uchar b = 0,
 		                                             uchar c = 0, uchar d = 0,
 		                                             uchar e = 0);
 		void        writeVLValue                    (long aValue,
 		                                             std::vector<uchar>& data);
 		int         makeVLV                         (uchar *buffer, int number);
-		static int  ticksearch                      (const void* A, const void* B);
-		static int  secondsearch                    (const void* A, const void* B);
-		void        buildTimeMap                    (void);
-		double      linearTickInterpolationAtSecond (double seconds);
-		double      linearSecondInterpolationAtTick (int ticktime);
-		std::string base64Encode                    (const std::string &input);
-		std::string base64Decode                    (const std::string &input);
-
-		static const std::string encodeLookup;
-		static const std::vector<int> decodeLookup;
+		bool        updateTimeMap                   (void);
+		void        buildTimeMap                    (int fromTick = 0,
+		                                             const std::function<void(int)>&
+		                                             trackTask = nullptr);
+		int         linkTracks                      (bool lifo);
+		int         getTrackUpdateStart             (int track,
+		                                             int fromTick) const;
+		bool        setTrackSeconds                 (MidiEventList& list,
+		                                             bool delta, int fromTick,
+		                                             int start) const;
+		const _TempoSegment& getTempoSegmentAtTick  (int tick) const;
+		const _TempoSegment& getTempoSegmentAtSecond(double seconds) const;
+		int64_t     getSegmentNanoseconds           (const _TempoSegment& segment,
+		                                             int tick) const;
+		bool        encodeBase64                    (std::string& output, int width);
+
 		static const char *GMinstrument[128];
 };
 
@@ -27,45 +27,51 @@ namespace smf {
 // MidiMessage::MidiMessage -- Constructor.
 //
 
-MidiMessage::MidiMessage(void) : vector<uchar>() {
+MidiMessage::MidiMessage(void) : SmallByteVector() {
 	// do nothing
 }
 
 
-MidiMessage::MidiMessage(int command) : vector<uchar>(1, (uchar)command) {
+MidiMessage::MidiMessage(int command) : SmallByteVector(1, (uchar)command) {
 	// do nothing
 }
 
 
-MidiMessage::MidiMessage(int command, int p1) : vector<uchar>(2) {
+MidiMessage::MidiMessage(int command, int p1) : SmallByteVector(2) {
 	(*this)[0] = (uchar)command;
 	(*this)[1] = (uchar)p1;
 }
 
 
-MidiMessage::MidiMessage(int command, int p1, int p2) : vector<uchar>(3) {
+MidiMessage::MidiMessage(int command, int p1, int p2) : SmallByteVector(3) {
 	(*this)[0] = (uchar)command;
 	(*this)[1] = (uchar)p1;
 	(*this)[2] = (uchar)p2;
 }
 
 
-MidiMessage::MidiMessage(const MidiMessage& message) : vector<uchar>() {
-	(*this) = message;
+MidiMessage::MidiMessage(const MidiMessage& message) : SmallByteVector(message) {
+	// do nothing
+}
+
+
+MidiMessage::MidiMessage(MidiMessage&& message) noexcept
+		: SmallByteVector(std::move(message)) {
+	// do nothing
 }
 
 
-MidiMessage::MidiMessage(const std::vector<uchar>& message) : vector<uchar>() {
+MidiMessage::MidiMessage(const std::vector<uchar>& message) : SmallByteVector() {
 	setMessage(message);
 }
 
 
-MidiMessage::MidiMessage(const std::vector<char>& message) : vector<uchar>() {
+MidiMessage::MidiMessage(const std::vector<char>& message) : SmallByteVector() {
 	setMessage(message);
 }
 
 
-MidiMessage::MidiMessage(const std::vector<int>& message) : vector<uchar>() {
+MidiMessage::MidiMessage(const std::vector<int>& message) : SmallByteVector() {
 	setMessage(message);
 }
 
@@ -91,15 +97,18 @@ MidiMessage& MidiMessage::operator=(const MidiMessage& message) {
 	if (this == &message) {
 		return *this;
 	}
-	std::vector<uchar>::operator=(static_cast<const std::vector<uchar> &>(message));
+	SmallByteVector::operator=(message);
+	return *this;
+}
+
+
+MidiMessage& MidiMessage::operator=(MidiMessage&& message) noexcept {
+	SmallByteVector::operator=(std::move(message));
 	return *this;
 }
 
 
 MidiMessage& MidiMessage::operator=(const std::vector<uchar>& bytes) {
-	if (this == &bytes) {
-		return *this;
-	}
 	setMessage(bytes);
 	return *this;
 }
@@ -316,7 +325,7 @@ bool MidiMessage::isMetaMessage(void) const {
 
 bool MidiMessage::isNoteOff(void) const {
 	const MidiMessage& message = *this;
-	const vector<uchar>& chars = message;
+	const uchar* chars = message.data();
 	if (message.size() != 3) {
 		return false;
 	} else if ((chars[0] & 0xf0) == 0x80) {
@@ -1203,10 +1212,7 @@ void MidiMessage::setParameters(int p1, int p2) {
 //
 
 void MidiMessage::setMessage(const std::vector<uchar>& message) {
-	this->resize(message.size());
-	for (int i=0; i<(int)this->size(); i++) {
-		(*this)[i] = message[i];
-	}
+	this->assign(message.begin(), message.end());
 }
 
 
@@ -1226,6 +1232,11 @@ void MidiMessage::setMessage(const std::vector<int>& message) {
 }
 
 
+void MidiMessage::setMessage(const uchar* message, int count) {
+	this->assign(message, message + count);
+}
+
+
 
 //////////////////////////////
 //
@@ -2067,6 +2078,23 @@ void MidiMessage::makeSysExMessage(const std::vector<uchar>& data) {
 
 
 
+//////////////////////////////
+//
+// MidiMessage::getChannelMessageSize -- Number of bytes in a channel
+//     message with the given command byte (status and data bytes), or 0
+//     if it is not a channel message.
+//
+
+int MidiMessage::getChannelMessageSize(int status) {
+	static const uchar sizes[16] = {
+		0, 0, 0, 0, 0, 0, 0, 0,    // 0x00-0x7f: data bytes
+		3, 3, 3, 3, 2, 2, 3, 0     // 0x80-0xff
+	};
+	return sizes[(status >> 4) & 0x0f];
+}
+
+
+
 //////////////////////////////
 //
 // MidiMessage::frequencyToSemitones -- convert from frequency in Hertz to
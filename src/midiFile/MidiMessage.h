@@ -14,6 +14,8 @@
 #ifndef _MIDIMESSAGE_H_INCLUDED
 #define _MIDIMESSAGE_H_INCLUDED
 
+#include "SmallByteVector.h"
+
 #include <iostream>
 #include <string>
 #include <utility>
@@ -22,11 +24,10 @@
 
 namespace smf {
 
-typedef unsigned char  uchar;
 typedef unsigned short ushort;
 typedef unsigned long  ulong;
 
-class MidiMessage : public std::vector<uchar> {
+class MidiMessage : public SmallByteVector {
 
 	public:
 		               MidiMessage          (void);
@@ -34,6 +35,7 @@ class MidiMessage : public std::vector<uchar> {
 		               MidiMessage          (int command, int p1);
 		               MidiMessage          (int command, int p1, int p2);
 		               MidiMessage          (const MidiMessage& message);
+		               MidiMessage          (MidiMessage&& message) noexcept;
 		               MidiMessage          (const std::vector<uchar>& message);
 		               MidiMessage          (const std::vector<char>& message);
 		               MidiMessage          (const std::vector<int>& message);
@@ -41,6 +43,7 @@ class MidiMessage : public std::vector<uchar> {
 		              ~MidiMessage          ();
 
 		MidiMessage&   operator=            (const MidiMessage& message);
+		MidiMessage&   operator=            (MidiMessage&& message) noexcept;
 		MidiMessage&   operator=            (const std::vector<uchar>& bytes);
 		MidiMessage&   operator=            (const std::vector<char>& bytes);
 		MidiMessage&   operator=            (const std::vector<int>& bytes);
@@ -50,6 +53,7 @@ class MidiMessage : public std::vector<uchar> {
 
 		static std::vector<uchar> intToVlv  (int value);
 		static double  frequencyToSemitones (double frequency, double a4frequency = 440.0);
+		static int     getChannelMessageSize(int status);
 
 		// data access convenience functions (returns -1 if not present):
 		int            getP0                (void) const;
@@ -95,6 +99,7 @@ class MidiMessage : public std::vector<uchar> {
 		void           setMessage           (const std::vector<uchar>& message);
 		void           setMessage           (const std::vector<char>& message);
 		void           setMessage           (const std::vector<int>& message);
+		void           setMessage           (const uchar* message, int count);
 
 		// message-type convenience functions:
 		bool           isMetaMessage        (void) const;
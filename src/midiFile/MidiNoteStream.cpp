@@ -0,0 +1,458 @@
+//
+// Creation Date: Sat Oct 17 15:21:40 PDT 2026
+// Filename:      midifile/src/MidiNoteStream.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Pull-style reader that returns the notes of a Standard
+//                MIDI File in onset order while the file is being
+//                decoded, without building a MidiFile.
+//
+
+#include "MidiNoteStream.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// MidiNoteStream::MidiNoteStream -- Constructor.  If a filename is given,
+//    the file is opened (check status() for success).
+//
+
+MidiNoteStream::MidiNoteStream(void) {
+	// do nothing
+}
+
+
+MidiNoteStream::MidiNoteStream(const std::string& filename) {
+	open(filename);
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::open -- Prepare to read notes from a Standard MIDI File.
+//    Only the file header and the MTrk chunk boundaries are examined here;
+//    events are decoded as notes are requested with next().  When given a
+//    byte range, the data must stay valid until the stream is reopened or
+//    destroyed.  Returns false if the data is not a readable MIDI file.
+//
+
+bool MidiNoteStream::open(const std::string& filename) {
+	reset();
+	if (!m_file.open(filename)) {
+		return false;
+	}
+	return prepare(m_file.span());
+}
+
+
+bool MidiNoteStream::open(std::span<const uchar> data) {
+	reset();
+	return prepare(data);
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::next -- Get the next note in onset order (ties are in
+//    track order, then in file order).  Events are decoded only as far as
+//    needed to find the note-off of the returned note, or until more than
+//    getLookahead() later notes are waiting behind it.  In that case the
+//    note is returned while still sounding: "truncated" is true,
+//    "terminated" is false and the duration ends at the last decoded
+//    event; its note-off is consumed without effect when it is reached.  Note-ons that are never turned
+//    off last until the end-of-track message of their track and also have
+//    "terminated" set to false.  Returns false when there are no more
+//    notes or if a decoding error occurred (see status()).
+//
+
+bool MidiNoteStream::next(NoteSpan& note) {
+	while (m_status) {
+		if (!m_pending.empty() && (m_pending.front().closed
+				|| (int)m_pending.size() > m_lookahead)) {
+			note = m_pending.front().note;
+			if (!m_pending.front().closed) {
+				note.duration     = m_lastSeconds - note.seconds;
+				note.nanoDuration = getLastNanoseconds() - note.nanoseconds;
+				note.tickDuration = m_lastTick - note.tick;
+				note.truncated    = true;
+				ActiveKey& active = m_active[getActiveIndex(note.track,
+						note.channel, note.key)];
+				active.serials.pop_front();
+				active.returned++;
+			}
+			m_pending.pop_front();
+			m_firstSerial++;
+			return true;
+		}
+		if (!advance()) {
+			break;
+		}
+	}
+	return false;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::setLookahead -- Set the number of later notes that
+//    may wait behind a note that is still sounding before that note is
+//    returned anyway (default 1024).  This limits the memory used by the
+//    stream and the delay before next() returns.  With 0, every note is
+//    returned at its onset without a duration, and marked "truncated".
+//
+
+void MidiNoteStream::setLookahead(int count) {
+	m_lookahead = count < 0 ? 0 : count;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::getLookahead -- Returns the number of later notes that
+//    may wait behind a sounding note (see setLookahead()).
+//
+
+int MidiNoteStream::getLookahead(void) const {
+	return m_lookahead;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::status -- Returns false if the file could not be opened
+//    or an error was found while decoding it.
+//
+
+bool MidiNoteStream::status(void) const {
+	return m_status;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::getTrackCount -- Number of tracks in the file.
+//
+
+int MidiNoteStream::getTrackCount(void) const {
+	return (int)m_tracks.size();
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::getTicksPerQuarterNote -- Time resolution of the file
+//    (see MidiFile::getTicksPerQuarterNote()).
+//
+
+int MidiNoteStream::getTicksPerQuarterNote(void) const {
+	return m_ticksPerQuarterNote;
+}
+
+//
+// Alias for getTicksPerQuarterNote:
+//
+
+int MidiNoteStream::getTPQ(void) const {
+	return getTicksPerQuarterNote();
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MidiNoteStream::prepare -- Read the header and the first event of each
+//    track.
+//
+
+bool MidiNoteStream::prepare(std::span<const uchar> data) {
+	std::vector<size_t> starts;
+	if (!readHeader(data, starts)) {
+		return false;
+	}
+
+	m_tracks.reserve(starts.size());
+	for (int i=0; i<(int)starts.size(); i++) {
+		m_tracks.emplace_back(data.subspan(starts[i]), i);
+	}
+	for (int i=0; i<(int)m_tracks.size(); i++) {
+		TrackState& state = m_tracks[i];
+		if (state.decoder.next(state.event)) {
+			m_order.emplace(state.event.tick, i);
+		} else {
+			reset();
+			return false;
+		}
+	}
+
+	m_secondsPerTick = 60.0 / (120.0 * m_ticksPerQuarterNote);
+	m_status = true;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::reset -- Forget the current file.
+//
+
+void MidiNoteStream::reset(void) {
+	m_file.close();
+	m_tracks.clear();
+	m_order = decltype(m_order)();
+	m_pending.clear();
+	m_firstSerial = 0;
+	m_active.clear();
+	m_ticksPerQuarterNote = 120;
+	m_lastTick = 0;
+	m_lastSeconds = 0.0;
+	m_secondsPerTick = 0.0;
+	m_lastScaledNanoseconds = 0;
+	m_microsecondsPerQuarter = 500000;
+	m_status = false;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::readHeader -- Read the MThd chunk and find the start of
+//    the event data in each MTrk chunk.  Like MidiFile::readSmf(), the
+//    declared chunk sizes are not trusted: a size is only used if another
+//    MTrk chunk starts where it says the track ends.  Otherwise the track
+//    is scanned for its end-of-track message.
+//
+
+bool MidiNoteStream::readHeader(std::span<const uchar> data,
+		std::vector<size_t>& starts) {
+	auto isChunk = [&data](size_t offset, const char* id) {
+		if (data.size() < 8 || offset > data.size() - 8) {
+			return false;
+		}
+		for (int i=0; i<4; i++) {
+			if (data[offset+i] != (uchar)id[i]) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	if (data.size() < 14 || !isChunk(0, "MThd")) {
+		std::cerr << "Error: not a Standard MIDI File" << std::endl;
+		return false;
+	}
+	ulong length = ((ulong)data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+	if (length != 6) {
+		std::cerr << "Error: the header size is " << length << " bytes." << std::endl;
+		return false;
+	}
+	int type = (data[8] << 8) | data[9];
+	int tracks = (data[10] << 8) | data[11];
+	if (type > 1) {
+		std::cerr << "Error: cannot handle a type-" << type << " MIDI file" << std::endl;
+		return false;
+	}
+	if (type == 0 && tracks != 1) {
+		std::cerr << "Error: Type 0 MIDI file can only contain one track" << std::endl;
+		return false;
+	}
+
+	int division = (data[12] << 8) | data[13];
+	if (division >= 0x8000) {
+		int framespersecond = 255 - ((division >> 8) & 0x00ff) + 1;
+		int subframes       = division & 0x00ff;
+		m_ticksPerQuarterNote = framespersecond * subframes;
+	} else {
+		m_ticksPerQuarterNote = division;
+	}
+
+	size_t offset = 14;
+	starts.reserve(tracks);
+	for (int i=0; i<tracks; i++) {
+		if (!isChunk(offset, "MTrk")) {
+			std::cerr << "Error: missing MTrk chunk for track " << i << std::endl;
+			return false;
+		}
+		length = ((ulong)data[offset+4] << 24) | (data[offset+5] << 16)
+				| (data[offset+6] << 8) | data[offset+7];
+		offset += 8;
+		starts.push_back(offset);
+		if (i == tracks - 1) {
+			break;
+		}
+		if ((length <= data.size() - offset) && isChunk(offset + length, "MTrk")) {
+			offset += length;
+			continue;
+		}
+		MidiTrackDecoder skim(data.subspan(offset), i);
+		MidiEvent event;
+		while (skim.next(event)) { }
+		if (!skim.status()) {
+			return false;
+		}
+		offset += skim.getOffset();
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::advance -- Process the earliest undecoded event of all
+//    tracks.  Returns false when all tracks are finished or on error.
+//
+
+bool MidiNoteStream::advance(void) {
+	if (m_order.empty()) {
+		return false;
+	}
+	int track = m_order.top().second;
+	m_order.pop();
+
+	TrackState& state = m_tracks[track];
+	processEvent(state.event, track);
+	if (state.decoder.next(state.event)) {
+		m_order.emplace(state.event.tick, track);
+	} else if (!state.decoder.status()) {
+		m_status = false;
+		return false;
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::processEvent -- Update the tempo map and the note
+//    pairing state for one event.  Times in seconds are calculated in the
+//    same way as MidiFile::buildTimeMap(): a tempo change takes effect
+//    after the tick at which it occurs.  Times in nanoseconds are kept
+//    exactly with integers, as in MidiFile::getTimeInNanoseconds().
+//
+
+void MidiNoteStream::processEvent(MidiEvent& event, int track) {
+	if (event.tick > m_lastTick) {
+		m_lastSeconds += (event.tick - m_lastTick) * m_secondsPerTick;
+		m_lastScaledNanoseconds += (int64_t)(event.tick - m_lastTick)
+				* m_microsecondsPerQuarter * 1000;
+		m_lastTick = event.tick;
+	}
+	double seconds = m_lastSeconds;
+	int64_t nanoseconds = getLastNanoseconds();
+
+	if (event.isTempo()) {
+		m_secondsPerTick = event.getTempoSPT(m_ticksPerQuarterNote);
+		m_microsecondsPerQuarter = event.getTempoMicroseconds();
+	} else if (event.isNoteOn()) {
+		PendingNote pending;
+		pending.note.seconds     = seconds;
+		pending.note.nanoseconds = nanoseconds;
+		pending.note.tick        = event.tick;
+		pending.note.key         = event.getKeyNumber();
+		pending.note.velocity    = event.getVelocity();
+		pending.note.channel     = event.getChannel();
+		pending.note.track       = track;
+		m_pending.push_back(pending);
+		int index = getActiveIndex(track, pending.note.channel, pending.note.key);
+		m_active[index].serials.push_back(m_firstSerial + m_pending.size() - 1);
+	} else if (event.isNoteOff()) {
+		int index = getActiveIndex(track, event.getChannel(), event.getKeyNumber());
+		auto found = m_active.find(index);
+		if (found == m_active.end()) {
+			return;
+		}
+		ActiveKey& active = found->second;
+		if (active.returned > 0) {
+			// ends a note already returned while sounding
+			active.returned--;
+		} else if (!active.serials.empty()) {
+			size_t serial = active.serials.front();
+			active.serials.pop_front();
+			PendingNote& pending = m_pending[serial - m_firstSerial];
+			pending.note.duration     = seconds - pending.note.seconds;
+			pending.note.nanoDuration = nanoseconds - pending.note.nanoseconds;
+			pending.note.tickDuration = event.tick - pending.note.tick;
+			pending.note.terminated   = true;
+			pending.closed            = true;
+		}
+	} else if (event.isEndOfTrack()) {
+		closeTrack(track, event.tick, seconds, nanoseconds);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::closeTrack -- End all notes still sounding in a track
+//    at the time of its end-of-track message.
+//
+
+void MidiNoteStream::closeTrack(int track, int tick, double seconds,
+		int64_t nanoseconds) {
+	for (auto it = m_active.begin(); it != m_active.end(); ) {
+		if (it->first / (16 * 128) != track) {
+			it++;
+			continue;
+		}
+		for (size_t serial : it->second.serials) {
+			PendingNote& pending = m_pending[serial - m_firstSerial];
+			pending.note.duration     = seconds - pending.note.seconds;
+			pending.note.nanoDuration = nanoseconds - pending.note.nanoseconds;
+			pending.note.tickDuration = tick - pending.note.tick;
+			pending.closed            = true;
+		}
+		it = m_active.erase(it);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::getLastNanoseconds -- Time of the last processed tick
+//    in nanoseconds, rounded in the same way as
+//    MidiFile::getTimeInNanoseconds().
+//
+
+int64_t MidiNoteStream::getLastNanoseconds(void) const {
+	int64_t tpq = std::max(1, m_ticksPerQuarterNote);
+	return (m_lastScaledNanoseconds + tpq / 2) / tpq;
+}
+
+
+
+//////////////////////////////
+//
+// MidiNoteStream::getActiveIndex -- Key of m_active for a track, channel
+//    and key number.
+//
+
+int MidiNoteStream::getActiveIndex(int track, int channel, int key) {
+	return (track * 16 + channel) * 128 + key;
+}
+
+
+} // end namespace smf
+
+
+
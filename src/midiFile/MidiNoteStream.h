@@ -0,0 +1,142 @@
+//
+// Creation Date: Sat Oct 17 15:21:40 PDT 2026
+// Filename:      midifile/include/MidiNoteStream.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Pull-style reader that returns the notes of a Standard
+//                MIDI File in onset order while the file is being
+//                decoded, without building a MidiFile.  All tracks are
+//                decoded side by side, tempo changes are applied as they
+//                are reached, and a note is returned as soon as its
+//                note-off has been seen.  A note held across more than
+//                getLookahead() later notes is returned before its
+//                note-off and marked as truncated, so memory use and
+//                the delay before each note are bounded by the lookahead
+//                and the number of keys in use rather than by the size
+//                of the file.
+//
+
+#ifndef _MIDINOTESTREAM_H_INCLUDED
+#define _MIDINOTESTREAM_H_INCLUDED
+
+#include "MappedFile.h"
+#include "MidiTrackDecoder.h"
+#include "NoteSpan.h"
+
+#include <deque>
+#include <functional>
+#include <queue>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace smf {
+
+class MidiNoteStream {
+	public:
+		                MidiNoteStream          (void);
+		                MidiNoteStream          (const std::string& filename);
+		                MidiNoteStream          (const MidiNoteStream& other) = delete;
+
+		MidiNoteStream& operator=               (const MidiNoteStream& other) = delete;
+
+		bool            open                    (const std::string& filename);
+		bool            open                    (std::span<const uchar> data);
+		bool            next                    (NoteSpan& note);
+		bool            status                  (void) const;
+
+		void            setLookahead            (int count);
+		int             getLookahead            (void) const;
+
+		int             getTrackCount           (void) const;
+		int             getTicksPerQuarterNote  (void) const;
+		int             getTPQ                  (void) const;
+
+	private:
+		class TrackState {
+			public:
+				TrackState(std::span<const uchar> data, int track)
+					: decoder(data, track) { }
+				MidiTrackDecoder decoder;
+				MidiEvent        event;     // next event not yet processed
+		};
+
+		class PendingNote {
+			public:
+				NoteSpan note;
+				bool     closed = false;     // duration is known
+		};
+
+		class ActiveKey {
+			public:
+				std::deque<size_t> serials;   // notes not yet returned
+				int      returned = 0;       // sounding notes already returned
+		};
+
+		bool            prepare                 (std::span<const uchar> data);
+		bool            readHeader              (std::span<const uchar> data,
+		                                         std::vector<size_t>& starts);
+		bool            advance                 (void);
+		void            processEvent            (MidiEvent& event, int track);
+		void            closeTrack              (int track, int tick,
+		                                         double seconds,
+		                                         int64_t nanoseconds);
+		int64_t         getLastNanoseconds      (void) const;
+		void            reset                   (void);
+		static int      getActiveIndex          (int track, int channel,
+		                                         int key);
+
+		// m_file == backing storage when reading from a file.
+		MappedFile      m_file;
+
+		// m_tracks == decoding state for each MTrk chunk.
+		std::vector<TrackState> m_tracks;
+
+		// m_order == (tick, track) of the next event of each unfinished
+		// track; the smallest entry is processed next.  Equal ticks are
+		// taken in track order, as MidiFile::joinTracks() would do.
+		std::priority_queue<std::pair<int, int>,
+		                    std::vector<std::pair<int, int>>,
+		                    std::greater<std::pair<int, int>>> m_order;
+
+		// m_pending == notes in onset order that have not been returned
+		// yet.  m_firstSerial is the serial number of the front entry.
+		std::deque<PendingNote> m_pending;
+		size_t          m_firstSerial = 0;
+
+		// m_lookahead == maximum number of notes kept behind an unclosed
+		// front entry of m_pending.
+		int             m_lookahead = 1024;
+
+		// m_active == sounding notes for each track/channel/key (FIFO
+		// note-off matching, as in MidiEventList::linkNotePairsFIFO()).
+		// Notes already returned while sounding are older than the others,
+		// so they are only counted; the next note-offs end them first.
+		std::unordered_map<int, ActiveKey> m_active;
+
+		// tempo map state (see MidiFile::buildTimeMap()):
+		int             m_ticksPerQuarterNote = 120;
+		int             m_lastTick = 0;
+		double          m_lastSeconds = 0.0;
+		double          m_secondsPerTick = 0.0;
+
+		// exact tempo map state (see MidiFile::getTimeInNanoseconds()):
+		// the time of m_lastTick in nanoseconds multiplied by the ticks
+		// per quarter note, and the current tempo.
+		int64_t         m_lastScaledNanoseconds = 0;
+		int             m_microsecondsPerQuarter = 500000;
+
+		// m_status == false after a read or decoding error.
+		bool            m_status = false;
+};
+
+} // end of namespace smf
+
+#endif /* _MIDINOTESTREAM_H_INCLUDED */
+
+
+
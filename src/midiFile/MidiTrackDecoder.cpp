@@ -0,0 +1,475 @@
+//
+// Creation Date: Sat Oct 17 09:40:02 PDT 2026
+// Filename:      midifile/src/MidiTrackDecoder.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Decodes the MIDI events of one MTrk chunk directly from
+//                a contiguous byte range (such as a memory-mapped file),
+//                one event at a time.  Used by MidiFile::readSmf() when
+//                the whole file is available in memory.
+//
+
+#include "MidiTrackDecoder.h"
+
+#include <iostream>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// MidiTrackDecoder::MidiTrackDecoder -- Constructor.  The data should
+//    start at the first delta time of the track (after the "MTrk" ID and
+//    chunk size).
+//
+
+MidiTrackDecoder::MidiTrackDecoder(std::span<const uchar> data, int track) {
+	m_data  = data;
+	m_track = track;
+	m_bytes.reserve(16);
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::next -- Decode the next event in the track.  Returns
+//    false when there are no more events, either because the end-of-track
+//    message was already returned or because of a decoding error (check
+//    status() to tell the two apart).  Ticks are converted to absolute
+//    time as they are read.
+//
+
+bool MidiTrackDecoder::next(MidiEvent& event) {
+	if (m_endOfTrack || !m_status) {
+		return false;
+	}
+	ulong delta;
+	if (!readVLValue(delta)) {
+		return false;
+	}
+	m_absticks += delta;
+	if (!readChannelMessage(event)) {
+		if (!extractMidiData()) {
+			return false;
+		}
+		event.setMessage(m_bytes);
+		if (m_bytes[0] == 0xff && m_bytes[1] == 0x2f) {
+			m_endOfTrack = true;
+		}
+	}
+	event.tick  = m_absticks;
+	event.track = m_track;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::decode -- Decode all events up to and including the
+//    end-of-track message and append them to the list.  Returns false if
+//    the track could not be decoded.
+//
+
+bool MidiTrackDecoder::decode(MidiEventList& events) {
+	// Decode straight into the list's storage; the slot taken for the
+	// read that finds no more events is given back.
+	while (next(events.emplace_back())) {
+		// do nothing
+	}
+	events.pop_back();
+	return m_status;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::setErrorStream -- Send diagnostics to the given stream
+//    instead of std::cerr.  Useful when decoding several tracks at once.
+//
+
+void MidiTrackDecoder::setErrorStream(std::ostream& out) {
+	m_err = &out;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::status -- Returns false if a decoding error occurred.
+//
+
+bool MidiTrackDecoder::status(void) const {
+	return m_status;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::isEndOfTrack -- Returns true after the end-of-track
+//    meta message has been decoded.
+//
+
+bool MidiTrackDecoder::isEndOfTrack(void) const {
+	return m_endOfTrack;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::isTruncated -- Returns true if the data ended inside
+//    the length of a system exclusive message.  The message was returned
+//    without its data bytes as the last event, and status() is false.
+//
+
+bool MidiTrackDecoder::isTruncated(void) const {
+	return m_truncated;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::getOffset -- Returns the number of bytes consumed so
+//    far.  After the end of the track, this is the size of the event data.
+//
+
+size_t MidiTrackDecoder::getOffset(void) const {
+	return m_offset;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::getTick -- Returns the absolute tick of the last
+//    decoded event.
+//
+
+int MidiTrackDecoder::getTick(void) const {
+	return m_absticks;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// MidiTrackDecoder::fail -- Mark the decoder as failed.  Always returns
+//    false so that it can be used in return statements.
+//
+
+bool MidiTrackDecoder::fail(void) {
+	m_status = false;
+	return false;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::readByte -- Read one byte, or fail at the end of data.
+//
+
+bool MidiTrackDecoder::readByte(uchar& value) {
+	if (m_offset >= m_data.size()) {
+		*m_err << "Error: unexpected end of file." << std::endl;
+		return fail();
+	}
+	value = m_data[m_offset++];
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::readVLValue -- Read a variable-length value of up to
+//    five bytes.  See MidiFile::readVLValue().
+//
+
+bool MidiTrackDecoder::readVLValue(ulong& value) {
+	// Fast path for values of up to four bytes (all delta times below
+	// 2^28 ticks) when they cannot run past the end of the data.
+	if (m_data.size() - m_offset >= 4) {
+		const uchar* p = m_data.data() + m_offset;
+		if (p[0] < 0x80) {
+			value = p[0];
+			m_offset += 1;
+			return true;
+		}
+		if (p[1] < 0x80) {
+			value = ((ulong)(p[0] & 0x7f) << 7) | p[1];
+			m_offset += 2;
+			return true;
+		}
+		if (p[2] < 0x80) {
+			value = ((ulong)(p[0] & 0x7f) << 14) | ((ulong)(p[1] & 0x7f) << 7) | p[2];
+			m_offset += 3;
+			return true;
+		}
+		if (p[3] < 0x80) {
+			value = ((ulong)(p[0] & 0x7f) << 21) | ((ulong)(p[1] & 0x7f) << 14)
+					| ((ulong)(p[2] & 0x7f) << 7) | p[3];
+			m_offset += 4;
+			return true;
+		}
+	}
+
+	uchar b[5] = {0};
+	for (uchar& item : b) {
+		if (!readByte(item)) {
+			return false;
+		}
+		if (item < 0x80) {
+			break;
+		}
+	}
+	if (!unpackVLV(value, b[0], b[1], b[2], b[3], b[4])) {
+		return fail();
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::readChannelMessage -- Fast path for channel voice
+//    messages (note-on/off, controllers, etc.), with or without running
+//    status.  The data bytes are loaded directly from the buffer using a
+//    table of message lengths and stored into the event without going
+//    through m_bytes.  Returns false without consuming anything for
+//    system/meta messages, invalid data, or when the message might run
+//    past the end of the data, so that extractMidiData() can handle (and
+//    report) those cases.
+//
+
+bool MidiTrackDecoder::readChannelMessage(MidiEvent& event) {
+	if (m_data.size() - m_offset < 3) {
+		return false;
+	}
+	const uchar* p = m_data.data() + m_offset;
+	int running = p[0] < 0x80 ? 1 : 0;
+	uchar command = running ? m_runningCommand : p[0];
+	// Commands that are not channel messages (data bytes without running
+	// status, and system messages) take the general path.
+	int count = MidiMessage::getChannelMessageSize(command) - 1;
+	if (count < 0) {
+		return false;
+	}
+	const uchar* data = p + 1 - running;
+	uchar message[3] = {command, data[0], count == 2 ? data[1] : (uchar)0};
+	if ((message[1] | message[2]) & 0x80) {
+		return false;
+	}
+	event.setMessage(message, count + 1);
+	m_runningCommand = command;
+	m_offset += 1 - running + count;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::unpackVLV -- Same conversion as MidiFile::unpackVLV(),
+//    but reports errors through the return value.
+//
+
+bool MidiTrackDecoder::unpackVLV(ulong& value, uchar a, uchar b, uchar c,
+		uchar d, uchar e) {
+	uchar bytes[5] = {a, b, c, d, e};
+	int count = 0;
+	while ((count < 5) && (bytes[count] > 0x7f)) {
+		count++;
+	}
+	count++;
+	if (count >= 6) {
+		*m_err << "VLV number is too large" << std::endl;
+		return false;
+	}
+
+	value = 0;
+	for (int i=0; i<count; i++) {
+		value = value << 7;
+		value = value | (bytes[i] & 0x7f);
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// MidiTrackDecoder::extractMidiData -- Decode the MIDI message following
+//    a delta time into m_bytes.  Running status messages are expanded
+//    with their implied command byte.  This follows the same rules as
+//    MidiFile::extractMidiData() (including its handling of meta-message
+//    lengths) so that both readers produce identical events.
+//
+
+bool MidiTrackDecoder::extractMidiData(void) {
+	uchar byte;
+	m_bytes.clear();
+	int runningQ;
+
+	if (m_offset >= m_data.size()) {
+		*m_err << "Error: unexpected end of file." << std::endl;
+		return fail();
+	}
+	byte = m_data[m_offset++];
+
+	if (byte < 0x80) {
+		runningQ = 1;
+		if (m_runningCommand == 0) {
+			*m_err << "Error: running command with no previous command" << std::endl;
+			return fail();
+		}
+		if (m_runningCommand >= 0xf0) {
+			*m_err << "Error: running status not permitted with meta and sysex"
+			     << " event." << std::endl;
+			*m_err << "Byte is 0x" << std::hex << (int)byte << std::dec << std::endl;
+			return fail();
+		}
+	} else {
+		m_runningCommand = byte;
+		runningQ = 0;
+	}
+
+	m_bytes.push_back(m_runningCommand);
+	if (runningQ) {
+		m_bytes.push_back(byte);
+	}
+
+	switch (m_runningCommand & 0xf0) {
+		case 0x80:        // note off (2 more bytes)
+		case 0x90:        // note on (2 more bytes)
+		case 0xA0:        // aftertouch (2 more bytes)
+		case 0xB0:        // cont. controller (2 more bytes)
+		case 0xE0:        // pitch wheel (2 more bytes)
+			if (!readByte(byte)) { return false; }
+			if (byte > 0x7f) {
+				*m_err << "MIDI data byte too large: " << (int)byte << std::endl;
+				return fail();
+			}
+			m_bytes.push_back(byte);
+			if (!runningQ) {
+				if (!readByte(byte)) { return false; }
+				if (byte > 0x7f) {
+					*m_err << "MIDI data byte too large: " << (int)byte << std::endl;
+					return fail();
+				}
+				m_bytes.push_back(byte);
+			}
+			break;
+		case 0xC0:        // patch change (1 more byte)
+		case 0xD0:        // channel pressure (1 more byte)
+			if (!runningQ) {
+				if (!readByte(byte)) { return false; }
+				if (byte > 0x7f) {
+					*m_err << "MIDI data byte too large: " << (int)byte << std::endl;
+					return fail();
+				}
+				m_bytes.push_back(byte);
+			}
+			break;
+		case 0xF0:
+			switch (m_runningCommand) {
+				case 0xff:                 // meta event
+					{
+					if (!readByte(byte)) { return false; } // meta type
+					m_bytes.push_back(byte);
+					ulong length = 0;
+					uchar byte1 = 0;
+					uchar byte2 = 0;
+					uchar byte3 = 0;
+					uchar byte4 = 0;
+					if (!readByte(byte1)) { return false; }
+					m_bytes.push_back(byte1);
+					if (byte1 >= 0x80) {
+						if (!readByte(byte2)) { return false; }
+						m_bytes.push_back(byte2);
+						// "> 0x80" rather than ">= 0x80" matches the stream reader.
+						if (byte2 > 0x80) {
+							if (!readByte(byte3)) { return false; }
+							m_bytes.push_back(byte3);
+							if (byte3 >= 0x80) {
+								if (!readByte(byte4)) { return false; }
+								m_bytes.push_back(byte4);
+								if (byte4 >= 0x80) {
+									*m_err << "Error: cannot handle large VLVs" << std::endl;
+									return fail();
+								} else if (!unpackVLV(length, byte1, byte2, byte3, byte4)) {
+									return fail();
+								}
+							} else if (!unpackVLV(length, byte1, byte2, byte3)) {
+								return fail();
+							}
+						} else if (!unpackVLV(length, byte1, byte2)) {
+							return fail();
+						}
+					} else {
+						length = byte1;
+					}
+					if (length > m_data.size() - m_offset) {
+						*m_err << "Error: unexpected end of file." << std::endl;
+						return fail();
+					}
+					m_bytes.insert(m_bytes.end(), m_data.begin() + m_offset,
+							m_data.begin() + m_offset + length);
+					m_offset += length;
+					}
+					break;
+
+				// See MidiFile::extractMidiData() for the meaning of 0xf0 and
+				// 0xf7 messages.
+				case 0xf7:   // Raw bytes.
+				case 0xf0:   // System Exclusive message
+					{
+					ulong length;
+					if (!readVLValue(length)) {
+						if (m_offset < m_data.size()) {
+							return false;
+						}
+						// The data ends inside the length: like the stream
+						// version of MidiFile::readSmf(), keep the message
+						// without data as the last one of the track.
+						m_truncated = true;
+						return true;
+					}
+					if (length > m_data.size() - m_offset) {
+						*m_err << "Error: unexpected end of file." << std::endl;
+						return fail();
+					}
+					m_bytes.insert(m_bytes.end(), m_data.begin() + m_offset,
+							m_data.begin() + m_offset + length);
+					m_offset += length;
+					}
+					break;
+
+				// other "F" MIDI commands are not expected, and carry no
+				// data bytes here.
+			}
+			break;
+		default:
+			*m_err << "Error reading midifile" << std::endl;
+			*m_err << "Command byte was " << (int)m_runningCommand << std::endl;
+			return fail();
+	}
+	return true;
+}
+
+
+} // end namespace smf
+
+
+
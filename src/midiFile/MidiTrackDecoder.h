@@ -0,0 +1,91 @@
+//
+// Creation Date: Sat Oct 17 09:40:02 PDT 2026
+// Filename:      midifile/include/MidiTrackDecoder.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Decodes the MIDI events of one MTrk chunk directly from
+//                a contiguous byte range (such as a memory-mapped file),
+//                one event at a time.  Used by MidiFile::readSmf() when
+//                the whole file is available in memory.
+//
+
+#ifndef _MIDITRACKDECODER_H_INCLUDED
+#define _MIDITRACKDECODER_H_INCLUDED
+
+#include "MidiEventList.h"
+
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <vector>
+
+
+namespace smf {
+
+class MidiTrackDecoder {
+	public:
+		               MidiTrackDecoder   (std::span<const uchar> data,
+		                                   int track = 0);
+
+		bool           next               (MidiEvent& event);
+		bool           decode             (MidiEventList& events);
+		void           setErrorStream     (std::ostream& out);
+
+		bool           status             (void) const;
+		bool           isEndOfTrack       (void) const;
+		bool           isTruncated        (void) const;
+		size_t         getOffset          (void) const;
+		int            getTick            (void) const;
+
+	private:
+		bool           readByte           (uchar& value);
+		bool           readVLValue        (ulong& value);
+		bool           readChannelMessage (MidiEvent& event);
+		bool           extractMidiData    (void);
+		bool           fail               (void);
+
+		bool           unpackVLV          (ulong& value, uchar a = 0,
+		                                   uchar b = 0, uchar c = 0,
+		                                   uchar d = 0, uchar e = 0);
+
+		// m_data == track data starting just after the MTrk chunk header.
+		// The chunk size is not trusted (see MidiFile::readSmf()), so the
+		// range may extend to the end of the file.
+		std::span<const uchar> m_data;
+
+		// m_offset == index of the next unread byte in m_data.
+		size_t         m_offset = 0;
+
+		// m_track == track number stored in decoded events.
+		int            m_track = 0;
+
+		// m_absticks == absolute tick time of the last decoded event.
+		int            m_absticks = 0;
+
+		// m_runningCommand == running status byte for the track.
+		uchar          m_runningCommand = 0;
+
+		// m_status == false after a decoding error.
+		bool           m_status = true;
+
+		// m_endOfTrack == true after the end-of-track meta message.
+		bool           m_endOfTrack = false;
+
+		// m_truncated == true if the data ended inside the length of a
+		// system exclusive message (see isTruncated()).
+		bool           m_truncated = false;
+
+		// m_err == destination for error messages.
+		std::ostream*  m_err = &std::cerr;
+
+		// m_bytes == scratch storage for the message being decoded.
+		std::vector<uchar> m_bytes;
+};
+
+} // end of namespace smf
+
+#endif /* _MIDITRACKDECODER_H_INCLUDED */
+
+
+
@@ -0,0 +1,47 @@
+//
+// Creation Date: Sat Oct 17 15:21:40 PDT 2026
+// Filename:      midifile/include/NoteSpan.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   A sounding note: a note-on paired with its note-off,
+//                with the onset and duration resolved to seconds, and
+//                exactly to integer nanoseconds for scheduling.
+//
+
+#ifndef _NOTESPAN_H_INCLUDED
+#define _NOTESPAN_H_INCLUDED
+
+#include <cstdint>
+
+namespace smf {
+
+class NoteSpan {
+	public:
+		double  seconds      = 0.0;   // onset time in seconds
+		double  duration     = 0.0;   // duration in seconds
+		int64_t nanoseconds  = 0;     // onset time in nanoseconds (see
+		                              // MidiFile::getTimeInNanoseconds())
+		int64_t nanoDuration = 0;     // duration in nanoseconds
+		int     tick         = 0;     // onset time in absolute ticks
+		int     tickDuration = 0;     // duration in ticks
+		int     key          = 0;     // MIDI key number (0-127)
+		int     velocity     = 0;     // note-on attack velocity (1-127)
+		int     channel      = 0;     // MIDI channel (0-15)
+		int     track        = 0;     // track containing the note-on
+		bool    terminated   = false; // false if no note-off was found, in
+		                              // which case the note lasts until the
+		                              // end of its track
+		bool    truncated    = false; // true if MidiNoteStream returned the
+		                              // note before its note-off was
+		                              // reached; the duration then ends at
+		                              // the last decoded event and
+		                              // "terminated" is false
+};
+
+} // end of namespace smf
+
+#endif /* _NOTESPAN_H_INCLUDED */
+
+
+
@@ -0,0 +1,306 @@
+//
+// Creation Date: Sun Oct 18 13:05:37 PDT 2026
+// Filename:      midifile/src/SmallByteVector.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Byte container with the std::vector interface that
+//                MidiMessage is built on.
+//
+
+#include "SmallByteVector.h"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// SmallByteVector::SmallByteVector -- Constructor.
+//
+
+SmallByteVector::SmallByteVector(size_t count, uchar value) {
+	resize(count, value);
+}
+
+
+SmallByteVector::SmallByteVector(std::initializer_list<uchar> bytes) {
+	assign(bytes.begin(), bytes.end());
+}
+
+
+SmallByteVector::SmallByteVector(const std::vector<uchar>& bytes) {
+	assign(bytes.data(), bytes.data() + bytes.size());
+}
+
+
+SmallByteVector::SmallByteVector(const SmallByteVector& other) {
+	assign(other.begin(), other.end());
+}
+
+
+SmallByteVector::SmallByteVector(SmallByteVector&& other) noexcept {
+	swap(other);
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::~SmallByteVector -- Deconstructor.
+//
+
+SmallByteVector::~SmallByteVector() {
+	if (!isInline()) {
+		delete [] m_heap;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::operator= -- Copy the bytes of another container.
+//    A heap buffer that is already large enough is reused.
+//
+
+SmallByteVector& SmallByteVector::operator=(const SmallByteVector& other) {
+	if (this != &other) {
+		assign(other.begin(), other.end());
+	}
+	return *this;
+}
+
+
+SmallByteVector& SmallByteVector::operator=(SmallByteVector&& other) noexcept {
+	if (this != &other) {
+		swap(other);
+		other.clear();
+	}
+	return *this;
+}
+
+
+SmallByteVector& SmallByteVector::operator=(std::initializer_list<uchar> bytes) {
+	assign(bytes.begin(), bytes.end());
+	return *this;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::at -- Bounds-checked access.
+//
+
+uchar& SmallByteVector::at(size_t index) {
+	if (index >= m_size) {
+		throw std::out_of_range("SmallByteVector::at");
+	}
+	return data()[index];
+}
+
+
+const uchar& SmallByteVector::at(size_t index) const {
+	if (index >= m_size) {
+		throw std::out_of_range("SmallByteVector::at");
+	}
+	return data()[index];
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::shrink_to_fit -- Move the bytes back inline if they
+//    fit, otherwise to a heap buffer of exactly the right size.
+//
+
+void SmallByteVector::shrink_to_fit(void) {
+	if (isInline() || (m_size == m_capacity)) {
+		return;
+	}
+	uchar* old = m_heap;
+	if (m_size <= INLINE_CAPACITY) {
+		std::memcpy(m_inline, old, m_size);
+		m_capacity = INLINE_CAPACITY;
+	} else {
+		m_heap = new uchar[m_size];
+		std::memcpy(m_heap, old, m_size);
+		m_capacity = m_size;
+	}
+	delete [] old;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::assign -- Replace the contents.
+//
+
+void SmallByteVector::assign(size_t count, uchar value) {
+	clear();
+	resize(count, value);
+}
+
+
+void SmallByteVector::assign(std::initializer_list<uchar> bytes) {
+	assign(bytes.begin(), bytes.end());
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::insert -- Insert bytes before pos, returning an
+//    iterator to the first inserted byte.
+//
+
+SmallByteVector::iterator SmallByteVector::insert(const_iterator pos,
+		uchar value) {
+	uchar* gap = openGap(pos - begin(), 1);
+	*gap = value;
+	return gap;
+}
+
+
+SmallByteVector::iterator SmallByteVector::insert(const_iterator pos,
+		size_t count, uchar value) {
+	uchar* gap = openGap(pos - begin(), count);
+	std::memset(gap, value, count);
+	return gap;
+}
+
+
+SmallByteVector::iterator SmallByteVector::insert(const_iterator pos,
+		const uchar* first, const uchar* last) {
+	// Copy the source first in case it is part of this container.
+	std::vector<uchar> bytes(first, last);
+	uchar* gap = openGap(pos - begin(), bytes.size());
+	std::copy(bytes.begin(), bytes.end(), gap);
+	return gap;
+}
+
+
+SmallByteVector::iterator SmallByteVector::insert(const_iterator pos,
+		std::initializer_list<uchar> bytes) {
+	return insert(pos, bytes.begin(), bytes.end());
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::erase -- Remove bytes, returning an iterator to the
+//    byte after the last one removed.
+//
+
+SmallByteVector::iterator SmallByteVector::erase(const_iterator pos) {
+	return erase(pos, pos + 1);
+}
+
+
+SmallByteVector::iterator SmallByteVector::erase(const_iterator first,
+		const_iterator last) {
+	size_t offset = first - begin();
+	size_t count = last - first;
+	uchar* start = data() + offset;
+	std::memmove(start, start + count, m_size - offset - count);
+	m_size -= (uint32_t)count;
+	return start;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::swap -- Exchange contents with another container.
+//
+
+void SmallByteVector::swap(SmallByteVector& other) noexcept {
+	// The union holds either the inline bytes or the heap pointer, and
+	// copying all of it moves whichever one is in use.
+	uchar storage[INLINE_CAPACITY];
+	std::memcpy(storage, m_inline, INLINE_CAPACITY);
+	std::memcpy(m_inline, other.m_inline, INLINE_CAPACITY);
+	std::memcpy(other.m_inline, storage, INLINE_CAPACITY);
+	std::swap(m_size, other.m_size);
+	std::swap(m_capacity, other.m_capacity);
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::toVector -- Return a copy of the bytes as a vector.
+//
+
+std::vector<uchar> SmallByteVector::toVector(void) const {
+	return std::vector<uchar>(begin(), end());
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::operator== -- True if both containers hold the same
+//    bytes.
+//
+
+bool SmallByteVector::operator==(const SmallByteVector& other) const {
+	return (m_size == other.m_size)
+			&& (std::memcmp(data(), other.data(), m_size) == 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// private functions
+//
+
+//////////////////////////////
+//
+// SmallByteVector::grow -- Move the bytes to a heap buffer that holds at
+//    least minimum bytes, doubling the capacity so that repeated
+//    push_back() calls stay amortized constant time.
+//
+
+void SmallByteVector::grow(size_t minimum) {
+	size_t capacity = std::max(minimum, (size_t)m_capacity * 2);
+	uchar* buffer = new uchar[capacity];
+	if (m_size) {
+		std::memcpy(buffer, data(), m_size);
+	}
+	if (!isInline()) {
+		delete [] m_heap;
+	}
+	m_heap = buffer;
+	m_capacity = (uint32_t)capacity;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::openGap -- Make room for count bytes at offset by
+//    shifting the bytes after it, and return a pointer to the gap.
+//
+
+uchar* SmallByteVector::openGap(size_t offset, size_t count) {
+	if (m_size + count > m_capacity) {
+		grow(m_size + count);
+	}
+	uchar* start = data() + offset;
+	std::memmove(start + count, start, m_size - offset);
+	m_size += (uint32_t)count;
+	return start;
+}
+
+
+} // end namespace smf
+
+
+
@@ -0,0 +1,220 @@
+//
+// Creation Date: Sun Oct 18 13:05:37 PDT 2026
+// Filename:      midifile/include/SmallByteVector.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Byte container with the std::vector interface that
+//                MidiMessage is built on.  Up to INLINE_CAPACITY bytes
+//                are stored inside the object itself, so channel
+//                messages and short meta messages (tempo, time and key
+//                signatures, end-of-track) need no heap allocation.
+//                Longer sysex and meta payloads spill to the heap.
+//
+
+#ifndef _SMALLBYTEVECTOR_H_INCLUDED
+#define _SMALLBYTEVECTOR_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+
+namespace smf {
+
+typedef unsigned char  uchar;
+
+class SmallByteVector {
+	public:
+		typedef uchar                                 value_type;
+		typedef size_t                                size_type;
+		typedef ptrdiff_t                             difference_type;
+		typedef uchar&                                reference;
+		typedef const uchar&                          const_reference;
+		typedef uchar*                                pointer;
+		typedef const uchar*                          const_pointer;
+		typedef uchar*                                iterator;
+		typedef const uchar*                          const_iterator;
+		typedef std::reverse_iterator<iterator>       reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		static constexpr size_t INLINE_CAPACITY = 16;
+
+		                 SmallByteVector  (void) { }
+		explicit         SmallByteVector  (size_t count, uchar value = 0);
+		                 SmallByteVector  (std::initializer_list<uchar> bytes);
+		                 SmallByteVector  (const std::vector<uchar>& bytes);
+		                 SmallByteVector  (const SmallByteVector& other);
+		                 SmallByteVector  (SmallByteVector&& other) noexcept;
+		template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+		                 SmallByteVector  (InputIt first, InputIt last) {
+		                    assign(first, last); }
+		                ~SmallByteVector  ();
+
+		SmallByteVector& operator=        (const SmallByteVector& other);
+		SmallByteVector& operator=        (SmallByteVector&& other) noexcept;
+		SmallByteVector& operator=        (std::initializer_list<uchar> bytes);
+
+		size_t           size             (void) const { return m_size; }
+		bool             empty            (void) const { return m_size == 0; }
+		size_t           capacity         (void) const { return m_capacity; }
+		bool             isInline         (void) const { return m_capacity == INLINE_CAPACITY; }
+
+		uchar*           data             (void) { return isInline() ? m_inline : m_heap; }
+		const uchar*     data             (void) const { return isInline() ? m_inline : m_heap; }
+		uchar&           operator[]       (size_t index) { return data()[index]; }
+		const uchar&     operator[]       (size_t index) const { return data()[index]; }
+		uchar&           at               (size_t index);
+		const uchar&     at               (size_t index) const;
+		uchar&           front            (void) { return data()[0]; }
+		const uchar&     front            (void) const { return data()[0]; }
+		uchar&           back             (void) { return data()[m_size - 1]; }
+		const uchar&     back             (void) const { return data()[m_size - 1]; }
+
+		iterator         begin            (void) { return data(); }
+		const_iterator   begin            (void) const { return data(); }
+		const_iterator   cbegin           (void) const { return data(); }
+		iterator         end              (void) { return data() + m_size; }
+		const_iterator   end              (void) const { return data() + m_size; }
+		const_iterator   cend             (void) const { return data() + m_size; }
+		reverse_iterator rbegin           (void) { return reverse_iterator(end()); }
+		const_reverse_iterator rbegin     (void) const { return const_reverse_iterator(end()); }
+		reverse_iterator rend             (void) { return reverse_iterator(begin()); }
+		const_reverse_iterator rend       (void) const { return const_reverse_iterator(begin()); }
+
+		void             clear            (void) { m_size = 0; }
+		void             reserve          (size_t count);
+		void             shrink_to_fit    (void);
+		void             resize           (size_t count, uchar value = 0);
+		void             push_back        (uchar value);
+		void             pop_back         (void) { m_size--; }
+		void             assign           (size_t count, uchar value);
+		void             assign           (const uchar* first, const uchar* last);
+		void             assign           (std::initializer_list<uchar> bytes);
+		template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+		void             assign           (InputIt first, InputIt last);
+		iterator         insert           (const_iterator pos, uchar value);
+		iterator         insert           (const_iterator pos, size_t count, uchar value);
+		iterator         insert           (const_iterator pos, const uchar* first, const uchar* last);
+		iterator         insert           (const_iterator pos, std::initializer_list<uchar> bytes);
+		iterator         erase            (const_iterator pos);
+		iterator         erase            (const_iterator first, const_iterator last);
+		void             swap             (SmallByteVector& other) noexcept;
+
+		std::vector<uchar> toVector       (void) const;
+
+		bool             operator==       (const SmallByteVector& other) const;
+		bool             operator!=       (const SmallByteVector& other) const {
+		                    return !(*this == other); }
+
+	private:
+		void             grow             (size_t minimum);
+		uchar*           openGap          (size_t offset, size_t count);
+
+		// m_inline == the bytes themselves while they fit (m_capacity ==
+		// INLINE_CAPACITY), otherwise m_heap points to m_capacity bytes.
+		union {
+			uchar         m_inline[INLINE_CAPACITY];
+			uchar*        m_heap;
+		};
+
+		// m_size == number of bytes in use.
+		uint32_t         m_size = 0;
+		uint32_t         m_capacity = INLINE_CAPACITY;
+};
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::reserve -- Make room for at least count bytes without
+//    changing the size.
+//
+
+inline void SmallByteVector::reserve(size_t count) {
+	if (count > m_capacity) {
+		grow(count);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::resize -- Change the number of bytes, filling any new
+//    ones with value.
+//
+
+inline void SmallByteVector::resize(size_t count, uchar value) {
+	if (count > m_capacity) {
+		grow(count);
+	}
+	if (count > m_size) {
+		std::memset(data() + m_size, value, count - m_size);
+	}
+	m_size = (uint32_t)count;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::push_back -- Append one byte.
+//
+
+inline void SmallByteVector::push_back(uchar value) {
+	if (m_size == m_capacity) {
+		grow(m_size + 1);
+	}
+	data()[m_size++] = value;
+}
+
+
+
+//////////////////////////////
+//
+// SmallByteVector::assign -- Replace the contents.  The pointer version
+//    is the one used when reading MIDI files, so it avoids the generic
+//    iterator path.
+//
+
+inline void SmallByteVector::assign(const uchar* first, const uchar* last) {
+	size_t count = last - first;
+	if (count > m_capacity) {
+		grow(count);
+	}
+	if (count) {
+		std::memmove(data(), first, count);
+	}
+	m_size = (uint32_t)count;
+}
+
+
+template <class InputIt, class>
+void SmallByteVector::assign(InputIt first, InputIt last) {
+	typedef typename std::iterator_traits<InputIt>::value_type type;
+	if constexpr (std::contiguous_iterator<InputIt> && (sizeof(type) == 1)) {
+		const uchar* start = (const uchar*)std::to_address(first);
+		assign(start, start + (last - first));
+		return;
+	} else if constexpr (std::random_access_iterator<InputIt>) {
+		reserve(last - first);
+	}
+	clear();
+	for (; first != last; ++first) {
+		push_back((uchar)*first);
+	}
+}
+
+
+} // end of namespace smf
+
+#endif /* _SMALLBYTEVECTOR_H_INCLUDED */
+
+
+
@@ -0,0 +1,115 @@
+//
+// Creation Date: Sat Oct 17 13:05:27 PDT 2026
+// Filename:      midifile/src/WorkerPool.cpp
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Minimal fork/join helper for running independent
+//                per-track jobs on several threads.
+//
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace smf {
+
+//////////////////////////////
+//
+// WorkerPool::run -- Call task(i) for every i from 0 to jobs-1, spread
+//    over the given number of threads (see resolveThreadCount()).  The
+//    calling thread takes part in the work, and the function returns
+//    after all jobs are done.  Jobs are handed out in index order.  If a
+//    job throws, the first exception is rethrown here once the remaining
+//    threads have finished.
+//
+
+void WorkerPool::run(int jobs, int threads,
+		const std::function<void(int)>& task) {
+	threads = resolveThreadCount(threads, jobs);
+	if (threads <= 1) {
+		for (int i=0; i<jobs; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	std::atomic<int> nextjob(0);
+	std::exception_ptr error;
+	std::mutex errormutex;
+
+	auto worker = [&]() {
+		while (true) {
+			int job = nextjob.fetch_add(1);
+			if (job >= jobs) {
+				return;
+			}
+			try {
+				task(job);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errormutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (int i=0; i<threads-1; i++) {
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers) {
+		thread.join();
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// WorkerPool::getHardwareThreads -- Number of threads the hardware can
+//    run at the same time (at least 1).
+//
+
+int WorkerPool::getHardwareThreads(void) {
+	int count = (int)std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+
+
+//////////////////////////////
+//
+// WorkerPool::resolveThreadCount -- Convert a requested thread count into
+//    the number of threads to use for the given number of jobs.  A
+//    request of 0 or less means one thread per hardware thread.  Never
+//    more threads than jobs are used.
+//
+
+int WorkerPool::resolveThreadCount(int threads, int jobs) {
+	if (threads <= 0) {
+		threads = getHardwareThreads();
+	}
+	if (threads > jobs) {
+		threads = jobs;
+	}
+	return threads < 1 ? 1 : threads;
+}
+
+
+} // end namespace smf
+
+
+
@@ -0,0 +1,32 @@
+//
+// Creation Date: Sat Oct 17 13:05:27 PDT 2026
+// Filename:      midifile/include/WorkerPool.h
+// Syntax:        C++20
+// vim:           ts=3 noexpandtab
+//
+// Description:   Minimal fork/join helper for running independent
+//                per-track jobs on several threads.
+//
+
+#ifndef _WORKERPOOL_H_INCLUDED
+#define _WORKERPOOL_H_INCLUDED
+
+#include <functional>
+
+
+namespace smf {
+
+class WorkerPool {
+	public:
+		static void    run                  (int jobs, int threads,
+		                                     const std::function<void(int)>& task);
+		static int     getHardwareThreads   (void);
+		static int     resolveThreadCount   (int threads, int jobs);
+};
+
+} // end of namespace smf
+
+#endif /* _WORKERPOOL_H_INCLUDED */
+
+
+
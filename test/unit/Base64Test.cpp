@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "midiFile/Base64.h"
+#include "midiFile/MidiFile.h"
+#include "SmfTestData.h"
+
+#include <string>
+#include <vector>
+
+using namespace smf;
+
+static std::string encode(const std::string& text) {
+    std::string output;
+    Base64::encode(std::span<const uchar>((const uchar*)text.data(), text.size()), output);
+    return output;
+}
+
+static std::string decode(const std::string& text) {
+    std::vector<uchar> output;
+    Base64::decode(text, output);
+    return std::string(output.begin(), output.end());
+}
+
+TEST(Base64Test, EncodesRfc4648Vectors) {
+    EXPECT_EQ(encode(""), "");
+    EXPECT_EQ(encode("f"), "Zg==");
+    EXPECT_EQ(encode("fo"), "Zm8=");
+    EXPECT_EQ(encode("foo"), "Zm9v");
+    EXPECT_EQ(encode("foob"), "Zm9vYg==");
+    EXPECT_EQ(encode("fooba"), "Zm9vYmE=");
+    EXPECT_EQ(encode("foobar"), "Zm9vYmFy");
+    std::string binary("\xfb\xff\xbf\x00\x10\x83\xff\xef\xbe\x7f\xf0\x3e\xfb\xf0", 14);
+    EXPECT_EQ(encode(binary), "+/+/ABCD/+++f/A++/A=");
+    EXPECT_EQ(decode("+/+/ABCD/+++f/A++/A="), binary);
+}
+
+TEST(Base64Test, DecodeSkipsNonAlphabetAndStopsAtPadding) {
+    EXPECT_EQ(decode("Zm9v\nYmFy"), "foobar");
+    EXPECT_EQ(decode(" Z m 9 v Y g = = ignored"), "foob");
+    EXPECT_EQ(decode("Zm9vYmE=Zm9v"), "fooba");
+    EXPECT_EQ(decode("Zm9vY"), "foo");
+}
+
+TEST(Base64Test, RoundTripsAllLengthsWithLineBreaks) {
+    std::string bytes;
+    for (int length = 0; length < 100; length++) {
+        std::string encoded = encode(bytes);
+        EXPECT_EQ(decode(encoded), bytes);
+
+        std::string wrapped;
+        for (size_t i = 0; i < encoded.size(); i += 7) {
+            wrapped += encoded.substr(i, 7) + "\r\n";
+        }
+        EXPECT_EQ(decode(wrapped), bytes);
+        bytes.push_back((char)(length * 37 + 11));
+    }
+}
+
+TEST(Base64Test, MidiFileRoundTrip) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile original;
+    ASSERT_TRUE(original.readSmf(std::span<const uchar>(bytes)));
+
+    for (int width : {0, 76}) {
+        std::string encoded = original.getBase64(width);
+        ASSERT_FALSE(encoded.empty());
+        MidiFile copy;
+        ASSERT_TRUE(copy.readBase64(encoded));
+        ASSERT_EQ(copy.getTrackCount(), original.getTrackCount());
+        for (int track = 0; track < copy.getTrackCount(); track++) {
+            ASSERT_EQ(copy[track].size(), original[track].size());
+            for (int i = 0; i < copy[track].size(); i++) {
+                EXPECT_EQ(copy[track][i].tick, original[track][i].tick);
+                EXPECT_EQ(copy[track][i].toVector(),
+                          original[track][i].toVector());
+            }
+        }
+    }
+}
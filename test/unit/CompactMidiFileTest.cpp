@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "midiFile/CompactMidiFile.h"
+#include "midiFile/MidiFile.h"
+#include "SmfTestData.h"
+
+#include <vector>
+
+using namespace smf;
+
+static MidiFile loadFile() {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    EXPECT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    return midifile;
+}
+
+TEST(CompactMidiFileTest, RoundTripsThroughMidiFile) {
+    MidiFile original = loadFile();
+    CompactMidiFile compact(original);
+
+    ASSERT_EQ(compact.getTrackCount(), original.getTrackCount());
+    for (int track = 0; track < original.getTrackCount(); track++) {
+        ASSERT_EQ(compact.getEventCount(track), original[track].size());
+        for (int i = 0; i < original[track].size(); i++) {
+            const MidiEvent& event = original[track][i];
+            EXPECT_EQ(compact.getTick(track, i), event.tick);
+            EXPECT_EQ(compact.getTrack(track, i), event.track);
+            EXPECT_EQ(compact.getMessageSize(track, i), event.size());
+            EXPECT_EQ(compact.getMessage(track, i).toVector(), event.toVector());
+            EXPECT_EQ(compact.isOutOfLine(track, i), !(event.isNote() || event.isController()
+                    || event.isPatchChange()));
+        }
+    }
+
+    MidiFile copy;
+    copy.addTracks(3);
+    compact.unpack(copy);
+    expectSameEvents(copy, original);
+
+    copy.doTimeAnalysis();
+    copy.linkNotePairs();
+    EXPECT_DOUBLE_EQ(copy[1][2].getDurationInSeconds(), 0.5);
+}
+
+TEST(CompactMidiFileTest, KeepsTrackAndTickStates) {
+    MidiFile original = loadFile();
+    original.joinTracks();
+    CompactMidiFile compact(original);
+    // unpack() numbers the events again in their joined order.
+    EXPECT_EQ(compact.getTrackCount(), 1);
+    EXPECT_TRUE(compact.hasJoinedTracks());
+    EXPECT_FALSE(compact.isOutOfLine(0, original[0].size() - 2));
+    MidiFile copy;
+    compact.unpack(copy);
+    expectSameEvents(copy, original, false);
+
+    original.splitTracks();
+    original.makeDeltaTicks();
+    compact.pack(original);
+    EXPECT_EQ(compact.getTick(1, 4), 480);
+    compact.unpack(copy);
+    expectSameEvents(copy, original, false);
+}
+
+TEST(CompactMidiFileTest, ChannelMessagesTakeEightBytes) {
+    MidiFile midifile;
+    for (int i = 0; i < 1000; i++) {
+        midifile.addNoteOn(0, i * 10, 0, 60, 64);
+        midifile.addNoteOff(0, i * 10 + 5, 0, 60);
+    }
+    midifile.addTrackName(0, 0, "piano");
+    CompactMidiFile compact(midifile);
+    EXPECT_EQ(compact.size(), 2001);
+    EXPECT_LT(compact.getMemoryUsage(), 2001 * 8 + 256);
+
+    compact.clear();
+    EXPECT_TRUE(compact.empty());
+    EXPECT_EQ(compact.getTrackCount(), 0);
+}
@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+#include "midiFile/MidiEventArena.h"
+#include "midiFile/MidiEventList.h"
+#include "midiFile/MidiFile.h"
+#include "SmfTestData.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace smf;
+
+TEST(MidiEventListTest, ArenaGrowsInSlabs) {
+    MidiEventArena arena;
+    EXPECT_EQ(arena.getSlabCount(), 0);
+
+    std::vector<MidiEvent*> events;
+    MidiEvent note(0x90, 60, 64);
+    for (int i = 0; i < 1000; i++) {
+        note.tick = i;
+        events.push_back(arena.create(note));
+    }
+    EXPECT_EQ(arena.getEventCount(), 1000);
+    EXPECT_LT(arena.getSlabCount(), 10);
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(events[i]->tick, i);
+        EXPECT_TRUE(events[i]->isNoteOn());
+        MidiEventArena::release(events[i]);
+    }
+}
+
+TEST(MidiEventListTest, ArenaReusesReleasedEvents) {
+    MidiEventArena arena;
+    MidiEvent note(0x90, 60, 64);
+    std::vector<MidiEvent*> events;
+    for (int i = 0; i < 100; i++) {
+        events.push_back(arena.create(note));
+    }
+    int slabs = arena.getSlabCount();
+
+    for (int i = 0; i < 100000; i++) {
+        MidiEventArena::release(events.back());
+        events.pop_back();
+        MidiEventArena::release(events[i % events.size()]);
+        events[i % events.size()] = arena.create(note);
+        events.push_back(arena.create(MidiEvent(0x80, 60, 0)));
+    }
+    EXPECT_EQ(arena.getSlabCount(), slabs);
+    EXPECT_TRUE(events[0]->isNoteOn());
+    EXPECT_TRUE(events.back()->isNoteOff());
+    for (MidiEvent* event : events) {
+        MidiEventArena::release(event);
+    }
+}
+
+TEST(MidiEventListTest, CopiesClearsAndRemovesEmpties) {
+    MidiEventList list;
+    MidiEvent event(0x90, 60, 64);
+    for (int i = 0; i < 300; i++) {
+        event.tick = i;
+        list.push_back(event);
+    }
+    list[10].clear();
+    list.push_back_no_copy(new MidiEvent(0x80, 60, 0));
+
+    MidiEventList copy(list);
+    ASSERT_EQ(copy.size(), 301);
+    EXPECT_EQ(copy[299].tick, 299);
+    EXPECT_TRUE(copy[300].isNoteOff());
+
+    list.removeEmpties();
+    EXPECT_EQ(list.size(), 300);
+    EXPECT_EQ(list[10].tick, 11);
+
+    list.clear();
+    EXPECT_EQ(list.size(), 0);
+    list.push_back(event);
+    EXPECT_EQ(list[0].tick, 299);
+    EXPECT_EQ(copy[0].tick, 0);
+}
+
+TEST(MidiEventListTest, EventsSurviveJoinAndSplit) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile original;
+    ASSERT_TRUE(original.readSmf(std::span<const uchar>(bytes)));
+
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.joinTracks();
+    midifile.splitTracks();
+    midifile.joinTracks();
+    midifile.splitTracks();
+
+    ASSERT_EQ(midifile.getTrackCount(), original.getTrackCount());
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        ASSERT_EQ(midifile[track].size(), original[track].size());
+        for (int i = 0; i < midifile[track].size(); i++) {
+            EXPECT_EQ(midifile[track][i].tick, original[track][i].tick);
+            EXPECT_EQ(midifile[track][i].toVector(),
+                      original[track][i].toVector());
+        }
+    }
+
+    midifile.addNoteOn(1, 2000, 0, 60, 64);
+    midifile.deleteTrack(0);
+    EXPECT_EQ(midifile.getTrackCount(), 1);
+    EXPECT_TRUE(midifile[0].last().isNoteOn());
+}
+
+TEST(MidiEventListTest, LinkIndexesMatchEventLinks) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+    MidiEventList& list = midifile[1];
+    EXPECT_FALSE(list.hasLinkIndexes());
+    EXPECT_EQ(list.getLinkedIndex(2), -1);
+
+    for (bool fifo : {true, false}) {
+        EXPECT_EQ(fifo ? list.linkNotePairsFIFO() : list.linkNotePairsLIFO(), 2);
+        ASSERT_TRUE(list.hasLinkIndexes());
+        for (int i = 0; i < list.size(); i++) {
+            int link = list.getLinkedIndex(i);
+            EXPECT_EQ(link < 0 ? nullptr : &list[link], list[i].getLinkedEvent());
+            EXPECT_EQ(list.getLinkedEvent(i), list[i].getLinkedEvent());
+            EXPECT_EQ(list.getTickDuration(i), list[i].getTickDuration());
+            EXPECT_DOUBLE_EQ(list.getDurationInSeconds(i), list[i].getDurationInSeconds());
+        }
+    }
+    EXPECT_EQ(list.getLinkedIndex(2), 4);
+
+    MidiEventList copy(list);
+    ASSERT_TRUE(copy.hasLinkIndexes());
+    for (int i = 0; i < copy.size(); i++) {
+        int link = copy.getLinkedIndex(i);
+        EXPECT_EQ(link, list.getLinkedIndex(i));
+        EXPECT_EQ(link < 0 ? nullptr : &copy[link], copy[i].getLinkedEvent());
+    }
+
+    copy.push_back(copy[0]);
+    EXPECT_FALSE(copy.hasLinkIndexes());
+    EXPECT_EQ(copy.getLinkedEvent(2), &copy[4]);
+    list.clearLinks();
+    EXPECT_FALSE(list.hasLinkIndexes());
+    EXPECT_FALSE(list[2].isLinked());
+}
+
+TEST(MidiEventListTest, CopyIgnoresStaleLinkIndexes) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.linkNotePairs();
+    midifile[1][2].setKeyNumber(61);
+    midifile[1][2].unlinkEvent();
+
+    EXPECT_EQ(midifile[1].getLinkedIndex(2), -1);
+    EXPECT_EQ(midifile[1].getLinkedIndex(4), -1);
+    EXPECT_EQ(midifile[1].getLinkedIndex(3), 5);
+    EXPECT_EQ(midifile[1].getTickDuration(2), 0);
+    EXPECT_EQ(midifile[1].getDurationInSeconds(4), 0.0);
+
+    MidiFile copy(midifile);
+    for (int i = 0; i < copy[1].size(); i++) {
+        EXPECT_EQ(copy[1][i].isLinked(), midifile[1][i].isLinked());
+    }
+    EXPECT_FALSE(copy[1][2].isLinked());
+    EXPECT_EQ(copy[1].getLinkedIndex(3), 5);
+
+    MidiEventList list(midifile[1]);
+    EXPECT_FALSE(list.hasLinkIndexes());
+    EXPECT_FALSE(list[3].isLinked());
+}
+
+TEST(MidiEventListTest, CopiedFileKeepsLinks) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+    midifile.linkNotePairs();
+
+    MidiFile copy(midifile);
+    for (int track = 0; track < copy.getTrackCount(); track++) {
+        EXPECT_TRUE(copy[track].hasLinkIndexes());
+        for (int i = 0; i < copy[track].size(); i++) {
+            EXPECT_EQ(copy[track][i].isLinked(), midifile[track][i].isLinked());
+            EXPECT_DOUBLE_EQ(copy[track][i].getDurationInSeconds(),
+                             midifile[track][i].getDurationInSeconds());
+        }
+    }
+
+    // Links made before joining the tracks are recomputed for the copy.
+    midifile.joinTracks();
+    EXPECT_FALSE(midifile[0].hasLinkIndexes());
+    MidiFile joined(midifile);
+    int linked = 0;
+    for (int i = 0; i < joined[0].size(); i++) {
+        linked += joined[0][i].isLinked();
+    }
+    EXPECT_EQ(linked, 6);
+}
+
+TEST(MidiEventListTest, PopBackUnlinksTheEvent) {
+    MidiEventList list;
+    list.emplace_back(0, 0, 0x90, 60, 64);
+    list.emplace_back(480, 0, 0x80, 60, 0);
+    ASSERT_EQ(list.linkNotePairs(), 1);
+    list.pop_back();
+    ASSERT_EQ(list.size(), 1);
+    EXPECT_FALSE(list[0].isLinked());
+    EXPECT_EQ(list[0].getLinkedEvent(), nullptr);
+    EXPECT_EQ(list.getTickDuration(0), 0);
+    EXPECT_EQ(list[0].getDurationInSeconds(), 0.0);
+}
+
+TEST(MidiEventListTest, EmplacesAndMovesEvents) {
+    MidiEventList list;
+    MidiEvent& note = list.emplace_back(480, 2, 0x91, 60, 64);
+    EXPECT_EQ(note.tick, 480);
+    EXPECT_EQ(note.track, 2);
+    EXPECT_TRUE(note.isNoteOn());
+    EXPECT_EQ(note.getChannel(), 1);
+    EXPECT_TRUE(list.emplace_back(960, 2).empty());
+    list.pop_back();
+    ASSERT_EQ(list.size(), 1);
+
+    MidiEvent text;
+    text.makeText(std::string(300, 't'));
+    text.tick = 100;
+    const uchar* bytes = text.data();
+    list.push_back(std::move(text));
+    ASSERT_EQ(list.size(), 2);
+    EXPECT_EQ(list[1].data(), bytes);    // heap bytes were moved, not copied
+    EXPECT_EQ(list[1].tick, 100);
+    EXPECT_EQ(list[1].getMetaContent(), std::string(300, 't'));
+
+    MidiFile midifile;
+    midifile.addTrack();
+    MidiEvent* on = midifile.addNoteOn(1, 0, 0, 60, 64);
+    EXPECT_EQ(on->track, 1);
+    MidiEvent tempo;
+    tempo.makeTempo(100.0);
+    tempo.tick = 10;
+    MidiEvent* added = midifile.addEvent(0, std::move(tempo));
+    EXPECT_EQ(added->track, 0);
+    EXPECT_TRUE(added->isTempo());
+    EXPECT_EQ(&midifile[0].back(), added);
+}
+
+TEST(MidiEventListTest, OverlappingNotesLinkFirstOrLast) {
+    MidiFile midifile;
+    midifile.addNoteOn(0, 0, 0, 60, 64);
+    midifile.addNoteOn(0, 10, 0, 60, 64);
+    midifile.addNoteOn(0, 10, 1, 60, 64);
+    midifile.addNoteOff(0, 20, 0, 60);
+    midifile.addNoteOn(0, 25, 0, 60, 0);
+    midifile.addController(0, 30, 0, 64, 127);
+    midifile.addController(0, 35, 0, 64, 100);
+    midifile.addController(0, 40, 0, 64, 0);
+    MidiEventList& list = midifile[0];
+
+    EXPECT_EQ(list.linkNotePairsFIFO(), 2);
+    EXPECT_EQ(list.getLinkedIndex(3), 0);
+    EXPECT_EQ(list.getLinkedIndex(4), 1);
+    EXPECT_EQ(list.getLinkedIndex(2), -1);
+    EXPECT_EQ(list.getLinkedIndex(5), 7);
+    EXPECT_EQ(list.getLinkedIndex(6), -1);
+
+    EXPECT_EQ(list.linkNotePairsLIFO(), 2);
+    EXPECT_EQ(list.getLinkedIndex(3), 1);
+    EXPECT_EQ(list.getLinkedIndex(4), 0);
+    EXPECT_EQ(list.getLinkedEvent(4), &list[0]);
+    EXPECT_EQ(list.getLinkedIndex(5), 7);
+}
+
+TEST(MidiEventListTest, SortOrdersEventsOnTheSameTick) {
+    MidiFile midifile;
+    midifile.addNoteOff(0, 10, 0, 62);
+    midifile.addNoteOn(0, 10, 0, 64, 80);
+    midifile.addController(0, 10, 0, 64, 127);
+    midifile.addNoteOn(0, 10, 0, 60, 80);
+    midifile.addNoteOff(0, 10, 0, 61);
+    midifile.addMetaEvent(0, 10, 0x2f, std::string());
+    midifile.addController(0, 10, 0, 7, 100);
+    midifile.addTempo(0, 10, 100.0);
+    midifile.addNoteOn(0, 0, 0, 59, 80);
+    midifile.clearSequence();
+
+    auto keys = [&]() {
+        std::vector<int> result;
+        for (int i = 0; i < midifile[0].size(); i++) {
+            result.push_back(midifile[0][i].isMeta() ? -midifile[0][i].getMetaType()
+                                                     : midifile[0][i].getP1());
+        }
+        return result;
+    };
+
+    midifile.sortTracksNoteOnsBeforeOffs();
+    EXPECT_EQ(keys(), std::vector<int>({59, -0x51, 7, 64, 60, 64, 61, 62, -0x2f}));
+    midifile.sortTracksNoteOffsBeforeOns();
+    EXPECT_EQ(keys(), std::vector<int>({59, -0x51, 7, 64, 61, 62, 60, 64, -0x2f}));
+
+    // Sequence numbers keep the order the events had when they were
+    // marked; events without one are placed among them by type.
+    midifile.markSequence();
+    midifile.addNoteOn(0, 10, 0, 50, 80);
+    midifile.addMetaEvent(0, 10, 0x2f, std::string());
+    midifile.addPatchChange(0, 0, 0, 5);
+    midifile.sortTracksNoteOnsBeforeOffs();
+    EXPECT_EQ(keys(), std::vector<int>({5, 59, -0x51, 7, 64, 50, 61, 62, 60, 64, -0x2f, -0x2f}));
+    EXPECT_EQ(midifile[0][11].seq, 0);
+
+    // Events read in an order that differs from the type rules.
+    MidiFile mixed;
+    mixed.addNoteOn(0, 0, 0, 60, 80);
+    mixed.addTempo(0, 0, 100.0);
+    mixed.addController(0, 0, 0, 7, 100);
+    mixed.addNoteOff(0, 0, 0, 60);
+    mixed.markSequence();
+    mixed.addController(0, 0, 0, 10, 5);
+    mixed.addMetaEvent(0, 0, 0x01, std::string("text"));
+    mixed.addNoteOn(0, 0, 0, 61, 80);
+    mixed.sortTracks();
+    std::vector<int> types;
+    for (int i = 0; i < mixed[0].size(); i++) {
+        types.push_back(mixed[0][i].isMeta() ? -mixed[0][i].getMetaType()
+                                             : mixed[0][i].getP1());
+    }
+    EXPECT_EQ(types, std::vector<int>({-0x01, 10, 60, -0x51, 7, 61, 60}));
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "midiFile/MidiEventTable.h"
+#include "midiFile/MidiFile.h"
+#include "SmfTestData.h"
+
+#include <vector>
+
+using namespace smf;
+
+static MidiFile loadLinkedFile() {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    EXPECT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+    midifile.linkNotePairs();
+    return midifile;
+}
+
+TEST(MidiEventTableTest, ColumnsMatchEvents) {
+    MidiFile midifile = loadLinkedFile();
+    MidiEventTable table(midifile);
+
+    ASSERT_EQ(table.getTrackCount(), midifile.getTrackCount());
+    int index = 0;
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        EXPECT_EQ(table.getTrackStart(track), index);
+        for (int i = 0; i < midifile[track].size(); i++, index++) {
+            const MidiEvent& event = midifile[track][i];
+            EXPECT_EQ(table.getTicks()[index], event.tick);
+            EXPECT_DOUBLE_EQ(table.getSeconds()[index], event.seconds);
+            EXPECT_EQ(table.getTracks()[index], event.track);
+            EXPECT_EQ(table.getStatus()[index], event[0]);
+            EXPECT_EQ(table.getMessageSize(index), event.size());
+            EXPECT_EQ(table.getMessage(index).toVector(), event.toVector());
+            EXPECT_EQ(table.isNoteOn(index), event.isNoteOn());
+            EXPECT_EQ(table.isNoteOff(index), event.isNoteOff());
+            EXPECT_EQ(table.getTickDuration(index), event.getTickDuration());
+            EXPECT_DOUBLE_EQ(table.getDurationInSeconds(index), event.getDurationInSeconds());
+        }
+        EXPECT_EQ(table.getTrackEnd(track), index);
+    }
+    EXPECT_EQ(table.size(), index);
+    EXPECT_EQ(table.getData1()[1], 0x01);    // meta type of the text event
+}
+
+TEST(MidiEventTableTest, LinksPointAtPartners) {
+    MidiFile midifile = loadLinkedFile();
+    midifile.joinTracks();
+    MidiEventTable table(midifile);
+
+    int linked = 0;
+    for (int i = 0; i < table.size(); i++) {
+        int link = table.getLinkedIndex(i);
+        if (link < 0) {
+            EXPECT_FALSE(midifile[0][i].isLinked());
+            continue;
+        }
+        linked++;
+        EXPECT_EQ(table.getLinkedIndex(link), i);
+        EXPECT_EQ(&midifile[0][link], midifile[0][i].getLinkedEvent());
+    }
+    EXPECT_EQ(linked, 6);    // two notes and the sustain pedal
+}
+
+TEST(MidiEventTableTest, ScansNoteOnsAndDurations) {
+    MidiFile midifile = loadLinkedFile();
+    MidiEventTable table(midifile);
+
+    std::vector<int> noteOns;
+    EXPECT_EQ(table.getNoteOnIndexes(noteOns), 2);
+    std::vector<double> durations;
+    table.getDurationsInSeconds(durations);
+    ASSERT_EQ(durations.size(), table.size());
+    for (int index : noteOns) {
+        EXPECT_TRUE(table.isNoteOn(index));
+        EXPECT_DOUBLE_EQ(durations[index], 0.5);
+    }
+
+    table.clear();
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(table.getNoteOnIndexes(noteOns), 0);
+}
@@ -0,0 +1,475 @@
+#include <gtest/gtest.h>
+#include "midiFile/MidiFile.h"
+#include "SmfTestData.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace smf;
+
+TEST(MidiFileTest, SpanReaderMatchesStreamReader) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    std::stringstream stream(std::string(bytes.begin(), bytes.end()));
+
+    MidiFile fromStream;
+    MidiFile fromSpan;
+    ASSERT_TRUE(fromStream.readSmf(stream));
+    ASSERT_TRUE(fromSpan.readSmf(std::span<const uchar>(bytes)));
+
+    expectSameEvents(fromStream, fromSpan);
+    EXPECT_EQ(fromSpan[0][1].size(), 2 + 2 + 128);
+    EXPECT_EQ(fromSpan[1].size(), 9);
+}
+
+TEST(MidiFileTest, SpanReaderRejectsTruncatedTrack) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    bytes.resize(bytes.size() - 3);
+    MidiFile midifile;
+    EXPECT_FALSE(midifile.readSmf(std::span<const uchar>(bytes)));
+}
+
+TEST(MidiFileTest, SpanReaderFailsLikeStreamReader) {
+    // Every prefix of the file, including ones that cut off the header or
+    // the length of the sysex message, leaves the same contents.
+    std::vector<uchar> bytes = makeSmfBytes();
+    for (size_t size = 4; size < bytes.size(); size++) {
+        SCOPED_TRACE(size);
+        std::stringstream stream(std::string(bytes.begin(), bytes.begin() + size));
+        MidiFile fromStream;
+        MidiFile fromSpan;
+        EXPECT_EQ(fromSpan.readSmf(std::span<const uchar>(bytes.data(), size)),
+                  fromStream.readSmf(stream));
+        expectSameEvents(fromStream, fromSpan);
+    }
+}
+
+TEST(MidiFileTest, ParallelTrackDecodingMatchesSequential) {
+    std::vector<uchar> bytes = makeSmfBytes();
+
+    MidiFile sequential;
+    MidiFile parallel;
+    parallel.setThreadCount(4);
+    ASSERT_TRUE(sequential.readSmf(std::span<const uchar>(bytes)));
+    ASSERT_TRUE(parallel.readSmf(std::span<const uchar>(bytes)));
+    expectSameEvents(sequential, parallel);
+}
+
+TEST(MidiFileTest, ParallelTrackDecodingIgnoresWrongChunkSize) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    bytes[14 + 7] += 1;    // first track claims one byte too many
+
+    MidiFile sequential;
+    MidiFile parallel;
+    parallel.setThreadCount(4);
+    ASSERT_TRUE(sequential.readSmf(std::span<const uchar>(bytes)));
+    ASSERT_TRUE(parallel.readSmf(std::span<const uchar>(bytes)));
+    expectSameEvents(sequential, parallel);
+}
+
+TEST(MidiFileTest, LazyLoadingDecodesTracksOnAccess) {
+    std::vector<uchar> bytes = makeSmfBytes();
+
+    MidiFile eager;
+    MidiFile lazy;
+    lazy.setLazyLoading();
+    ASSERT_TRUE(eager.readSmf(std::span<const uchar>(bytes)));
+    ASSERT_TRUE(lazy.readSmf(std::span<const uchar>(bytes)));
+    bytes.assign(bytes.size(), 0);    // lazy data must not refer to the caller's buffer
+
+    ASSERT_EQ(lazy.getTrackCount(), 2);
+    EXPECT_FALSE(lazy.isTrackLoaded(0));
+    EXPECT_FALSE(lazy.isTrackLoaded(1));
+
+    EXPECT_EQ(lazy.getEventCount(1), eager.getEventCount(1));
+    EXPECT_FALSE(lazy.isTrackLoaded(0));
+    EXPECT_TRUE(lazy.isTrackLoaded(1));
+    for (int i = 0; i < eager[1].size(); i++) {
+        EXPECT_EQ(lazy[1][i].tick, eager[1][i].tick);
+        EXPECT_EQ(lazy[1][i].toVector(),
+                  eager[1][i].toVector());
+    }
+}
+
+TEST(MidiFileTest, LazyLoadingMatchesEagerAnalysis) {
+    std::vector<uchar> bytes = makeSmfBytes();
+
+    MidiFile eager;
+    MidiFile lazy;
+    lazy.setLazyLoading();
+    ASSERT_TRUE(eager.readSmf(std::span<const uchar>(bytes)));
+    ASSERT_TRUE(lazy.readSmf(std::span<const uchar>(bytes)));
+    lazy[1].size();    // decode the tracks out of order
+
+    eager.joinTracks();
+    lazy.joinTracks();
+    EXPECT_TRUE(lazy.isTrackLoaded(0));
+    ASSERT_EQ(lazy[0].size(), eager[0].size());
+    for (int i = 0; i < eager[0].size(); i++) {
+        EXPECT_EQ(lazy[0][i].tick, eager[0][i].tick);
+        EXPECT_EQ(lazy[0][i].track, eager[0][i].track);
+        EXPECT_EQ(lazy[0][i].toVector(),
+                  eager[0][i].toVector());
+    }
+}
+
+TEST(MidiFileTest, LazyLoadingReportsErrorsOnAccess) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    bytes.resize(bytes.size() - 3);
+
+    MidiFile lazy;
+    lazy.setLazyLoading();
+    ASSERT_TRUE(lazy.readSmf(std::span<const uchar>(bytes)));
+    lazy[0].size();
+    EXPECT_TRUE(lazy.status());
+    lazy[1].size();
+    EXPECT_FALSE(lazy.status());
+}
+
+TEST(MidiFileTest, BinascReaderMatchesBinary) {
+    // Binasc::readFromBinary() cannot print sysex messages and does not
+    // keep running status, so the fixture avoids both.
+    std::vector<uchar> bytes = makeSmfBytes({
+        {0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,       // tempo 500000
+         0x00, 0xff, 0x03, 0x04, 'l', 'e', 'a', 'd',     // track name
+         0x00, 0xff, 0x2f, 0x00},
+        {0x00, 0xc0, 0x16,                               // patch change
+         0x00, 0x90, 0x3c, 0x40,                         // note on
+         0x00, 0x90, 0x40, 0x40,                         // note on
+         0x83, 0x60, 0x90, 0x3c, 0x00,                   // note off as note on
+         0x00, 0x80, 0x40, 0x00,                         // note off
+         0x10, 0xe0, 0x00, 0x50,                         // pitch bend
+         0x00, 0xff, 0x2f, 0x00}
+    });
+    MidiFile binary;
+    ASSERT_TRUE(binary.readSmf(std::span<const uchar>(bytes)));
+
+    std::stringstream text;
+    ASSERT_TRUE(binary.writeBinascWithComments(text));
+    std::string binasc = text.str();
+
+    MidiFile fromStream;
+    std::stringstream input(binasc);
+    ASSERT_TRUE(fromStream.read(input));
+    expectSameEvents(binary, fromStream);
+
+    // Windows line endings and no newline after the last line.
+    std::string crlf;
+    for (char ch : binasc) {
+        if (ch == '\n') {
+            crlf += '\r';
+        }
+        crlf += ch;
+    }
+    while (!crlf.empty() && (crlf.back() == '\n' || crlf.back() == '\r')) {
+        crlf.pop_back();
+    }
+    MidiFile fromSpan;
+    ASSERT_TRUE(fromSpan.read(std::span<const uchar>((const uchar*)crlf.data(), crlf.size())));
+    expectSameEvents(binary, fromSpan);
+}
+
+TEST(MidiFileTest, BinascReaderRejectsBadWords) {
+    std::string text = "\"MThd\" 4'6 2'0 2'1 2'480\n\"MTrk\" 4'4\nv0 ff 2f zz\n";
+    MidiFile midifile;
+    EXPECT_FALSE(midifile.read(std::span<const uchar>((const uchar*)text.data(), text.size())));
+
+    text = "\"MTrk\" 4'4\n";
+    EXPECT_FALSE(midifile.read(std::span<const uchar>((const uchar*)text.data(), text.size())));
+}
+
+TEST(MidiFileTest, TempoSegmentsConvertBothWays) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+
+    // 500000 us per quarter from tick 0, 1000000 us per quarter from tick 480.
+    EXPECT_EQ(midifile.getTempoSegmentCount(), 2);
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(240), 0.25);
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(480), 0.5);
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(1440), 2.5);    // after the last event
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(-1), -1.0);
+    EXPECT_DOUBLE_EQ(midifile.getAbsoluteTickTime(0.25), 240.0);
+    EXPECT_DOUBLE_EQ(midifile.getAbsoluteTickTime(1.0), 720.0);
+    EXPECT_DOUBLE_EQ(midifile.getAbsoluteTickTime(1.0 + 1.0 / 960), 720.5);
+    EXPECT_DOUBLE_EQ(midifile[1][6].seconds, 0.5 + 16.0 / 480);
+
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        for (int i = 0; i < midifile[track].size(); i++) {
+            const MidiEvent& event = midifile[track][i];
+            EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(event.tick), event.seconds);
+            EXPECT_DOUBLE_EQ(midifile.getAbsoluteTickTime(event.seconds), event.tick);
+        }
+    }
+}
+
+TEST(MidiFileTest, BatchTimeConversionMatchesSingleCalls) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+
+    std::vector<int> ticks;
+    for (int tick = -2; tick < 2000; tick += 7) {
+        ticks.push_back(tick);
+    }
+    ticks.push_back(480);    // unsorted tail
+    ticks.push_back(3);
+    ticks.push_back(-5);
+    ticks.push_back(1500);
+
+    std::vector<double> seconds;
+    midifile.getTimesInSeconds(ticks, seconds);
+    ASSERT_EQ(seconds.size(), ticks.size());
+    for (size_t i = 0; i < ticks.size(); i++) {
+        EXPECT_EQ(seconds[i], midifile.getTimeInSeconds(ticks[i])) << ticks[i];
+    }
+
+    std::vector<double> back;
+    midifile.getAbsoluteTickTimes(seconds, back);
+    ASSERT_EQ(back.size(), seconds.size());
+    for (size_t i = 0; i < seconds.size(); i++) {
+        EXPECT_EQ(back[i], midifile.getAbsoluteTickTime(seconds[i])) << seconds[i];
+        if (ticks[i] >= 0) {
+            EXPECT_NEAR(back[i], ticks[i], 1e-6);
+        }
+    }
+}
+
+TEST(MidiFileTest, TimeAnalysisKeepsTrackLayout) {
+    MidiFile midifile;
+    midifile.setTicksPerQuarterNote(480);
+    midifile.addTracks(1);
+    midifile.addNoteOn(1, 960, 0, 60, 64);
+    midifile.addNoteOn(1, 0, 0, 62, 64);     // out of order on purpose
+    midifile.addTempo(0, 480, 60.0);
+    midifile.addTempo(1, 240, 240.0);
+    midifile.addNoteOff(1, 480, 0, 62);
+
+    midifile.doTimeAnalysis();
+    EXPECT_EQ(midifile.getTempoSegmentCount(), 3);
+    ASSERT_EQ(midifile[1].size(), 4);
+    EXPECT_EQ(midifile[1][0].tick, 960);     // not sorted by the analysis
+    EXPECT_EQ(midifile[1][1].tick, 0);
+    // 120 bpm to tick 240, 240 bpm to tick 480, then 60 bpm.
+    EXPECT_DOUBLE_EQ(midifile[1][0].seconds, 0.25 + 0.125 + 1.0);
+    EXPECT_DOUBLE_EQ(midifile[1][1].seconds, 0.0);
+    EXPECT_DOUBLE_EQ(midifile[1][3].seconds, 0.375);
+
+    MidiFile parallel = midifile;
+    parallel.setThreadCount(4);
+    parallel.doTimeAnalysis();
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        for (int i = 0; i < midifile[track].size(); i++) {
+            EXPECT_DOUBLE_EQ(parallel[track][i].seconds, midifile[track][i].seconds);
+        }
+    }
+
+    MidiFile delta = midifile;
+    delta.sortTracks();
+    delta.makeDeltaTicks();
+    delta.doTimeAnalysis();
+    EXPECT_TRUE(delta.isDeltaTicks());
+    EXPECT_EQ(delta[1][3].tick, 480);
+    EXPECT_DOUBLE_EQ(delta[1][3].seconds, 1.375);
+}
+
+TEST(MidiFileTest, EditsUpdateTimesFromEarliestTick) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+
+    // Mark the events before the edit to see that they are left alone.
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        for (int i = 0; i < midifile[track].size(); i++) {
+            if (midifile[track][i].tick < 490) {
+                midifile[track][i].seconds = -7.0;
+            }
+        }
+    }
+    midifile.addTempo(0, 496, 30.0);
+    midifile.addNoteOn(1, 600, 0, 64, 64);
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(600), 0.5 + 16.0 / 480 + 104.0 * 2 / 480);
+    EXPECT_EQ(midifile.getTempoSegmentCount(), 3);
+
+    MidiFile fresh = midifile;
+    fresh.doTimeAnalysis();
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        for (int i = 0; i < midifile[track].size(); i++) {
+            const MidiEvent& event = midifile[track][i];
+            if (event.tick < 490) {
+                EXPECT_EQ(event.seconds, -7.0);
+            } else {
+                EXPECT_DOUBLE_EQ(event.seconds, fresh[track][i].seconds);
+            }
+        }
+    }
+
+    // Moving the tempo earlier needs an explicit invalidation.  The file's
+    // own tempo at tick 480 comes later in sequence order and stays in effect.
+    MidiEvent* tempo = &midifile[0].back();
+    ASSERT_TRUE(tempo->isTempo());
+    tempo->tick = 480;
+    midifile.invalidateTimeMap(480);
+    EXPECT_DOUBLE_EQ(midifile.getTimeInSeconds(600), 0.5 + 120.0 / 480);
+    EXPECT_EQ(midifile.getTempoSegmentCount(), 2);
+}
+
+TEST(MidiFileTest, IncrementalTimesAfterReplacingATrack) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    int track = midifile.addTrack();
+    for (int i = 0; i < 9; i++) {
+        midifile.addNoteOn(track, 100 * (i + 1), 0, 60, 64);
+    }
+    midifile.doTimeAnalysis();
+
+    // The new list may reuse the address of the deleted one.  Its
+    // first event is after the later update tick, and the events appended
+    // behind it without invalidating the time map are before it.
+    midifile.deleteTrack(track);
+    track = midifile.addTrack();
+    midifile.addNoteOn(track, 2000, 0, 60, 64);
+    MidiEvent early;
+    early.makeNoteOn(0, 62, 64);
+    early.tick = 500;
+    for (int i = 0; i < 8; i++) {
+        midifile[track].push_back(early);
+    }
+    midifile.addTempo(0, 1500, 30.0);
+    midifile.getTimeInSeconds(1500);
+
+    EXPECT_DOUBLE_EQ(midifile[track][0].seconds, 0.5 + 1020.0 / 480 + 500.0 * 2 / 480);
+}
+
+TEST(MidiFileTest, NanosecondTimesAreExact) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+
+    EXPECT_EQ(midifile.getTimeInNanoseconds(240), 250000000);
+    EXPECT_EQ(midifile.getTimeInNanoseconds(480), 500000000);
+    EXPECT_EQ(midifile.getTimeInNanoseconds(1440), 2500000000LL);
+    EXPECT_EQ(midifile.getTimeInNanoseconds(-1), -1);
+
+    // Three ticks per quarter at 500000 us per quarter: 166666666.67 ns per
+    // tick, rounded once instead of accumulating.
+    MidiFile odd;
+    odd.setTicksPerQuarterNote(3);
+    odd.addTempo(0, 0, 120.0);
+    odd.addTempo(0, 300000, 90.0);
+    EXPECT_EQ(odd.getTimeInNanoseconds(1), 166666667);
+    EXPECT_EQ(odd.getTimeInNanoseconds(299999), 49999833333333LL);
+    EXPECT_EQ(odd.getTimeInNanoseconds(300000), 50000000000000LL);
+    EXPECT_EQ(odd.getTimeInNanoseconds(300001), 50000222222333LL);    // 666667 us per quarter
+
+    std::vector<int> ticks = {300001, 0, 1, 2, 299999, 300000, -4};
+    std::vector<int64_t> nanoseconds;
+    odd.getTimesInNanoseconds(ticks, nanoseconds);
+    ASSERT_EQ(nanoseconds.size(), ticks.size());
+    for (size_t i = 0; i < ticks.size(); i++) {
+        EXPECT_EQ(nanoseconds[i], odd.getTimeInNanoseconds(ticks[i]));
+    }
+}
+
+TEST(MidiFileTest, ParallelLinkingMatchesSequential) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile sequential;
+    ASSERT_TRUE(sequential.readSmf(std::span<const uchar>(bytes)));
+    sequential.doTimeAnalysis();
+    EXPECT_EQ(sequential.linkNotePairs(), 2);
+
+    // An old link between tracks is dropped on both sides.
+    MidiFile parallel;
+    parallel.setThreadCount(4);
+    ASSERT_TRUE(parallel.readSmf(std::span<const uchar>(bytes)));
+    parallel[0][0].linkEvent(parallel[1][2]);
+    EXPECT_EQ(parallel.doTimeAnalysisAndLinkNotePairs(), 2);
+
+    ASSERT_EQ(parallel.getTrackCount(), sequential.getTrackCount());
+    for (int track = 0; track < parallel.getTrackCount(); track++) {
+        ASSERT_EQ(parallel[track].size(), sequential[track].size());
+        for (int i = 0; i < parallel[track].size(); i++) {
+            EXPECT_EQ(parallel[track].getLinkedIndex(i), sequential[track].getLinkedIndex(i));
+            EXPECT_EQ(parallel[track].getLinkedEvent(i), parallel[track][i].getLinkedEvent());
+            EXPECT_DOUBLE_EQ(parallel[track][i].seconds, sequential[track][i].seconds);
+        }
+    }
+    EXPECT_EQ(parallel.linkNotePairsLIFO(), 2);
+}
+
+TEST(MidiFileTest, NoteSpansAreSortedByOnset) {
+    MidiFile midifile;
+    midifile.setTicksPerQuarterNote(480);
+    midifile.addTracks(1);
+    midifile.addTempo(0, 0, 120.0);
+    midifile.addNoteOn(1, 960, 1, 64, 90);
+    midifile.addNoteOff(1, 1440, 1, 64);
+    midifile.addNoteOn(1, 1920, 0, 67, 70);    // never turned off
+    midifile.addTrackName(1, 2400, "end");
+    midifile.addNoteOn(0, 0, 0, 60, 100);
+    midifile.addNoteOn(0, 480, 0, 60, 80);
+    midifile.addNoteOff(0, 960, 0, 60);
+    midifile.addNoteOn(0, 960, 0, 60, 0);
+    midifile.sortTracks();
+
+    std::vector<NoteSpan> notes;
+    ASSERT_EQ(midifile.getNoteSpans(notes), 4);
+    EXPECT_EQ(notes[0].key, 60);
+    EXPECT_EQ(notes[0].velocity, 100);
+    EXPECT_EQ(notes[0].tickDuration, 960);     // first note-off ends the first note-on
+    EXPECT_DOUBLE_EQ(notes[0].duration, 1.0);
+    EXPECT_EQ(notes[0].nanoDuration, 1000000000);
+    EXPECT_EQ(notes[1].tick, 480);
+    EXPECT_EQ(notes[1].tickDuration, 480);
+    EXPECT_TRUE(notes[1].terminated);
+    EXPECT_EQ(notes[2].track, 1);              // same onset, later track
+    EXPECT_EQ(notes[2].channel, 1);
+    EXPECT_DOUBLE_EQ(notes[2].seconds, 1.0);
+    EXPECT_EQ(notes[2].nanoseconds, 1000000000);
+    EXPECT_DOUBLE_EQ(notes[2].duration, 0.5);
+    EXPECT_FALSE(notes[3].terminated);
+    EXPECT_EQ(notes[3].tickDuration, 480);
+    EXPECT_DOUBLE_EQ(notes[3].duration, 0.5);
+    EXPECT_FALSE(midifile[0][0].isLinked());
+}
+
+TEST(MidiFileTest, JoinAndMergeKeepSortedOrder) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.addTracks(1);
+    midifile.addNoteOn(2, 480, 0, 70, 64);     // no sequence number: first at its tick
+    midifile.addNoteOff(2, 600, 0, 70);
+
+    // Same order as appending all tracks and sorting them.
+    MidiFile expected(midifile);
+    for (int track = 1; track < expected.getTrackCount(); track++) {
+        for (int i = 0; i < expected[track].size(); i++) {
+            expected.addEvent(0, expected[track][i]);
+        }
+    }
+    expected.sortTrack(0);
+
+    MidiFile joined(midifile);
+    joined.joinTracks();
+    ASSERT_EQ(joined[0].size(), expected[0].size());
+    for (int i = 0; i < joined[0].size(); i++) {
+        EXPECT_EQ(joined[0][i].tick, expected[0][i].tick);
+        EXPECT_EQ(joined[0][i].seq, expected[0][i].seq);
+        EXPECT_EQ(joined[0][i].toVector(), expected[0][i].toVector());
+    }
+
+    // The events are moved into the merged track, not copied.
+    const MidiEvent* noteOn = &midifile[2][0];
+    midifile.mergeTracks(1, 2);
+    ASSERT_EQ(midifile.getTrackCount(), 2);
+    EXPECT_EQ(&midifile[1][4], noteOn);
+    std::vector<int> keys;
+    for (int i = 0; i < midifile[1].size(); i++) {
+        EXPECT_EQ(midifile[1][i].track, 1);
+        keys.push_back(midifile[1][i].isNote() ? midifile[1][i].getP1() : -1);
+    }
+    EXPECT_EQ(keys, std::vector<int>({-1, -1, 0x3c, 0x40, 70, 0x3c, 0x40, -1, -1, -1, 70}));
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include "midiFile/MidiFile.h"
+#include "midiFile/MidiNoteStream.h"
+#include "SmfTestData.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace smf;
+
+// Tempo track with a change at tick 480, and two note tracks whose notes
+// cross the change.  The last note of track 2 is never turned off.
+static std::vector<uchar> makeTempoChangeBytes() {
+    std::vector<uchar> tempo = {
+        0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,       // tempo 500000
+        0x83, 0x60, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40, // tempo 1000000 at tick 480
+        0x00, 0xff, 0x2f, 0x00
+    };
+    std::vector<uchar> melody = {
+        0x00, 0x90, 0x3c, 0x40,                         // C4 on
+        0x00, 0x3c, 0x50,                               // second C4 on
+        0x81, 0x70, 0x3c, 0x00,                         // C4 off (tick 240)
+        0x81, 0x70, 0x3c, 0x00,                         // C4 off (tick 480)
+        0x00, 0x3e, 0x40,                               // D4 on
+        0x83, 0x60, 0x80, 0x3e, 0x00,                   // D4 off (tick 960)
+        0x00, 0xff, 0x2f, 0x00
+    };
+    std::vector<uchar> bass = {
+        0x81, 0x70, 0x91, 0x30, 0x60,                   // C3 on, channel index 1 (tick 240)
+        0x87, 0x40, 0x30, 0x00,                         // C3 off (tick 1200)
+        0x00, 0x32, 0x60,                               // D3 on, never turned off
+        0x83, 0x60, 0xff, 0x2f, 0x00                    // end of track (tick 1680)
+    };
+    return makeSmfBytes({tempo, melody, bass});
+}
+
+// One C3 held while many short C4 notes are played, then a second C3.
+static std::vector<uchar> makeSustainedNoteBytes(int count) {
+    std::vector<uchar> track = {0x00, 0x90, 0x30, 0x40};  // C3 on
+    for (int i = 0; i < count; i++) {
+        track.insert(track.end(), {0x00, 0x90, 0x3c, 0x40, 0x0a, 0x80, 0x3c, 0x00});
+    }
+    track.insert(track.end(), {
+        0x00, 0x80, 0x30, 0x00,                         // C3 off
+        0x00, 0x90, 0x30, 0x50,                         // second C3 on
+        0x0a, 0x80, 0x30, 0x00,                         // second C3 off
+        0x00, 0xff, 0x2f, 0x00
+    });
+    return makeSmfBytes({track});
+}
+
+static std::vector<NoteSpan> readAll(MidiNoteStream& stream) {
+    std::vector<NoteSpan> notes;
+    NoteSpan note;
+    while (stream.next(note)) {
+        notes.push_back(note);
+    }
+    return notes;
+}
+
+TEST(MidiNoteStreamTest, MatchesAnalyzedMidiFile) {
+    std::vector<uchar> bytes = makeTempoChangeBytes();
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    midifile.doTimeAnalysis();
+    midifile.linkNotePairs();
+
+    std::vector<const MidiEvent*> expected;
+    for (int track = 0; track < midifile.getTrackCount(); track++) {
+        for (int i = 0; i < midifile[track].size(); i++) {
+            if (midifile[track][i].isNoteOn()) {
+                expected.push_back(&midifile[track][i]);
+            }
+        }
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+        [](const MidiEvent* a, const MidiEvent* b) { return a->tick < b->tick; });
+
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    EXPECT_EQ(stream.getTrackCount(), 3);
+    EXPECT_EQ(stream.getTicksPerQuarterNote(), 480);
+    std::vector<NoteSpan> notes = readAll(stream);
+    EXPECT_TRUE(stream.status());
+
+    ASSERT_EQ(notes.size(), expected.size());
+    for (size_t i = 0; i < notes.size(); i++) {
+        const MidiEvent& event = *expected[i];
+        EXPECT_EQ(notes[i].tick, event.tick);
+        EXPECT_EQ(notes[i].track, event.track);
+        EXPECT_EQ(notes[i].key, event.getKeyNumber());
+        EXPECT_EQ(notes[i].velocity, event.getVelocity());
+        EXPECT_EQ(notes[i].channel, event.getChannel());
+        EXPECT_DOUBLE_EQ(notes[i].seconds, event.seconds);
+        EXPECT_EQ(notes[i].terminated, event.isLinked());
+        EXPECT_FALSE(notes[i].truncated);
+        if (event.isLinked()) {
+            EXPECT_EQ(notes[i].tickDuration, event.getTickDuration());
+            EXPECT_DOUBLE_EQ(notes[i].duration, event.getDurationInSeconds());
+        }
+    }
+}
+
+TEST(MidiNoteStreamTest, UnterminatedNoteLastsUntilEndOfTrack) {
+    std::vector<uchar> bytes = makeTempoChangeBytes();
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    std::vector<NoteSpan> notes = readAll(stream);
+
+    ASSERT_EQ(notes.size(), 5);
+    const NoteSpan& last = notes.back();
+    EXPECT_EQ(last.key, 0x32);
+    EXPECT_EQ(last.channel, 1);
+    EXPECT_FALSE(last.terminated);
+    EXPECT_FALSE(last.truncated);
+    EXPECT_EQ(last.tick, 1200);
+    EXPECT_EQ(last.tickDuration, 480);
+    EXPECT_DOUBLE_EQ(last.seconds, 0.5 + 720 / 480.0);
+    EXPECT_DOUBLE_EQ(last.duration, 1.0);
+}
+
+TEST(MidiNoteStreamTest, NanosecondsMatchMidiFile) {
+    // Three ticks per quarter note: a tick is 166666666.67 ns, so times
+    // only stay exact if they are not accumulated from rounded values.
+    std::vector<uchar> track = {0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20};
+    for (int i = 0; i < 3000; i++) {
+        track.insert(track.end(), {0x00, 0x90, 0x3c, 0x40, 0x01, 0x80, 0x3c, 0x00});
+    }
+    track.insert(track.end(), {0x00, 0x90, 0x3e, 0x40, 0x02, 0xff, 0x2f, 0x00});
+    std::vector<uchar> bytes = makeSmfBytes({track}, 3);
+
+    MidiFile midifile;
+    ASSERT_TRUE(midifile.readSmf(std::span<const uchar>(bytes)));
+    std::vector<NoteSpan> expected;
+    midifile.getNoteSpans(expected);
+
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    std::vector<NoteSpan> notes = readAll(stream);
+    ASSERT_EQ(notes.size(), expected.size());
+    for (size_t i = 0; i < notes.size(); i++) {
+        EXPECT_EQ(notes[i].tick, expected[i].tick);
+        EXPECT_EQ(notes[i].nanoseconds, midifile.getTimeInNanoseconds(notes[i].tick));
+        EXPECT_EQ(notes[i].nanoseconds, expected[i].nanoseconds);
+        EXPECT_EQ(notes[i].nanoDuration, expected[i].nanoDuration);
+    }
+    EXPECT_EQ(notes.back().nanoseconds, 500000000000LL);
+    EXPECT_EQ(notes.back().nanoDuration, 333333333);    // unterminated
+}
+
+TEST(MidiNoteStreamTest, FifoPairingOfRepeatedKeys) {
+    std::vector<uchar> bytes = makeTempoChangeBytes();
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    std::vector<NoteSpan> notes = readAll(stream);
+
+    ASSERT_GE(notes.size(), 2);
+    EXPECT_EQ(notes[0].velocity, 0x40);
+    EXPECT_EQ(notes[0].tickDuration, 240);
+    EXPECT_EQ(notes[1].velocity, 0x50);
+    EXPECT_EQ(notes[1].tickDuration, 480);
+}
+
+TEST(MidiNoteStreamTest, ReportsDecodingErrors) {
+    std::vector<uchar> bytes = makeTempoChangeBytes();
+    bytes.resize(bytes.size() - 3);
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    readAll(stream);
+    EXPECT_FALSE(stream.status());
+
+    std::vector<uchar> garbage = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_FALSE(stream.open(std::span<const uchar>(garbage)));
+}
+
+TEST(MidiNoteStreamTest, SustainedNoteDoesNotHoldBackLaterNotes) {
+    const int count = 5000;
+    std::vector<uchar> bytes = makeSustainedNoteBytes(count);
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    EXPECT_EQ(stream.getLookahead(), 1024);
+    stream.setLookahead(16);
+
+    NoteSpan note;
+    ASSERT_TRUE(stream.next(note));
+    EXPECT_EQ(note.key, 0x30);
+    EXPECT_EQ(note.tick, 0);
+    EXPECT_FALSE(note.terminated);
+    EXPECT_TRUE(note.truncated);
+    EXPECT_EQ(note.tickDuration, 15 * 10);  // onset of the 16th later note
+
+    std::vector<NoteSpan> notes = readAll(stream);
+    EXPECT_TRUE(stream.status());
+    ASSERT_EQ(notes.size(), count + 1);
+    for (int i = 0; i < count; i++) {
+        EXPECT_EQ(notes[i].key, 0x3c);
+        EXPECT_EQ(notes[i].tick, i * 10);
+        EXPECT_EQ(notes[i].tickDuration, 10);
+        EXPECT_TRUE(notes[i].terminated);
+        EXPECT_FALSE(notes[i].truncated);
+    }
+    // The note-off of the held note must not end the second C3.
+    EXPECT_EQ(notes.back().key, 0x30);
+    EXPECT_EQ(notes.back().velocity, 0x50);
+    EXPECT_EQ(notes.back().tick, count * 10);
+    EXPECT_EQ(notes.back().tickDuration, 10);
+    EXPECT_TRUE(notes.back().terminated);
+}
+
+TEST(MidiNoteStreamTest, NotesWithoutNoteOffs) {
+    // Percussion hits on one key, never turned off.
+    const int count = 3000;
+    std::vector<uchar> track;
+    for (int i = 0; i < count; i++) {
+        track.insert(track.end(), {0x05, 0x99, 0x24, 0x64});
+    }
+    track.insert(track.end(), {0x05, 0xff, 0x2f, 0x00});
+    std::vector<uchar> bytes = makeSmfBytes({track});
+
+    MidiNoteStream stream;
+    ASSERT_TRUE(stream.open(std::span<const uchar>(bytes)));
+    stream.setLookahead(8);
+    std::vector<NoteSpan> notes = readAll(stream);
+    EXPECT_TRUE(stream.status());
+    ASSERT_EQ(notes.size(), count);
+    for (int i = 0; i < count; i++) {
+        EXPECT_EQ(notes[i].tick, (i + 1) * 5);
+        EXPECT_FALSE(notes[i].terminated);
+        // only the last 8 are still waiting when the end of track is reached
+        EXPECT_EQ(notes[i].truncated, i < count - 8);
+    }
+    EXPECT_EQ(notes[0].tickDuration, 8 * 5);
+    EXPECT_EQ(notes.back().tickDuration, 5);    // ended by the end of track
+}
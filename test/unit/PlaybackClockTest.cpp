@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "PlaybackClock.h"
+
+#include <stdexcept>
+
+using namespace std::chrono;
+
+TEST(PlaybackClockTest, ScalesDeadlinesByRate) {
+    PlaybackClock clock(0.5);
+    PlaybackClock::Clock::time_point start{};
+    clock.start(start);
+
+    EXPECT_EQ(clock.advance(milliseconds(100)) - start, milliseconds(200));
+    EXPECT_EQ(clock.advance(milliseconds(100)) - start, milliseconds(400));
+    EXPECT_EQ(clock.getSongTime(), milliseconds(200));
+}
+
+TEST(PlaybackClockTest, RateChangeOnlyAffectsUpcomingNotes) {
+    PlaybackClock clock;
+    PlaybackClock::Clock::time_point start{};
+    clock.start(start);
+
+    EXPECT_EQ(clock.advance(seconds(1)) - start, seconds(1));
+    clock.setRate(0.8);
+    EXPECT_EQ(clock.advance(seconds(2)) - start, milliseconds(3500));
+    clock.setRate(2.0);
+    EXPECT_EQ(clock.advance(seconds(1)) - start, milliseconds(4000));
+    EXPECT_DOUBLE_EQ(clock.getRate(), 2.0);
+
+    // Restarting keeps the rate.
+    clock.start(start);
+    EXPECT_EQ(clock.advance(seconds(1)) - start, milliseconds(500));
+}
+
+TEST(PlaybackClockTest, AdvancesToOnsets) {
+    PlaybackClock clock;
+    PlaybackClock::Clock::time_point start{};
+    clock.start(start);
+
+    EXPECT_EQ(clock.advanceTo(seconds(1)) - start, seconds(1));
+    clock.setRate(0.5);
+    EXPECT_EQ(clock.advanceTo(seconds(2)) - start, seconds(3));
+
+    // The song position does not move backward.
+    EXPECT_EQ(clock.advanceTo(milliseconds(1500)) - start, seconds(3));
+    EXPECT_EQ(clock.getSongTime(), seconds(2));
+}
+
+TEST(PlaybackClockTest, RejectsInvalidRates) {
+    PlaybackClock clock;
+    EXPECT_THROW(clock.setRate(0.0), std::invalid_argument);
+    EXPECT_THROW(clock.setRate(-1.0), std::invalid_argument);
+    EXPECT_DOUBLE_EQ(clock.getRate(), 1.0);
+}
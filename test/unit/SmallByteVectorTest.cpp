@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "midiFile/MidiFile.h"
+#include "midiFile/SmallByteVector.h"
+#include "SmfTestData.h"
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace smf;
+
+TEST(SmallByteVectorTest, SpillsToHeapAndBack) {
+    SmallByteVector bytes;
+    EXPECT_TRUE(bytes.isInline());
+    for (int i = 0; i < 100; i++) {
+        bytes.push_back((uchar)i);
+        EXPECT_EQ(bytes.isInline(), bytes.size() <= SmallByteVector::INLINE_CAPACITY);
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(bytes[i], i);
+    }
+
+    SmallByteVector copy(bytes);
+    EXPECT_EQ(copy, bytes);
+    bytes.erase(bytes.begin() + 1, bytes.end() - 1);
+    ASSERT_EQ(bytes.size(), 2);
+    EXPECT_EQ(bytes.back(), 99);
+    bytes.shrink_to_fit();
+    EXPECT_TRUE(bytes.isInline());
+
+    bytes.insert(bytes.begin() + 1, copy.begin(), copy.end());
+    ASSERT_EQ(bytes.size(), 102);
+    EXPECT_EQ(bytes[1], 0);
+    EXPECT_EQ(bytes[100], 99);
+
+    SmallByteVector moved(std::move(copy));
+    EXPECT_EQ(moved.size(), 100);
+    copy = moved;
+    moved = std::move(bytes);
+    EXPECT_EQ(moved.size(), 102);
+    EXPECT_EQ(copy.toVector(), std::vector<uchar>(moved.begin() + 1, moved.end() - 1));
+}
+
+TEST(SmallByteVectorTest, ShortMessagesStayInline) {
+    MidiMessage message(0x90, 60, 64);
+    EXPECT_TRUE(message.isInline());
+    message.makeTempo(120.0);
+    EXPECT_TRUE(message.isInline());
+    EXPECT_DOUBLE_EQ(message.getTempoBPM(), 120.0);
+    message.makeTimeSignature(6, 8);
+    EXPECT_TRUE(message.isInline());
+
+    std::string text(200, 'x');
+    message.makeText(text);
+    EXPECT_FALSE(message.isInline());
+    EXPECT_EQ(message.getMetaContent(), text);
+    message.makeNoteOff(1, 60, 0);
+    EXPECT_TRUE(message.isNoteOff());
+}
+
+TEST(SmallByteVectorTest, MidiFileRoundTripsThroughWrite) {
+    std::vector<uchar> bytes = makeSmfBytes();
+    MidiFile original;
+    ASSERT_TRUE(original.readSmf(std::span<const uchar>(bytes)));
+
+    std::stringstream output;
+    ASSERT_TRUE(original.write(output));
+    std::string written = output.str();
+    MidiFile copy;
+    ASSERT_TRUE(copy.readSmf(std::span<const uchar>((const uchar*)written.data(), written.size())));
+    ASSERT_EQ(copy.getTrackCount(), original.getTrackCount());
+    for (int track = 0; track < copy.getTrackCount(); track++) {
+        ASSERT_EQ(copy[track].size(), original[track].size());
+        for (int i = 0; i < copy[track].size(); i++) {
+            EXPECT_EQ(copy[track][i].toVector(), original[track][i].toVector());
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef SMF_TEST_DATA_H
+#define SMF_TEST_DATA_H
+
+#include <gtest/gtest.h>
+#include "midiFile/MidiFile.h"
+
+#include <cstdint>
+#include <vector>
+
+using smf::uchar;
+
+// Checks that two files have the same tracks, time state and events.
+// Sequence numbers can be skipped when one file was numbered again,
+// such as by CompactMidiFile::unpack() after joinTracks().
+inline void expectSameEvents(const smf::MidiFile& a, const smf::MidiFile& b,
+        bool checkSequence = true) {
+    ASSERT_EQ(a.getTrackCount(), b.getTrackCount());
+    EXPECT_EQ(a.getTicksPerQuarterNote(), b.getTicksPerQuarterNote());
+    EXPECT_EQ(a.isDeltaTicks(), b.isDeltaTicks());
+    EXPECT_EQ(a.hasJoinedTracks(), b.hasJoinedTracks());
+    for (int track = 0; track < a.getTrackCount(); track++) {
+        ASSERT_EQ(a[track].size(), b[track].size());
+        for (int i = 0; i < a[track].size(); i++) {
+            EXPECT_EQ(a[track][i].tick, b[track][i].tick);
+            EXPECT_EQ(a[track][i].track, b[track][i].track);
+            if (checkSequence) {
+                EXPECT_EQ(a[track][i].seq, b[track][i].seq);
+            }
+            EXPECT_EQ(a[track][i].toVector(), b[track][i].toVector());
+        }
+    }
+}
+
+inline void append(std::vector<uchar>& bytes, const std::vector<uchar>& more) {
+    bytes.insert(bytes.end(), more.begin(), more.end());
+}
+
+// Wraps the given MTrk event data in a Standard MIDI File with the
+// given ticks per quarter note.
+inline std::vector<uchar> makeSmfBytes(const std::vector<std::vector<uchar>>& tracks, int tpq = 480) {
+    std::vector<uchar> bytes = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1,
+        (uchar)(tracks.size() >> 8), (uchar)tracks.size(), (uchar)(tpq >> 8), (uchar)tpq};
+    for (const auto& track : tracks) {
+        uint32_t size = (uint32_t)track.size();
+        append(bytes, {'M', 'T', 'r', 'k',
+            (uchar)(size >> 24), (uchar)(size >> 16), (uchar)(size >> 8), (uchar)size});
+        append(bytes, track);
+    }
+    return bytes;
+}
+
+// Two-track type-1 file exercising running status, sysex and a meta
+// message with a two-byte length.
+inline std::vector<uchar> makeSmfBytes() {
+    std::vector<uchar> track0 = {
+        0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,       // tempo 500000
+        0x00, 0xff, 0x01, 0x81, 0x00                     // text, length 128
+    };
+    track0.insert(track0.end(), 128, 'x');
+    append(track0, {
+        0x83, 0x60, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40, // tempo 1000000 at tick 480
+        0x00, 0xff, 0x2f, 0x00
+    });
+
+    std::vector<uchar> track1 = {
+        0x00, 0xc0, 0x16,                               // patch change
+        0x00, 0xf0, 0x03, 0x7e, 0x09, 0xf7,             // sysex
+        0x00, 0x90, 0x3c, 0x40,                         // note on
+        0x00, 0x40, 0x40,                               // running status note on
+        0x83, 0x60, 0x3c, 0x00,                         // running status note off
+        0x00, 0x80, 0x40, 0x00,                         // note off
+        0x10, 0xb0, 0x40, 0x7f,                         // sustain on
+        0x10, 0x40, 0x00,                               // running status sustain off
+        0x00, 0xff, 0x2f, 0x00
+    };
+
+    return makeSmfBytes({track0, track1});
+}
+
+#endif
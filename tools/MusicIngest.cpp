@@ -0,0 +1,186 @@
+/**
+ * @file MusicIngest.cpp
+ * @brief Batch checker for MIDI files before they are added to the player's library.
+ *
+ * Every file is loaded the same way `music_run` loads it (MidiFile::read, doTimeAnalysis and
+ * linkNotePairs), with the files spread over a pool of worker threads. One summary line is
+ * printed per file, followed by aggregate throughput figures that can be used to size ingest
+ * hosts.
+ *
+ * Usage: music_ingest [-j threads] [-q] path...
+ *
+ * Each path may be a MIDI file or a directory, which is searched recursively for files ending
+ * in .mid, .midi, .smf or .kar. The exit status is 0 if every file was read successfully,
+ * 1 if any file failed, and 2 for usage errors.
+ */
+
+#include "midiFile/MidiFile.h"
+#include "midiFile/WorkerPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace smf;
+namespace fs = std::filesystem;
+
+/**
+ * @brief Result of loading one file.
+ */
+struct IngestResult {
+    std::string path;       /**< File that was read. */
+    bool ok = false;        /**< True if the file parsed successfully. */
+    uintmax_t bytes = 0;    /**< Size of the file in bytes. */
+    int tracks = 0;         /**< Number of tracks in the file. */
+    long events = 0;        /**< Total number of events in all tracks. */
+    double duration = 0.0;  /**< Duration in seconds (from getFileDurationInSeconds). */
+};
+
+/**
+ * @brief Checks whether a file name has one of the MIDI file extensions.
+ */
+static bool hasMidiExtension(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return (char)std::tolower(c); });
+    return extension == ".mid" || extension == ".midi" || extension == ".smf" || extension == ".kar";
+}
+
+/**
+ * @brief Expands the command-line paths into a sorted list of files.
+ *
+ * Files named on the command line are always included. Directories are searched recursively
+ * for MIDI files.
+ *
+ * @return false if a path does not exist.
+ */
+static bool collectFiles(const std::vector<std::string>& paths, std::vector<std::string>& files) {
+    bool ok = true;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        if (fs::is_directory(path, error)) {
+            std::vector<std::string> found;
+            for (auto it = fs::recursive_directory_iterator(path, error);
+                    !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+                if (it->is_regular_file(error) && hasMidiExtension(it->path())) {
+                    found.push_back(it->path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else if (fs::exists(path, error)) {
+            files.push_back(path);
+        } else {
+            std::cerr << "Error: " << path << " does not exist" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Loads one file and fills in its summary.
+ */
+static void ingest(IngestResult& result) {
+    std::error_code error;
+    result.bytes = fs::file_size(result.path, error);
+    if (error) {
+        result.bytes = 0;
+    }
+
+    MidiFile midifile;
+    if (!midifile.read(result.path)) {
+        return;
+    }
+    result.tracks = midifile.getTrackCount();
+    for (int track = 0; track < result.tracks; track++) {
+        result.events += midifile[track].size();
+    }
+    midifile.doTimeAnalysis();
+    midifile.linkNotePairs();
+    result.duration = midifile.getFileDurationInSeconds();
+    result.ok = midifile.status();
+}
+
+/**
+ * @brief Prints the usage message.
+ */
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [-j threads] [-q] path..." << std::endl;
+    std::cerr << "  -j threads  number of worker threads (default: one per core)" << std::endl;
+    std::cerr << "  -q          only print failed files and the totals" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    bool quiet = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "-q") {
+            quiet = true;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> files;
+    bool found = collectFiles(paths, files);
+
+    std::vector<IngestResult> results(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        results[i].path = files[i];
+    }
+
+    int workers = WorkerPool::resolveThreadCount(threads, std::max((int)files.size(), 1));
+    auto start = std::chrono::steady_clock::now();
+    WorkerPool::run((int)results.size(), workers, [&](int i) { ingest(results[i]); });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    int failures = 0;
+    uintmax_t bytes = 0;
+    long events = 0;
+    std::cout << "status\ttracks\tevents\tseconds\tbytes\tfile" << std::endl;
+    for (const IngestResult& result : results) {
+        bytes += result.bytes;
+        events += result.events;
+        if (!result.ok) {
+            failures++;
+        }
+        if (quiet && result.ok) {
+            continue;
+        }
+        std::cout << (result.ok ? "ok" : "FAIL") << '\t' << result.tracks << '\t' << result.events
+                  << '\t' << std::fixed << std::setprecision(3) << result.duration << '\t'
+                  << result.bytes << '\t' << result.path << std::endl;
+    }
+
+    double seconds = std::max(elapsed.count(), 1.0e-9);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "files: " << results.size() << " (" << failures << " failed), "
+              << "events: " << events << ", bytes: " << bytes << std::endl;
+    std::cout << "time: " << seconds << " s with " << workers << " threads, "
+              << results.size() / seconds << " files/s, "
+              << bytes / seconds / 1.0e6 << " MB/s" << std::endl;
+
+    return (failures > 0 || !found) ? 1 : 0;
+}